@@ -0,0 +1,1973 @@
+// Exact split finding kernel, templated on the number of lanes (features evaluated
+// in parallel), the row and node capacities and the accumulator type (ap_fixed or float).
+// Each kernel instance is a thin extern "C" wrapper around exact_Kernel, see xgboost_exact_0.cpp.
+#ifndef XGBOOST_EXACT_H
+#define XGBOOST_EXACT_H
+
+#include <ap_int.h>
+#include <ap_fixed.h>
+#include <hls_stream.h>
+#include "xgboost_exact_config.h"
+
+//*************************************************
+// type definitions
+  typedef ap_uint<256>                      float8;
+  typedef ap_uint<512>                      float16;
+  typedef ap_uint<32*xgboost_exact::kStatCount> StatsP;
+  typedef ap_uint<16>                       NID;
+  typedef ap_uint<NID::width*8>             NID8;
+  typedef ap_uint<16>                       EPOCH;
+  typedef ap_uint<64>                       EntryP;
+  typedef ap_uint<32>                       EntryC;
+  typedef ap_uint<256>                      SplitP;
+  typedef ap_uint<SplitP::width*2>          SplitP2;
+  typedef ap_uint<64>                       GSP;
+  typedef ap_uint<GSP::width*8>             GSP8;
+  typedef ap_uint<256>                      SeedP;
+//*************************************************
+// basic type functions
+  static float unpack_float(unsigned in)
+  {
+    #pragma HLS inline
+    return *(float*)(&in);
+  }
+  static unsigned pack_float(float in)
+  {
+    #pragma HLS inline
+    return *(unsigned*)(&in);
+  }
+  // bit level access to the accumulator type, fixed point or float, so that the
+  // structs below pack and unpack either one
+  template <typename T> struct Accum;
+  template <int W, int I>
+  struct Accum<ap_fixed<W, I> >
+  {
+    typedef ap_fixed<W, I> T;
+    static const int width = W;
+    // width and integer bits, reported to the host in the split records
+    static const unsigned tag = (W << 8) | I;
+    static ap_uint<W> bits(T v)
+    {
+      #pragma HLS inline
+      ap_uint<W> b;
+      b.range(W-1, 0) = v.range();
+      return b;
+    }
+    static T from_bits(const ap_uint<W>& b)
+    {
+      #pragma HLS inline
+      T v;
+      v.range() = b;
+      return v;
+    }
+    static float to_float(T v)
+    {
+      #pragma HLS inline
+      return v.to_float();
+    }
+    // the smallest positive value
+    static T eps()
+    {
+      #pragma HLS inline
+      T v = 0;
+      v.bit(0) = 1;
+      return v;
+    }
+    // compact entries keep the ranks as raw bits
+    static T from_rank(unsigned rank)
+    {
+      #pragma HLS inline
+      ap_uint<W> b = rank;
+      return from_bits(b);
+    }
+    static unsigned to_rank(T v)
+    {
+      #pragma HLS inline
+      return bits(v).range(31, 0).to_uint();
+    }
+  };
+  template <>
+  struct Accum<float>
+  {
+    typedef float T;
+    static const int width = 32;
+    static const unsigned tag = 0x80000000 | (32 << 8);
+    static ap_uint<32> bits(T v)
+    {
+      #pragma HLS inline
+      return pack_float(v);
+    }
+    static T from_bits(const ap_uint<32>& b)
+    {
+      #pragma HLS inline
+      return unpack_float(b.to_uint());
+    }
+    static float to_float(T v)
+    {
+      #pragma HLS inline
+      return v;
+    }
+    static T eps()
+    {
+      #pragma HLS inline
+      return 1e-6f;
+    }
+    // ranks are kept as float values, as raw bits they would be denormals
+    static T from_rank(unsigned rank)
+    {
+      #pragma HLS inline
+      return (float)rank;
+    }
+    static unsigned to_rank(T v)
+    {
+      #pragma HLS inline
+      return (unsigned)v;
+    }
+  };
+//*************************************************
+// Needed structs + struct functions
+  struct Entry
+  {
+    unsigned index;
+    float fvalue;
+    unsigned rank;
+    Entry& from_EntryP( EntryP in)
+    {
+      #pragma HLS inline
+      index = in.range(31, 0).to_uint();
+      fvalue = unpack_float(in.range(63, 32).to_uint());
+      return *this;
+    }
+    // compact entry: 16-bit row index, 16-bit rank of the value inside the feature
+    Entry& from_EntryC( EntryC in)
+    {
+      #pragma HLS inline
+      index = in.range(15, 0).to_uint();
+      rank = in.range(31, 16).to_uint();
+      return *this;
+    }
+  };
+  template <typename fixed>
+  struct GradStatsFixed
+  {
+    typedef ap_uint<Accum<fixed>::width*2> GSFP;
+    fixed sum_grad;
+    fixed sum_hess;
+    GradStatsFixed operator+(const GradStatsFixed& in)
+    {
+      #pragma HLS inline
+      GradStatsFixed out;
+      out.sum_grad = sum_grad + in.sum_grad;
+      out.sum_hess = sum_hess + in.sum_hess;
+      return out;
+    }
+    GradStatsFixed operator-(const GradStatsFixed& in)
+    {
+      #pragma HLS inline
+      GradStatsFixed out;
+      out.sum_grad = sum_grad - in.sum_grad;
+      out.sum_hess = sum_hess - in.sum_hess;
+      return out;
+    }
+    GSFP to_GSFP()
+    {
+      #pragma HLS inline
+      GSFP tmp;
+      tmp.range(Accum<fixed>::width-1, 0) = Accum<fixed>::bits(sum_grad);
+      tmp.range(Accum<fixed>::width*2-1, Accum<fixed>::width) = Accum<fixed>::bits(sum_hess);
+      return tmp;
+    }
+    GradStatsFixed& from_GSFP(const GSFP& in)
+    {
+      #pragma HLS inline
+      sum_grad = Accum<fixed>::from_bits(in.range(Accum<fixed>::width-1, 0));
+      sum_hess = Accum<fixed>::from_bits(in.range(Accum<fixed>::width*2-1, Accum<fixed>::width));
+      return *this;
+    }
+    GSP to_GSP();
+    GradStatsFixed& from_GSP(const GSP& in);
+  };
+  struct GradStats
+  {
+    float sum_grad;
+    float sum_hess;
+    GSP to_GSP()
+    {
+      #pragma HLS inline
+      GSP tmp;
+      tmp.range(31, 0) = pack_float(sum_grad);
+      tmp.range(63, 32) = pack_float(sum_hess);
+      return tmp;
+    }
+    GradStats& from_GSP(const GSP& in)
+    {
+      #pragma HLS inline
+      sum_grad = unpack_float(in.range(31, 0));
+      sum_hess = unpack_float(in.range(63, 32));
+      return *this;
+    }
+  };
+  template <typename fixed>
+  GSP GradStatsFixed<fixed>::to_GSP()
+  {
+    #pragma HLS inline
+    GradStats tmp;
+    tmp.sum_grad = Accum<fixed>::to_float(sum_grad);
+    tmp.sum_hess = Accum<fixed>::to_float(sum_hess);
+    return tmp.to_GSP();
+  }
+  template <typename fixed>
+  GradStatsFixed<fixed>& GradStatsFixed<fixed>::from_GSP(const GSP& in)
+  {
+    #pragma HLS inline
+    GradStats tmp;
+    tmp.from_GSP(in);
+    sum_grad = tmp.sum_grad;
+    sum_hess = tmp.sum_hess;
+    return *this;
+  }
+  template <typename fixed>
+  struct EntryInfo
+  {
+    typedef ap_uint<Accum<fixed>::width*2+NID::width> EIP;
+    fixed gpair_grad;
+    fixed gpair_hess;
+    NID nid;
+    EIP to_EIP()
+    {
+      #pragma HLS inline
+      EIP tmp;
+      tmp.range(Accum<fixed>::width-1, 0) = Accum<fixed>::bits(gpair_grad);
+      tmp.range(Accum<fixed>::width*2-1, Accum<fixed>::width) = Accum<fixed>::bits(gpair_hess);
+      tmp.range(Accum<fixed>::width*2+NID::width-1, Accum<fixed>::width*2) = nid;
+      return tmp;
+    }
+    EntryInfo& from_EIP(const EIP& in)
+    {
+      #pragma HLS inline
+      gpair_grad = Accum<fixed>::from_bits(in.range(Accum<fixed>::width-1, 0));
+      gpair_hess = Accum<fixed>::from_bits(in.range(Accum<fixed>::width*2-1, Accum<fixed>::width));
+      nid = in.range(Accum<fixed>::width*2+NID::width-1, Accum<fixed>::width*2);
+      return *this;
+    }
+  };
+  template <typename fixed>
+  struct NodeInfo
+  {
+    typedef ap_uint<Accum<fixed>::width*5> NIP;
+    fixed nstats_grad;
+    fixed nstats_hess;
+    fixed nrg;
+    // bounds of the child weights, set by the monotone constraints of the ancestors
+    fixed wlower;
+    fixed wupper;
+    NIP to_NIP()
+    {
+      #pragma HLS inline
+      NIP tmp;
+      tmp.range(Accum<fixed>::width-1, 0) = Accum<fixed>::bits(nstats_grad);
+      tmp.range(Accum<fixed>::width*2-1, Accum<fixed>::width) = Accum<fixed>::bits(nstats_hess);
+      tmp.range(Accum<fixed>::width*3-1, Accum<fixed>::width*2) = Accum<fixed>::bits(nrg);
+      tmp.range(Accum<fixed>::width*4-1, Accum<fixed>::width*3) = Accum<fixed>::bits(wlower);
+      tmp.range(Accum<fixed>::width*5-1, Accum<fixed>::width*4) = Accum<fixed>::bits(wupper);
+      return tmp;
+    }
+    NodeInfo& from_NIP(const NIP& in)
+    {
+      #pragma HLS inline
+      nstats_grad = Accum<fixed>::from_bits(in.range(Accum<fixed>::width-1, 0));
+      nstats_hess = Accum<fixed>::from_bits(in.range(Accum<fixed>::width*2-1, Accum<fixed>::width));
+      nrg = Accum<fixed>::from_bits(in.range(Accum<fixed>::width*3-1, Accum<fixed>::width*2));
+      wlower = Accum<fixed>::from_bits(in.range(Accum<fixed>::width*4-1, Accum<fixed>::width*3));
+      wupper = Accum<fixed>::from_bits(in.range(Accum<fixed>::width*5-1, Accum<fixed>::width*4));
+      return *this;
+    }
+  };
+  // scan state of a node; only valid when epoch matches the current scan,
+  // so that it needs no clearing between the scans of the feature blocks
+  template <typename fixed>
+  struct NodeTmpData
+  {
+    fixed accum_grad;
+    fixed accum_hess;
+    fixed prev_fvalue;
+    EPOCH epoch;
+  };
+  template <typename fixed>
+  struct Split
+  {
+    fixed loss_chg;
+    unsigned sindex;
+    fixed fvalue;
+    fixed left_child_grad;
+    fixed left_child_hess;
+    bool worse(Split &new_split)
+    {
+      #pragma HLS inline
+      return new_split.loss_chg > loss_chg ||
+          ((new_split.loss_chg == loss_chg) &
+           ((new_split.sindex&0x7fffffff) <= (sindex&0x7fffffff)));
+    }
+    SplitP pack_split(bool raw_fvalue)
+    {
+      #pragma HLS inline
+      SplitP split_out;
+      split_out.range(31,0) = pack_float(Accum<fixed>::to_float(loss_chg));
+      split_out.range(63,32) = sindex;
+      if(raw_fvalue) split_out.range(95,64) = Accum<fixed>::bits(fvalue).range(31,0);
+      else split_out.range(95,64) = pack_float(Accum<fixed>::to_float(fvalue));
+      split_out.range(127,96) = pack_float(Accum<fixed>::to_float(left_child_grad));
+      split_out.range(159,128) = pack_float(Accum<fixed>::to_float(left_child_hess));
+      // the accumulator precision, checked by the host against its scaling
+      split_out.range(191,160) = Accum<fixed>::tag;
+      split_out.range(255,192) = 0;
+      return split_out;
+    }
+  };
+//*************************************************
+// calc functions
+  template <typename fixed>
+  static fixed calc_Gain(  GradStatsFixed<fixed> stats,
+              fixed         param_min_child_weight,
+              fixed         param_max_delta_step,
+              fixed         param_reg_alpha,
+              fixed         param_reg_lambda
+            )
+  {
+    #pragma HLS inline
+    fixed zero = 0.0f;
+    fixed two = 2.0f;
+    fixed new_hess = stats.sum_hess + param_reg_lambda;
+    fixed new_grad_plus = stats.sum_grad + param_reg_alpha;
+    fixed new_grad_minus = stats.sum_grad - param_reg_alpha;
+    fixed new_grad;
+    if (stats.sum_grad > param_reg_alpha)     new_grad = new_grad_minus;
+    else if (stats.sum_grad < -param_reg_alpha) new_grad = new_grad_plus;
+    else                     new_grad = 0.0f;
+    fixed tmp_div = new_grad/new_hess;
+    fixed gain_p1 = new_grad*tmp_div;
+    fixed weight = -tmp_div;
+    fixed weight_abs;
+    if(weight >= zero) weight_abs = weight;
+    else          weight_abs = -weight;
+    fixed gain_p2 = param_reg_alpha * weight_abs;
+    fixed new_weight;
+    if (param_max_delta_step != zero && weight > param_max_delta_step)
+      new_weight = param_max_delta_step;
+    else if (param_max_delta_step != zero && weight < -param_max_delta_step)
+      new_weight = -param_max_delta_step;
+    else
+      new_weight = weight;
+    fixed gain_p3 = two * stats.sum_grad * new_weight;
+    fixed score;
+    if (param_max_delta_step == zero) score = gain_p1;
+    else score = -(gain_p1 + gain_p2) + gain_p3;
+    return score;
+  }
+  // the weight of a child as the elastic net evaluator computes it, clamped
+  // to the bounds of the node for the monotone constraints
+  template <typename fixed>
+  static fixed calc_Weight(  GradStatsFixed<fixed> stats,
+                fixed         param_max_delta_step,
+                fixed         param_reg_alpha,
+                fixed         param_reg_lambda,
+                fixed         wlower,
+                fixed         wupper
+              )
+  {
+    #pragma HLS inline
+    fixed zero = 0.0f;
+    fixed new_grad;
+    if (stats.sum_grad > param_reg_alpha)     new_grad = stats.sum_grad - param_reg_alpha;
+    else if (stats.sum_grad < -param_reg_alpha) new_grad = stats.sum_grad + param_reg_alpha;
+    else                     new_grad = 0.0f;
+    fixed weight = -(new_grad/(stats.sum_hess + param_reg_lambda));
+    if (param_max_delta_step != zero && weight > param_max_delta_step)
+      weight = param_max_delta_step;
+    else if (param_max_delta_step != zero && weight < -param_max_delta_step)
+      weight = -param_max_delta_step;
+    if (weight < wlower) weight = wlower;
+    else if (weight > wupper) weight = wupper;
+    return weight;
+  }
+  // the score of a child at the given weight
+  template <typename fixed>
+  static fixed calc_Score(  GradStatsFixed<fixed> stats,
+                fixed         weight,
+                fixed         param_reg_alpha,
+                fixed         param_reg_lambda
+              )
+  {
+    #pragma HLS inline
+    fixed zero = 0.0f;
+    fixed two = 2.0f;
+    fixed weight_abs;
+    if(weight >= zero) weight_abs = weight;
+    else          weight_abs = -weight;
+    fixed loss = weight*(two*stats.sum_grad + (stats.sum_hess + param_reg_lambda)*weight) +
+                 two*param_reg_alpha*weight_abs;
+    return -loss;
+  }
+  // the gain of a split; constrained splits are scored at the clamped child weights,
+  // and mono_valid is cleared when the weights break the direction of the feature
+  template <unsigned LANES, typename fixed>
+  static fixed calc_Split_Gain(  GradStatsFixed<fixed> left,
+                  GradStatsFixed<fixed> right,
+                  fixed       param_min_child_weight,
+                  fixed       param_max_delta_step,
+                  fixed       param_reg_alpha,
+                  fixed       param_reg_lambda,
+                  fixed       wlower,
+                  fixed       wupper,
+                  ap_uint<2>  mono,
+                  bool        constrained,
+                  bool        &mono_valid
+                )
+  {
+    #pragma HLS allocation instances=calc_Split_Gain limit=LANES function
+    #pragma HLS inline off
+    fixed gain;
+    if(constrained)
+    {
+      fixed weightLeft = calc_Weight(left, param_max_delta_step, param_reg_alpha, param_reg_lambda,
+                                     wlower, wupper);
+      fixed weightRight = calc_Weight(right, param_max_delta_step, param_reg_alpha, param_reg_lambda,
+                                      wlower, wupper);
+      gain = calc_Score(left, weightLeft, param_reg_alpha, param_reg_lambda) +
+             calc_Score(right, weightRight, param_reg_alpha, param_reg_lambda);
+      mono_valid = !((mono == xgboost_exact::kMonoInc && weightLeft > weightRight) ||
+                     (mono == xgboost_exact::kMonoDec && weightLeft < weightRight));
+    }
+    else
+    {
+      fixed gainLeft = calc_Gain( left,
+                    param_min_child_weight,
+                    param_max_delta_step,
+                    param_reg_alpha,
+                    param_reg_lambda);
+      fixed gainRight = calc_Gain( right,
+                    param_min_child_weight,
+                    param_max_delta_step,
+                    param_reg_alpha,
+                    param_reg_lambda);
+      gain = gainLeft + gainRight;
+      mono_valid = true;
+    }
+    return gain;
+  }
+  // the best split among the lanes, by a reduction tree
+  template <unsigned LANES, typename fixed>
+  static Split<fixed> reduce_Splits(  Split<fixed> best[LANES]
+                )
+  {
+    #pragma HLS inline
+    U_best: for(unsigned step=1; step<LANES; step<<=1)
+    {
+      #pragma HLS unroll
+      U_best_step: for(unsigned u=0; u+step<LANES; u+=(step<<1))
+      {
+        #pragma HLS unroll
+        if (best[u].worse(best[u+step]))
+          best[u] = best[u+step];
+      }
+    }
+    return best[0];
+  }
+  // the best split of node n among the lanes
+  template <unsigned LANES, unsigned MAX_NODE_NUM, typename fixed>
+  static Split<fixed> best_Split(  unsigned       n,
+                  Split<fixed> tmp_best_split_uram[LANES][MAX_NODE_NUM]
+                )
+  {
+    #pragma HLS inline
+    Split<fixed> best[LANES];
+    #pragma HLS array_partition variable=best complete
+    U_read: for(unsigned u=0; u<LANES; u++)
+    {
+      #pragma HLS unroll
+      best[u] = tmp_best_split_uram[u][n];
+    }
+    return reduce_Splits<LANES, fixed>(best);
+  }
+  template <unsigned LANES, unsigned MAX_NODE_NUM, typename fixed>
+  static SplitP keep_Best(  unsigned       n,
+                  Split<fixed> tmp_best_split_uram[LANES][MAX_NODE_NUM],
+                  bool        raw_fvalue
+                )
+  {
+    #pragma HLS inline
+    return best_Split<LANES, MAX_NODE_NUM, fixed>(n, tmp_best_split_uram).pack_split(raw_fvalue);
+  }
+  // the entry word of a row (or of two rows, for compact entries) of a block; with two
+  // ports the lower half of the lanes comes from entries and the upper from entries_hi
+  template <unsigned LANES, unsigned PORTS>
+  static ap_uint<EntryP::width*LANES> read_Entries(  ap_uint<EntryP::width*LANES/PORTS> *entries,
+                          ap_uint<EntryP::width*LANES/PORTS> *entries_hi,
+                          unsigned         word
+                        )
+  {
+    #pragma HLS inline
+    ap_uint<EntryP::width*LANES> entries_in;
+    entries_in.range(EntryP::width*LANES/PORTS-1, 0) = entries[word];
+    if(PORTS > 1)
+      entries_in.range(EntryP::width*LANES-1, EntryP::width*LANES/PORTS) = entries_hi[word];
+    return entries_in;
+  }
+  // the position of the compact entry of lane u in the word of rows e and e+1: each
+  // port word holds the two rows of its lanes
+  template <unsigned LANES, unsigned PORTS>
+  static unsigned compact_Slot(  unsigned       e,
+                  unsigned       u
+                )
+  {
+    #pragma HLS inline
+    return (u/(LANES/PORTS))*2*(LANES/PORTS) + (e&0x1)*(LANES/PORTS) + u%(LANES/PORTS);
+  }
+  // the value that is compared and kept as prev_fvalue: the float value,
+  // or the raw rank of the value for compact entries
+  template <typename fixed>
+  static fixed entry_Value(  Entry   entry,
+                bool    compact_entries
+              )
+  {
+    #pragma HLS inline
+    fixed value;
+    if(compact_entries) value = Accum<fixed>::from_rank(entry.rank);
+    else value = entry.fvalue;
+    return value;
+  }
+  // the threshold below the first value, that sends every present value right
+  template <typename fixed>
+  static fixed first_Split_Value(  fixed   value,
+                      bool    compact_entries
+                    )
+  {
+    #pragma HLS inline
+    fixed kRtEps = Accum<fixed>::eps();
+    fixed value_abs;
+    if(value >= 0) value_abs = value;
+    else value_abs = -value;
+    fixed split_value;
+    // compact entries: the rank of the value, flagged by an all ones second rank
+    if(compact_entries)
+    {
+      EntryC bits = Accum<fixed>::to_rank(value);
+      EntryC split_bits;
+      split_bits.range(31,16) = bits.range(15,0);
+      split_bits.range(15,0) = 0xffff;
+      split_value = Accum<fixed>::from_bits(split_bits);
+    }
+    else split_value = value - (value_abs + kRtEps);
+    return split_value;
+  }
+  // the threshold between two adjacent values; for compact entries the ranks of
+  // the two values are passed to the host, which holds the rank to value tables
+  template <typename fixed>
+  static fixed split_Value(  fixed   prev_value,
+                fixed   value,
+                bool    compact_entries
+              )
+  {
+    #pragma HLS inline
+    fixed half = 0.5f;
+    fixed split_value;
+    if(compact_entries)
+    {
+      EntryC prev_bits = Accum<fixed>::to_rank(prev_value);
+      EntryC bits = Accum<fixed>::to_rank(value);
+      EntryC split_bits;
+      split_bits.range(31,16) = prev_bits.range(15,0);
+      split_bits.range(15,0) = bits.range(15,0);
+      split_value = Accum<fixed>::from_bits(split_bits);
+    }
+    else split_value = (prev_value + value)*half;
+    return split_value;
+  }
+  // whether a present value goes left of a split: below the threshold, or for compact
+  // entries up to the rank of the lower value, none for the split below the first value
+  template <typename fixed>
+  static bool goes_Left(  fixed   value,
+                fixed   split_value,
+                bool    compact_entries
+              )
+  {
+    #pragma HLS inline
+    bool left;
+    if(compact_entries)
+    {
+      EntryC bits = Accum<fixed>::to_rank(value);
+      EntryC split_bits = Accum<fixed>::bits(split_value).range(31,0);
+      left = (split_bits.range(15,0) != 0xffff) && (bits.range(15,0) <= split_bits.range(31,16));
+    }
+    else left = (value < split_value);
+    return left;
+  }
+  // the info of node u of a word of 8 nodes: the stats, the root gain, and the
+  // lower bounds of the 8 nodes followed by their upper bounds
+  template <typename fixed>
+  static NodeInfo<fixed> unpack_Node_Info(  GSP8     nstats_in,
+                float8   nrg_in,
+                float16  bounds_in,
+                unsigned u
+              )
+  {
+    #pragma HLS inline
+    GradStatsFixed<fixed> tmpGSF;
+    tmpGSF.from_GSP(nstats_in.range((u+1)*GSP::width-1, u*GSP::width));
+    NodeInfo<fixed> tmpNI;
+    tmpNI.nstats_grad = tmpGSF.sum_grad;
+    tmpNI.nstats_hess = tmpGSF.sum_hess;
+    tmpNI.nrg = unpack_float(nrg_in.range((u+1)*32 -1, u*32));
+    tmpNI.wlower = unpack_float(bounds_in.range((u+1)*32 -1, u*32));
+    tmpNI.wupper = unpack_float(bounds_in.range((u+9)*32 -1, (u+8)*32));
+    return tmpNI;
+  }
+//*************************************************
+// scan stages: the feature blocks are streamed through a reader, a lookup and
+// a compute stage running as a dataflow, so that the reads of the next block
+// and the table lookups overlap with the split evaluation
+  // the masks of a block, passed along with its entries
+  template <unsigned LANES>
+  struct BlockCtl
+  {
+    ap_uint<LANES> valid;
+    bool single_pass;
+    // monotone direction of every lane, 2 bits each
+    ap_uint<2*LANES> mono;
+  };
+  // an entry of a lane, with the row and node data it was looked up with
+  template <typename fixed>
+  struct LaneData
+  {
+    NID nid;
+    bool nid_valid;
+    fixed fvalue;
+    fixed gpair_grad;
+    fixed gpair_hess;
+    fixed nstats_grad;
+    fixed nstats_hess;
+    fixed nrg;
+    fixed wlower;
+    fixed wupper;
+  };
+  // reads the masks and the entry words of every block, once per scan; with per node
+  // feature masks the masks of the block for every node come first
+  template <unsigned LANES, unsigned PORTS>
+  static void read_Stage(  unsigned       feature_num_pl,
+                unsigned       node_num,
+                unsigned       entry_word_batch,
+                bool         node_masks,
+                bool         range_seeds,
+                ap_uint<EntryP::width*LANES/PORTS> *entries,
+                ap_uint<EntryP::width*LANES/PORTS> *entries_hi,
+                ap_uint<LANES>     *fvalid,
+                ap_uint<LANES>     *fdense,
+                ap_uint<2*LANES>   *fmono,
+                ap_uint<LANES>     *nfmask,
+                SeedP        *node_seeds,
+                hls::stream<BlockCtl<LANES> >   &ctl_out,
+                hls::stream<ap_uint<LANES> >    &fmask_out,
+                hls::stream<SeedP>              &seeds_out,
+                hls::stream<ap_uint<EntryP::width*LANES> > &entries_out,
+                unsigned       &stat_blocks,
+                unsigned       &stat_read_words,
+                unsigned       &stat_read_stalls,
+                unsigned       &stat_seed_words
+              )
+  {
+    #pragma HLS inline off
+    unsigned blocks = 0;
+    unsigned read_words = 0;
+    unsigned read_stalls = 0;
+    unsigned seed_words = 0;
+    R_Feature_Loop: for(unsigned fp = 0; fp < feature_num_pl; fp++)
+    {
+      #pragma HLS loop_tripcount min=384 max=384
+      BlockCtl<LANES> ctl;
+      ctl.valid = fvalid[fp];
+      ap_uint<LANES> dense = fdense[fp];
+      // without missing values both default directions give the same candidates:
+      // a single forward scan is enough, with the candidates flagged default left
+      // as the backward scan of the cpu updater for dense features
+      ctl.single_pass = ((ctl.valid & ~dense) == 0);
+      ctl.mono = fmono[fp];
+      ctl_out.write(ctl);
+      if(ctl.valid > 0)
+      {
+        blocks++;
+        if(node_masks)
+        {
+          P_Read_Mask_Loop: for(unsigned n = 0; n < node_num; n++)
+          {
+            #pragma HLS loop_tripcount min=20 max=2048
+            #pragma HLS pipeline II=1
+            fmask_out.write(nfmask[fp*node_num + n]);
+          }
+        }
+        unsigned pass_num = ctl.single_pass ? 1 : 2;
+        read_words += pass_num*entry_word_batch;
+        R_Pass_Loop: for(unsigned pass = 0; pass < pass_num; pass++)
+        {
+          #pragma HLS loop_tripcount min=1 max=2
+          // the state of every node and lane at the start of the value range, ahead
+          // of the entries of each scan
+          if(range_seeds)
+          {
+            seed_words += node_num*LANES;
+            P_Read_Seed_Loop: for(unsigned k = 0; k < node_num*LANES; k++)
+            {
+              #pragma HLS loop_tripcount min=160 max=16384
+              #pragma HLS pipeline II=1
+              seeds_out.write(node_seeds[fp*node_num*LANES + k]);
+            }
+          }
+          P_Read_Loop: for(unsigned w = 0; w < entry_word_batch; w++)
+          {
+            #pragma HLS loop_tripcount min=50000 max=50000
+            #pragma HLS pipeline II=1
+            // the compute side holding back the reads
+            if(entries_out.full()) read_stalls++;
+            entries_out.write(read_Entries<LANES, PORTS>(entries, entries_hi,
+                              fp*entry_word_batch + w));
+          }
+        }
+      }
+    }
+    stat_blocks = blocks;
+    stat_read_words = read_words;
+    stat_read_stalls = read_stalls;
+    stat_seed_words = seed_words;
+  }
+  // decodes the entries and looks up their rows and nodes
+  template <unsigned LANES, unsigned PORTS, unsigned MAX_ENTRY_NUM, unsigned MAX_NODE_NUM, typename fixed>
+  static void lookup_Stage(  unsigned       entry_num,
+                unsigned       feature_num,
+                unsigned       feature_num_pl,
+                unsigned       node_num,
+                unsigned       entry_num_batch,
+                bool         compact,
+                bool         node_masks,
+                typename EntryInfo<fixed>::EIP local_EntryInfo_uram[LANES/2][MAX_ENTRY_NUM],
+                typename NodeInfo<fixed>::NIP local_NodeInfo_uram[LANES/2][MAX_NODE_NUM],
+                hls::stream<BlockCtl<LANES> >   &ctl_in,
+                hls::stream<ap_uint<LANES> >    &fmask_in,
+                hls::stream<ap_uint<EntryP::width*LANES> > &entries_in,
+                hls::stream<BlockCtl<LANES> >   &ctl_out,
+                hls::stream<LaneData<fixed> >   lanes_out[LANES],
+                unsigned       &stat_scan,
+                unsigned       &stat_padding,
+                unsigned       &stat_inactive,
+                unsigned       &stat_masked
+              )
+  {
+    #pragma HLS inline off
+    unsigned scan = 0;
+    unsigned padding = 0;
+    unsigned inactive = 0;
+    unsigned masked = 0;
+    // the features of the current block that every node may split on
+    ap_uint<LANES> local_fmask[LANES/2][MAX_NODE_NUM];
+    #pragma HLS array_partition variable=local_fmask complete dim=1
+    L_Feature_Loop: for(unsigned fp = 0; fp < feature_num_pl; fp++)
+    {
+      #pragma HLS loop_tripcount min=384 max=384
+      BlockCtl<LANES> ctl = ctl_in.read();
+      ctl_out.write(ctl);
+      if(ctl.valid > 0)
+      {
+        if(node_masks)
+        {
+          P_Mask_Loop: for(unsigned n = 0; n < node_num; n++)
+          {
+            #pragma HLS loop_tripcount min=20 max=2048
+            #pragma HLS pipeline II=1
+            ap_uint<LANES> mask = fmask_in.read();
+            U_Mask_Copies: for (unsigned c = 0; c < LANES/2; c++)
+            {
+              #pragma HLS unroll
+              local_fmask[c][n] = mask;
+            }
+          }
+        }
+        unsigned entry_num_scan = ctl.single_pass ? entry_num_batch : (entry_num_batch<<1);
+        scan += entry_num_scan;
+        ap_uint<EntryP::width*LANES> entries_p_in;
+        P_Lookup_Loop: for(unsigned s = 0; s < entry_num_scan; s++)
+        {
+          #pragma HLS loop_tripcount min=50000 max=100000
+          #pragma HLS pipeline II=1
+          unsigned e = (s < entry_num_batch) ? s : (s - entry_num_batch);
+          if(!compact || ((e&0x1) == 0)) entries_p_in = entries_in.read();
+          ap_uint<LANES> lane_padding = 0;
+          ap_uint<LANES> lane_inactive = 0;
+          ap_uint<LANES> lane_masked = 0;
+          U_Lookup_Loop: for (unsigned u = 0; u < LANES; u++)
+          {
+            #pragma HLS unroll
+            Entry new_entry;
+            unsigned slot = compact_Slot<LANES, PORTS>(e, u);
+            if(compact) new_entry.from_EntryC(entries_p_in.range((slot+1)*EntryC::width-1, slot*EntryC::width));
+            else new_entry.from_EntryP(entries_p_in.range((u+1)*EntryP::width-1, u*EntryP::width));
+            bool feature_valid = ((fp*LANES+u) < feature_num) && (ctl.valid.bit(u) == 1);
+            bool new_entry_valid = feature_valid && (new_entry.index < entry_num);
+            EntryInfo<fixed> new_entry_info;
+            new_entry_info.nid = -1;
+            new_entry_info.gpair_grad = 0;
+            new_entry_info.gpair_hess = 0;
+            if(new_entry_valid) new_entry_info.from_EIP(local_EntryInfo_uram[u>>1][new_entry.index]);
+            LaneData<fixed> lane;
+            lane.nid = new_entry_info.nid;
+            lane.nid_valid = (new_entry_info.nid < node_num) & new_entry_valid;
+            // the entries of a feature masked for their node are dropped from its scan
+            bool node_active = lane.nid_valid;
+            if(node_masks & lane.nid_valid)
+              lane.nid_valid = (local_fmask[u>>1][new_entry_info.nid & (MAX_NODE_NUM-1)].bit(u) == 1);
+            lane_masked[u] = !feature_valid || (node_active && !lane.nid_valid);
+            lane_padding[u] = feature_valid & !new_entry_valid;
+            lane_inactive[u] = new_entry_valid & !node_active;
+            lane.fvalue = entry_Value<fixed>(new_entry, compact);
+            lane.gpair_grad = new_entry_info.gpair_grad;
+            lane.gpair_hess = new_entry_info.gpair_hess;
+            NodeInfo<fixed> new_node_info;
+            new_node_info.nstats_grad = 0;
+            new_node_info.nstats_hess = 0;
+            new_node_info.nrg = 0;
+            new_node_info.wlower = 0;
+            new_node_info.wupper = 0;
+            if(lane.nid_valid) new_node_info.from_NIP(local_NodeInfo_uram[u>>1][new_entry_info.nid]);
+            lane.nstats_grad = new_node_info.nstats_grad;
+            lane.nstats_hess = new_node_info.nstats_hess;
+            lane.nrg = new_node_info.nrg;
+            lane.wlower = new_node_info.wlower;
+            lane.wupper = new_node_info.wupper;
+            lanes_out[u].write(lane);
+          }
+          U_Count_Loop: for (unsigned u = 0; u < LANES; u++)
+          {
+            #pragma HLS unroll
+            padding += lane_padding[u];
+            inactive += lane_inactive[u];
+            masked += lane_masked[u];
+          }
+        }
+      }
+    }
+    stat_scan = scan;
+    stat_padding = padding;
+    stat_inactive = inactive;
+    stat_masked = masked;
+  }
+  // starts the scan of a value range of the columns from the state of every node and
+  // lane at its start: the sums and the last value of the entries before the range for
+  // the forward scan, the sums of the entries from the range on for the backward one;
+  // a node without entries before the range starts as in a whole column
+  template <unsigned LANES, unsigned MAX_NODE_NUM, typename fixed>
+  static void seed_Scan(  unsigned       node_num,
+                bool         backward,
+                EPOCH        epoch,
+                bool         compact,
+                NodeTmpData<fixed> tmp_ndata_uram[LANES][MAX_NODE_NUM],
+                hls::stream<SeedP> &seeds_in
+              )
+  {
+    #pragma HLS inline
+    P_Seed_Loop: for(unsigned k = 0; k < node_num*LANES; k++)
+    {
+      #pragma HLS loop_tripcount min=160 max=16384
+      #pragma HLS pipeline II=1
+      SeedP seed = seeds_in.read();
+      unsigned n = k / LANES;
+      unsigned u = k % LANES;
+      GradStatsFixed<fixed> sums;
+      if(backward) sums.from_GSP(seed.range(127, 64));
+      else sums.from_GSP(seed.range(63, 0));
+      Entry prev;
+      prev.rank = seed.range(159, 128).to_uint();
+      prev.fvalue = unpack_float(prev.rank);
+      NodeTmpData<fixed> tmp_ndata;
+      tmp_ndata.accum_grad = sums.sum_grad;
+      tmp_ndata.accum_hess = sums.sum_hess;
+      tmp_ndata.prev_fvalue = entry_Value<fixed>(prev, compact);
+      tmp_ndata.epoch = (seed.bit(160) == 1) ? epoch : EPOCH(0);
+      tmp_ndata_uram[u][n & (MAX_NODE_NUM-1)] = tmp_ndata;
+    }
+  }
+  // accumulates the entries of every node and keeps the best split of every node
+  // and lane, in a forward and, unless all the block features are dense, a backward scan.
+  // The sums of a bundle lane restart at every value, so that the forward candidates
+  // send one bundled feature left and the first backward one the last feature right
+  template <unsigned LANES, unsigned MAX_NODE_NUM, typename fixed>
+  static void compute_Stage(  unsigned       feature_num_pl,
+                unsigned       node_num,
+                unsigned       entry_num_batch,
+                float        param_min_child_weight,
+                float        param_max_delta_step,
+                float        param_reg_alpha,
+                float        param_reg_lambda,
+                bool         compact,
+                bool         constrained,
+                bool         range_seeds,
+                NodeTmpData<fixed> tmp_ndata_uram[LANES][MAX_NODE_NUM],
+                Split<fixed>    tmp_best_split_uram[LANES][MAX_NODE_NUM],
+                hls::stream<BlockCtl<LANES> >   &ctl_in,
+                hls::stream<SeedP>              &seeds_in,
+                hls::stream<LaneData<fixed> >   lanes_in[LANES]
+              )
+  {
+    #pragma HLS inline off
+    fixed zero = 0.0f;
+    fixed one = 1.0f;
+    fixed p_min_child_weight = param_min_child_weight;
+    C_Feature_Loop: for(unsigned fp = 0; fp < feature_num_pl; fp++)
+    {
+      #pragma HLS loop_tripcount min=384 max=384
+      BlockCtl<LANES> ctl = ctl_in.read();
+      if(ctl.valid > 0)
+      {
+        bool single_pass = ctl.single_pass;
+        unsigned fw_default_left = single_pass ? 0x80000000 : 0;
+        EPOCH fw_epoch = (fp<<1) + 1;
+        EPOCH bw_epoch = (fp<<1) + 2;
+        bool curr_valid[LANES];
+        #pragma HLS array_partition variable=curr_valid complete
+        NID curr_nid[LANES];
+        #pragma HLS array_partition variable=curr_nid complete
+        NodeTmpData<fixed> curr_ndata[LANES];
+        #pragma HLS array_partition variable=curr_ndata complete
+        bool curr_best_valid[LANES];
+        #pragma HLS array_partition variable=curr_best_valid complete
+        NID curr_best_nid[LANES];
+        #pragma HLS array_partition variable=curr_best_nid complete
+        Split<fixed> curr_best_split[LANES];
+        #pragma HLS array_partition variable=curr_best_split complete
+        U_Init_Regs: for(unsigned u=0; u<LANES; u++)
+        {
+          #pragma HLS unroll
+          curr_valid[u] = false;
+          curr_nid[u] = -1;
+          curr_ndata[u].accum_grad = 0;
+          curr_ndata[u].accum_hess = 0;
+          curr_ndata[u].prev_fvalue = 0;
+          curr_ndata[u].epoch = 0;
+          curr_best_valid[u] = false;
+          curr_best_nid[u] = -1;
+          curr_best_split[u].fvalue = 0;
+          curr_best_split[u].sindex = 0;
+          curr_best_split[u].loss_chg = 0;
+          curr_best_split[u].left_child_grad = 0;
+          curr_best_split[u].left_child_hess = 0;
+        }
+        if(range_seeds)
+          seed_Scan<LANES, MAX_NODE_NUM, fixed>(node_num, false, fw_epoch, compact, tmp_ndata_uram, seeds_in);
+        P_Entry_Loop_FW: for(unsigned e = 0; e < entry_num_batch; e++)
+        {
+          #pragma HLS loop_tripcount min=50000 max=50000
+          #pragma HLS pipeline II=1
+          #pragma HLS dependence variable=tmp_ndata_uram intra false
+          #pragma HLS dependence variable=tmp_best_split_uram intra false
+          U_Entry_Loop_FW: for (unsigned u = 0; u < LANES; u++)
+          {
+            #pragma HLS unroll
+            LaneData<fixed> lane = lanes_in[u].read();
+            bool new_nid_valid = lane.nid_valid;
+            bool bundle = (ctl.mono.range(2*u+1, 2*u) == xgboost_exact::kMonoBundle);
+            bool nid_same = (curr_nid[u] == lane.nid);
+            NodeTmpData<fixed> tmp_ndata;
+            if(nid_same) tmp_ndata = curr_ndata[u];
+            else tmp_ndata = tmp_ndata_uram[u][lane.nid & (MAX_NODE_NUM-1)];
+            if(tmp_ndata.epoch != fw_epoch)
+            {
+              tmp_ndata.accum_grad = 0;
+              tmp_ndata.accum_hess = 0;
+              tmp_ndata.prev_fvalue = 0;
+            }
+            bool new_fvalue_valid = (tmp_ndata.prev_fvalue != lane.fvalue);
+            bool restart = bundle & new_fvalue_valid;
+            if(curr_valid[u]& !(nid_same & new_nid_valid)) tmp_ndata_uram[u][curr_nid[u]] = curr_ndata[u];
+            curr_nid[u] = lane.nid;
+            curr_valid[u] = new_nid_valid;
+            curr_ndata[u].accum_grad = (restart ? zero : tmp_ndata.accum_grad) + lane.gpair_grad;
+            curr_ndata[u].accum_hess = (restart ? zero : tmp_ndata.accum_hess) + lane.gpair_hess;
+            curr_ndata[u].prev_fvalue = lane.fvalue;
+            curr_ndata[u].epoch = fw_epoch;
+            Split<fixed> new_split;
+            // a bundled feature goes left below the next position
+            if(bundle) new_split.fvalue = split_Value(tmp_ndata.prev_fvalue, tmp_ndata.prev_fvalue + one, compact);
+            else new_split.fvalue = split_Value(tmp_ndata.prev_fvalue, lane.fvalue, compact);
+            GradStatsFixed<fixed> new_stats;
+            new_stats.sum_grad = tmp_ndata.accum_grad;
+            new_stats.sum_hess = tmp_ndata.accum_hess;
+            bool new_stats_valid = (new_stats.sum_hess != zero) &
+                         (new_stats.sum_hess >= p_min_child_weight);
+            GradStatsFixed<fixed> tmp_c;
+            tmp_c.sum_grad = lane.nstats_grad - new_stats.sum_grad;
+            tmp_c.sum_hess = lane.nstats_hess - new_stats.sum_hess;
+            bool tmp_c_valid = (tmp_c.sum_hess >= p_min_child_weight);
+            new_split.left_child_grad = tmp_ndata.accum_grad;
+            new_split.left_child_hess = tmp_ndata.accum_hess;
+            new_split.sindex = (fp*LANES+u) | fw_default_left;
+            bool mono_valid;
+            new_split.loss_chg = calc_Split_Gain<LANES, fixed>(  new_stats, tmp_c,
+                                                   param_min_child_weight,
+                                                   param_max_delta_step,
+                                                   param_reg_alpha,
+                                                   param_reg_lambda,
+                                                   lane.wlower, lane.wupper,
+                                                   ctl.mono.range(2*u+1, 2*u),
+                                                   constrained, mono_valid) - lane.nrg;
+            bool new_split_valid = new_nid_valid & new_fvalue_valid &
+                                   new_stats_valid & tmp_c_valid & mono_valid;
+            bool best_nid_same = (curr_best_nid[u] == lane.nid);
+            Split<fixed> tmp_split;
+            if(best_nid_same) tmp_split = curr_best_split[u];
+            else tmp_split = tmp_best_split_uram[u][lane.nid & (MAX_NODE_NUM-1)];
+            if(curr_best_valid[u]& !(best_nid_same & new_nid_valid))
+              tmp_best_split_uram[u][curr_best_nid[u]] = curr_best_split[u];
+            curr_best_nid[u] = lane.nid;
+            curr_best_valid[u] = new_nid_valid;
+            if(new_split_valid & tmp_split.worse(new_split))
+              curr_best_split[u] = new_split;
+            else curr_best_split[u] = tmp_split;
+          }
+        }
+        U_write_final_FW: for(unsigned u=0; u<LANES; u++)
+        {
+          #pragma HLS unroll
+          if(curr_valid[u]) tmp_ndata_uram[u][curr_nid[u]] = curr_ndata[u];
+          curr_nid[u] = -1;
+          curr_valid[u] = false;
+          if(curr_best_valid[u]) tmp_best_split_uram[u][curr_best_nid[u]] = curr_best_split[u];
+          curr_best_nid[u] = -1;
+          curr_best_valid[u] = false;
+        }
+        if(!single_pass)
+        {
+          if(range_seeds)
+            seed_Scan<LANES, MAX_NODE_NUM, fixed>(node_num, true, bw_epoch, compact, tmp_ndata_uram, seeds_in);
+          P_Entry_Loop_BW: for(unsigned e = 0; e < entry_num_batch; e++)
+          {
+            #pragma HLS loop_tripcount min=50000 max=50000
+            #pragma HLS pipeline II=1
+            #pragma HLS dependence variable=tmp_ndata_uram intra false
+            #pragma HLS dependence variable=tmp_best_split_uram intra false
+            U_Entry_Loop_BW: for (unsigned u = 0; u < LANES; u++)
+            {
+              #pragma HLS unroll
+              LaneData<fixed> lane = lanes_in[u].read();
+              bool new_nid_valid = lane.nid_valid;
+              bool bundle = (ctl.mono.range(2*u+1, 2*u) == xgboost_exact::kMonoBundle);
+              bool nid_same = (curr_nid[u] == lane.nid);
+              NodeTmpData<fixed> tmp_ndata;
+              if(nid_same) tmp_ndata = curr_ndata[u];
+              else tmp_ndata = tmp_ndata_uram[u][lane.nid & (MAX_NODE_NUM-1)];
+              // the first visit of a node starts from the totals of the forward scan, and
+              // evaluates the split with every present value right and the missing ones left
+              bool first_visit = (tmp_ndata.epoch != bw_epoch);
+              if(curr_valid[u]& !(nid_same & new_nid_valid)) tmp_ndata_uram[u][curr_nid[u]] = curr_ndata[u];
+              curr_nid[u] = lane.nid;
+              curr_valid[u] = new_nid_valid;
+              curr_ndata[u].accum_grad = tmp_ndata.accum_grad - lane.gpair_grad;
+              curr_ndata[u].accum_hess = tmp_ndata.accum_hess - lane.gpair_hess;
+              curr_ndata[u].prev_fvalue = lane.fvalue;
+              curr_ndata[u].epoch = bw_epoch;
+              Split<fixed> new_split;
+              // the forward sums of a bundle lane hold the last feature of the node,
+              // which goes right above the previous position
+              if(bundle) new_split.fvalue = split_Value(tmp_ndata.prev_fvalue - one, tmp_ndata.prev_fvalue, compact);
+              else if(first_visit) new_split.fvalue = first_Split_Value(lane.fvalue, compact);
+              else new_split.fvalue = split_Value(tmp_ndata.prev_fvalue, lane.fvalue, compact);
+              bool new_fvalue_valid = first_visit | (tmp_ndata.prev_fvalue != lane.fvalue);
+              // the present values from this entry on go right
+              GradStatsFixed<fixed> new_stats;
+              new_stats.sum_grad = tmp_ndata.accum_grad;
+              new_stats.sum_hess = tmp_ndata.accum_hess;
+              bool new_stats_valid = (new_stats.sum_hess != zero) &
+                           (new_stats.sum_hess >= p_min_child_weight);
+              GradStatsFixed<fixed> tmp_c;
+              tmp_c.sum_grad = lane.nstats_grad - new_stats.sum_grad;
+              tmp_c.sum_hess = lane.nstats_hess - new_stats.sum_hess;
+              bool tmp_c_valid = (tmp_c.sum_hess >= p_min_child_weight);
+              new_split.left_child_grad = tmp_c.sum_grad;
+              new_split.left_child_hess = tmp_c.sum_hess;
+              new_split.sindex = (fp*LANES+u) | 0x80000000;
+              bool mono_valid;
+              new_split.loss_chg = calc_Split_Gain<LANES, fixed>(  tmp_c, new_stats,
+                                                     param_min_child_weight,
+                                                     param_max_delta_step,
+                                                     param_reg_alpha,
+                                                     param_reg_lambda,
+                                                     lane.wlower, lane.wupper,
+                                                     ctl.mono.range(2*u+1, 2*u),
+                                                     constrained, mono_valid) - lane.nrg;
+              bool new_split_valid = new_nid_valid & new_fvalue_valid &
+                           new_stats_valid & tmp_c_valid & mono_valid & (first_visit | !bundle);
+              bool best_nid_same = (curr_best_nid[u] == lane.nid);
+              Split<fixed> tmp_split;
+              if(best_nid_same) tmp_split = curr_best_split[u];
+              else tmp_split = tmp_best_split_uram[u][lane.nid & (MAX_NODE_NUM-1)];
+              if(curr_best_valid[u]& !(best_nid_same & new_nid_valid))
+                tmp_best_split_uram[u][curr_best_nid[u]] = curr_best_split[u];
+              curr_best_nid[u] = lane.nid;
+              curr_best_valid[u] = new_nid_valid;
+              if(new_split_valid & tmp_split.worse(new_split))
+                curr_best_split[u] = new_split;
+              else curr_best_split[u] = tmp_split;
+            }
+          }
+          U_write_final_BW: for(unsigned u=0; u<LANES; u++)
+          {
+            #pragma HLS unroll
+            if(curr_valid[u]) tmp_ndata_uram[u][curr_nid[u]] = curr_ndata[u];
+            curr_nid[u] = -1;
+            curr_valid[u] = false;
+            if(curr_best_valid[u]) tmp_best_split_uram[u][curr_best_nid[u]] = curr_best_split[u];
+            curr_best_nid[u] = -1;
+            curr_best_valid[u] = false;
+          }
+        }
+      }
+    }
+  }
+  // the scan of all the feature blocks; the tables are filled before and read after it
+  template <unsigned LANES, unsigned PORTS, unsigned MAX_ENTRY_NUM, unsigned MAX_NODE_NUM, typename fixed>
+  static void scan_Blocks(  unsigned       entry_num,
+                unsigned       feature_num,
+                unsigned       node_num,
+                unsigned       entry_num_batch,
+                ap_uint<EntryP::width*LANES/PORTS> *entries,
+                ap_uint<EntryP::width*LANES/PORTS> *entries_hi,
+                ap_uint<LANES>     *fvalid,
+                ap_uint<LANES>     *fdense,
+                ap_uint<2*LANES>   *fmono,
+                ap_uint<LANES>     *nfmask,
+                SeedP        *node_seeds,
+                float        param_min_child_weight,
+                float        param_max_delta_step,
+                float        param_reg_alpha,
+                float        param_reg_lambda,
+                bool         compact,
+                bool         constrained,
+                bool         node_masks,
+                bool         range_seeds,
+                typename EntryInfo<fixed>::EIP local_EntryInfo_uram[LANES/2][MAX_ENTRY_NUM],
+                typename NodeInfo<fixed>::NIP local_NodeInfo_uram[LANES/2][MAX_NODE_NUM],
+                NodeTmpData<fixed> tmp_ndata_uram[LANES][MAX_NODE_NUM],
+                Split<fixed>    tmp_best_split_uram[LANES][MAX_NODE_NUM],
+                unsigned       &stat_blocks,
+                unsigned       &stat_read_words,
+                unsigned       &stat_read_stalls,
+                unsigned       &stat_seed_words,
+                unsigned       &stat_scan,
+                unsigned       &stat_padding,
+                unsigned       &stat_inactive,
+                unsigned       &stat_masked
+              )
+  {
+    #pragma HLS inline off
+    #pragma HLS dataflow
+    unsigned feature_num_pl = (feature_num/LANES) + (((feature_num%LANES)>0)?1:0);
+    // compact entries hold 2 rows of the lanes of a port in each port word
+    unsigned entry_word_batch = compact ? ((entry_num_batch>>1) + (entry_num_batch&0x1)) : entry_num_batch;
+    hls::stream<BlockCtl<LANES> > ctl_read;
+    #pragma HLS stream variable=ctl_read depth=4
+    hls::stream<BlockCtl<LANES> > ctl_lookup;
+    #pragma HLS stream variable=ctl_lookup depth=4
+    hls::stream<ap_uint<LANES> > fmask_s;
+    #pragma HLS stream variable=fmask_s depth=4
+    hls::stream<SeedP> seeds_s;
+    #pragma HLS stream variable=seeds_s depth=4
+    // deep enough to keep a burst in flight while the compute stage drains a block
+    hls::stream<ap_uint<EntryP::width*LANES> > entries_s;
+    #pragma HLS stream variable=entries_s depth=128
+    hls::stream<LaneData<fixed> > lanes_s[LANES];
+    #pragma HLS stream variable=lanes_s depth=8
+    #pragma HLS array_partition variable=lanes_s complete
+    read_Stage<LANES, PORTS>(feature_num_pl, node_num, entry_word_batch, node_masks, range_seeds, entries,
+                             entries_hi, fvalid, fdense, fmono, nfmask, node_seeds, ctl_read, fmask_s, seeds_s,
+                             entries_s, stat_blocks, stat_read_words, stat_read_stalls, stat_seed_words);
+    lookup_Stage<LANES, PORTS, MAX_ENTRY_NUM, MAX_NODE_NUM, fixed>(entry_num, feature_num, feature_num_pl,
+                             node_num, entry_num_batch, compact, node_masks, local_EntryInfo_uram, local_NodeInfo_uram,
+                             ctl_read, fmask_s, entries_s, ctl_lookup, lanes_s,
+                             stat_scan, stat_padding, stat_inactive, stat_masked);
+    compute_Stage<LANES, MAX_NODE_NUM, fixed>(feature_num_pl, node_num, entry_num_batch,
+                             param_min_child_weight, param_max_delta_step, param_reg_alpha, param_reg_lambda,
+                             compact, constrained, range_seeds, tmp_ndata_uram, tmp_best_split_uram, ctl_lookup,
+                             seeds_s, lanes_s);
+  }
+//*************************************************
+// node partitioned scan: the entries of every work node are laid out apart, the
+// segment of each block of a node after the other, so that the scan of a node needs
+// no per node tables and keeps its sums and best splits in registers
+  // the masks of a segment and its rows; no rows for a segment without a valid feature
+  template <unsigned LANES>
+  struct SegmentCtl
+  {
+    ap_uint<LANES> valid;
+    bool single_pass;
+    ap_uint<2*LANES> mono;
+    unsigned rows;
+  };
+  // reads the info of every node, then the masks and the entry words of its segments;
+  // node_segs holds the first row of every segment and the end of the last one
+  template <unsigned LANES, unsigned PORTS, typename fixed>
+  static void read_Segments(  unsigned       feature_num_pl,
+                unsigned       node_num,
+                bool         compact,
+                bool         node_masks,
+                ap_uint<EntryP::width*LANES/PORTS> *entries,
+                ap_uint<EntryP::width*LANES/PORTS> *entries_hi,
+                ap_uint<LANES>     *fvalid,
+                ap_uint<LANES>     *fdense,
+                ap_uint<2*LANES>   *fmono,
+                ap_uint<LANES>     *nfmask,
+                unsigned     *node_segs,
+                GSP8         *node_stats,
+                float8       *node_root_gain,
+                float16      *node_bounds,
+                hls::stream<SegmentCtl<LANES> > &ctl_out,
+                hls::stream<typename NodeInfo<fixed>::NIP> &ninfo_out,
+                hls::stream<ap_uint<EntryP::width*LANES> > &entries_out,
+                unsigned       &stat_blocks,
+                unsigned       &stat_read_words,
+                unsigned       &stat_read_stalls,
+                unsigned       &stat_mask_words,
+                unsigned       &stat_segment_words
+              )
+  {
+    #pragma HLS inline off
+    unsigned blocks = 0;
+    unsigned read_words = 0;
+    unsigned read_stalls = 0;
+    unsigned mask_words = 0;
+    unsigned segment_words = 1;
+    unsigned seg_begin = node_segs[0];
+    R_Node_Loop: for(unsigned n = 0; n < node_num; n++)
+    {
+      #pragma HLS loop_tripcount min=20 max=32767
+      ninfo_out.write(unpack_Node_Info<fixed>(node_stats[n>>3], node_root_gain[n>>3], node_bounds[n>>3],
+                                              n&0x7).to_NIP());
+      segment_words += 3;
+      R_Segment_Loop: for(unsigned fp = 0; fp < feature_num_pl; fp++)
+      {
+        #pragma HLS loop_tripcount min=384 max=384
+        unsigned seg_end = node_segs[n*feature_num_pl + fp + 1];
+        segment_words++;
+        SegmentCtl<LANES> ctl;
+        ctl.valid = fvalid[fp];
+        if(node_masks)
+        {
+          ctl.valid &= nfmask[fp*node_num + n];
+          mask_words++;
+        }
+        ap_uint<LANES> dense = fdense[fp];
+        ctl.single_pass = ((ctl.valid & ~dense) == 0);
+        ctl.mono = fmono[fp];
+        ctl.rows = (ctl.valid > 0) ? (seg_end - seg_begin) : 0;
+        ctl_out.write(ctl);
+        if(ctl.rows > 0)
+        {
+          blocks++;
+          // compact segments start at an even row, 2 rows per word
+          unsigned word_begin = compact ? (seg_begin>>1) : seg_begin;
+          unsigned word_num = compact ? ((ctl.rows>>1) + (ctl.rows&0x1)) : ctl.rows;
+          unsigned pass_num = ctl.single_pass ? 1 : 2;
+          read_words += pass_num*word_num;
+          R_Segment_Pass_Loop: for(unsigned pass = 0; pass < pass_num; pass++)
+          {
+            #pragma HLS loop_tripcount min=1 max=2
+            P_Read_Segment_Loop: for(unsigned w = 0; w < word_num; w++)
+            {
+              #pragma HLS loop_tripcount min=100 max=2500
+              #pragma HLS pipeline II=1
+              if(entries_out.full()) read_stalls++;
+              entries_out.write(read_Entries<LANES, PORTS>(entries, entries_hi, word_begin + w));
+            }
+          }
+        }
+        seg_begin = seg_end;
+      }
+    }
+    stat_blocks = blocks;
+    stat_read_words = read_words;
+    stat_read_stalls = read_stalls;
+    stat_mask_words = mask_words;
+    stat_segment_words = segment_words;
+  }
+  // decodes the entries of every segment and looks up the gradients of their rows;
+  // the node of the rows is the one of the segment
+  template <unsigned LANES, unsigned PORTS, unsigned MAX_ENTRY_NUM, typename fixed>
+  static void lookup_Segments(  unsigned       entry_num,
+                unsigned       feature_num,
+                unsigned       feature_num_pl,
+                unsigned       node_num,
+                bool         compact,
+                typename EntryInfo<fixed>::EIP local_EntryInfo_uram[LANES/2][MAX_ENTRY_NUM],
+                hls::stream<SegmentCtl<LANES> > &ctl_in,
+                hls::stream<ap_uint<EntryP::width*LANES> > &entries_in,
+                hls::stream<SegmentCtl<LANES> > &ctl_out,
+                hls::stream<LaneData<fixed> >   lanes_out[LANES],
+                unsigned       &stat_scan,
+                unsigned       &stat_padding,
+                unsigned       &stat_masked
+              )
+  {
+    #pragma HLS inline off
+    unsigned scan = 0;
+    unsigned padding = 0;
+    unsigned masked = 0;
+    L_Node_Loop: for(unsigned n = 0; n < node_num; n++)
+    {
+      #pragma HLS loop_tripcount min=20 max=32767
+      L_Segment_Loop: for(unsigned fp = 0; fp < feature_num_pl; fp++)
+      {
+        #pragma HLS loop_tripcount min=384 max=384
+        SegmentCtl<LANES> ctl = ctl_in.read();
+        ctl_out.write(ctl);
+        unsigned entry_num_scan = ctl.single_pass ? ctl.rows : (ctl.rows<<1);
+        scan += entry_num_scan;
+        ap_uint<EntryP::width*LANES> entries_p_in;
+        P_Lookup_Segment_Loop: for(unsigned s = 0; s < entry_num_scan; s++)
+        {
+          #pragma HLS loop_tripcount min=100 max=5000
+          #pragma HLS pipeline II=1
+          unsigned e = (s < ctl.rows) ? s : (s - ctl.rows);
+          if(!compact || ((e&0x1) == 0)) entries_p_in = entries_in.read();
+          ap_uint<LANES> lane_padding = 0;
+          ap_uint<LANES> lane_masked = 0;
+          U_Lookup_Segment_Loop: for (unsigned u = 0; u < LANES; u++)
+          {
+            #pragma HLS unroll
+            Entry new_entry;
+            unsigned slot = compact_Slot<LANES, PORTS>(e, u);
+            if(compact) new_entry.from_EntryC(entries_p_in.range((slot+1)*EntryC::width-1, slot*EntryC::width));
+            else new_entry.from_EntryP(entries_p_in.range((u+1)*EntryP::width-1, u*EntryP::width));
+            bool feature_valid = ((fp*LANES+u) < feature_num) && (ctl.valid.bit(u) == 1);
+            bool new_entry_valid = feature_valid && (new_entry.index < entry_num);
+            EntryInfo<fixed> new_entry_info;
+            new_entry_info.gpair_grad = 0;
+            new_entry_info.gpair_hess = 0;
+            if(new_entry_valid) new_entry_info.from_EIP(local_EntryInfo_uram[u>>1][new_entry.index]);
+            lane_masked[u] = !feature_valid;
+            lane_padding[u] = feature_valid & !new_entry_valid;
+            LaneData<fixed> lane;
+            lane.nid = n;
+            lane.nid_valid = new_entry_valid;
+            lane.fvalue = entry_Value<fixed>(new_entry, compact);
+            lane.gpair_grad = new_entry_info.gpair_grad;
+            lane.gpair_hess = new_entry_info.gpair_hess;
+            lanes_out[u].write(lane);
+          }
+          U_Count_Segment_Loop: for (unsigned u = 0; u < LANES; u++)
+          {
+            #pragma HLS unroll
+            padding += lane_padding[u];
+            masked += lane_masked[u];
+          }
+        }
+      }
+    }
+    stat_scan = scan;
+    stat_padding = padding;
+    stat_masked = masked;
+  }
+  // scans the segments of every node with its sums and best splits in registers, and
+  // writes its best split once its last segment is done
+  template <unsigned LANES, typename fixed>
+  static void compute_Segments(  unsigned       feature_num_pl,
+                unsigned       node_num,
+                float        param_min_child_weight,
+                float        param_max_delta_step,
+                float        param_reg_alpha,
+                float        param_reg_lambda,
+                bool         compact,
+                bool         constrained,
+                SplitP2      *best_splits,
+                hls::stream<SegmentCtl<LANES> > &ctl_in,
+                hls::stream<typename NodeInfo<fixed>::NIP> &ninfo_in,
+                hls::stream<LaneData<fixed> >   lanes_in[LANES]
+              )
+  {
+    #pragma HLS inline off
+    fixed zero = 0.0f;
+    fixed p_min_child_weight = param_min_child_weight;
+    Split<fixed> no_split;
+    no_split.fvalue = 0;
+    no_split.sindex = 0;
+    no_split.loss_chg = 0;
+    no_split.left_child_grad = 0;
+    no_split.left_child_hess = 0;
+    SplitP2 splits_out = 0;
+    C_Node_Loop: for(unsigned n = 0; n < node_num; n++)
+    {
+      #pragma HLS loop_tripcount min=20 max=32767
+      NodeInfo<fixed> ninfo;
+      ninfo.from_NIP(ninfo_in.read());
+      Split<fixed> best_split[LANES];
+      #pragma HLS array_partition variable=best_split complete
+      U_Init_Best: for(unsigned u=0; u<LANES; u++)
+      {
+        #pragma HLS unroll
+        best_split[u] = no_split;
+      }
+      C_Segment_Loop: for(unsigned fp = 0; fp < feature_num_pl; fp++)
+      {
+        #pragma HLS loop_tripcount min=384 max=384
+        SegmentCtl<LANES> ctl = ctl_in.read();
+        bool single_pass = ctl.single_pass;
+        unsigned fw_default_left = single_pass ? 0x80000000 : 0;
+        fixed accum_grad[LANES];
+        #pragma HLS array_partition variable=accum_grad complete
+        fixed accum_hess[LANES];
+        #pragma HLS array_partition variable=accum_hess complete
+        fixed prev_fvalue[LANES];
+        #pragma HLS array_partition variable=prev_fvalue complete
+        bool visited[LANES];
+        #pragma HLS array_partition variable=visited complete
+        U_Init_Segment: for(unsigned u=0; u<LANES; u++)
+        {
+          #pragma HLS unroll
+          accum_grad[u] = 0;
+          accum_hess[u] = 0;
+          prev_fvalue[u] = 0;
+          visited[u] = false;
+        }
+        P_Segment_Loop_FW: for(unsigned e = 0; e < ctl.rows; e++)
+        {
+          #pragma HLS loop_tripcount min=100 max=2500
+          #pragma HLS pipeline II=1
+          U_Segment_Loop_FW: for (unsigned u = 0; u < LANES; u++)
+          {
+            #pragma HLS unroll
+            LaneData<fixed> lane = lanes_in[u].read();
+            Split<fixed> new_split;
+            new_split.fvalue = split_Value(prev_fvalue[u], lane.fvalue, compact);
+            bool new_fvalue_valid = (prev_fvalue[u] != lane.fvalue);
+            GradStatsFixed<fixed> new_stats;
+            new_stats.sum_grad = accum_grad[u];
+            new_stats.sum_hess = accum_hess[u];
+            bool new_stats_valid = (new_stats.sum_hess != zero) &
+                         (new_stats.sum_hess >= p_min_child_weight);
+            GradStatsFixed<fixed> tmp_c;
+            tmp_c.sum_grad = ninfo.nstats_grad - new_stats.sum_grad;
+            tmp_c.sum_hess = ninfo.nstats_hess - new_stats.sum_hess;
+            bool tmp_c_valid = (tmp_c.sum_hess >= p_min_child_weight);
+            new_split.left_child_grad = new_stats.sum_grad;
+            new_split.left_child_hess = new_stats.sum_hess;
+            new_split.sindex = (fp*LANES+u) | fw_default_left;
+            bool mono_valid;
+            new_split.loss_chg = calc_Split_Gain<LANES, fixed>(  new_stats, tmp_c,
+                                                   param_min_child_weight,
+                                                   param_max_delta_step,
+                                                   param_reg_alpha,
+                                                   param_reg_lambda,
+                                                   ninfo.wlower, ninfo.wupper,
+                                                   ctl.mono.range(2*u+1, 2*u),
+                                                   constrained, mono_valid) - ninfo.nrg;
+            bool new_split_valid = lane.nid_valid & new_fvalue_valid &
+                                   new_stats_valid & tmp_c_valid & mono_valid;
+            if(new_split_valid & best_split[u].worse(new_split)) best_split[u] = new_split;
+            if(lane.nid_valid)
+            {
+              accum_grad[u] = accum_grad[u] + lane.gpair_grad;
+              accum_hess[u] = accum_hess[u] + lane.gpair_hess;
+              prev_fvalue[u] = lane.fvalue;
+            }
+          }
+        }
+        if(!single_pass)
+        {
+          // the backward scan starts from the totals of the forward one
+          P_Segment_Loop_BW: for(unsigned e = 0; e < ctl.rows; e++)
+          {
+            #pragma HLS loop_tripcount min=100 max=2500
+            #pragma HLS pipeline II=1
+            U_Segment_Loop_BW: for (unsigned u = 0; u < LANES; u++)
+            {
+              #pragma HLS unroll
+              LaneData<fixed> lane = lanes_in[u].read();
+              // the first entry evaluates the split with every present value right
+              // and the missing ones left
+              bool first_visit = !visited[u];
+              Split<fixed> new_split;
+              if(first_visit) new_split.fvalue = first_Split_Value(lane.fvalue, compact);
+              else new_split.fvalue = split_Value(prev_fvalue[u], lane.fvalue, compact);
+              bool new_fvalue_valid = first_visit | (prev_fvalue[u] != lane.fvalue);
+              GradStatsFixed<fixed> new_stats;
+              new_stats.sum_grad = accum_grad[u];
+              new_stats.sum_hess = accum_hess[u];
+              bool new_stats_valid = (new_stats.sum_hess != zero) &
+                           (new_stats.sum_hess >= p_min_child_weight);
+              GradStatsFixed<fixed> tmp_c;
+              tmp_c.sum_grad = ninfo.nstats_grad - new_stats.sum_grad;
+              tmp_c.sum_hess = ninfo.nstats_hess - new_stats.sum_hess;
+              bool tmp_c_valid = (tmp_c.sum_hess >= p_min_child_weight);
+              new_split.left_child_grad = tmp_c.sum_grad;
+              new_split.left_child_hess = tmp_c.sum_hess;
+              new_split.sindex = (fp*LANES+u) | 0x80000000;
+              bool mono_valid;
+              new_split.loss_chg = calc_Split_Gain<LANES, fixed>(  tmp_c, new_stats,
+                                                     param_min_child_weight,
+                                                     param_max_delta_step,
+                                                     param_reg_alpha,
+                                                     param_reg_lambda,
+                                                     ninfo.wlower, ninfo.wupper,
+                                                     ctl.mono.range(2*u+1, 2*u),
+                                                     constrained, mono_valid) - ninfo.nrg;
+              bool new_split_valid = lane.nid_valid & new_fvalue_valid &
+                           new_stats_valid & tmp_c_valid & mono_valid;
+              if(new_split_valid & best_split[u].worse(new_split)) best_split[u] = new_split;
+              if(lane.nid_valid)
+              {
+                accum_grad[u] = accum_grad[u] - lane.gpair_grad;
+                accum_hess[u] = accum_hess[u] - lane.gpair_hess;
+                prev_fvalue[u] = lane.fvalue;
+                visited[u] = true;
+              }
+            }
+          }
+        }
+      }
+      // two nodes per result word, the second one of an odd last node left empty
+      Split<fixed> best = reduce_Splits<LANES, fixed>(best_split);
+      unsigned h = n & 0x1;
+      splits_out.range(256*h+255, 256*h) = best.pack_split(compact);
+      if(h == 0) splits_out.range(511, 256) = no_split.pack_split(compact);
+      if((h == 1) || (n+1 == node_num)) best_splits[n>>1] = splits_out;
+    }
+  }
+  // the scan of the segments of all the work nodes
+  template <unsigned LANES, unsigned PORTS, unsigned MAX_ENTRY_NUM, typename fixed>
+  static void scan_Segments(  unsigned       entry_num,
+                unsigned       feature_num,
+                unsigned       node_num,
+                ap_uint<EntryP::width*LANES/PORTS> *entries,
+                ap_uint<EntryP::width*LANES/PORTS> *entries_hi,
+                ap_uint<LANES>     *fvalid,
+                ap_uint<LANES>     *fdense,
+                ap_uint<2*LANES>   *fmono,
+                ap_uint<LANES>     *nfmask,
+                unsigned     *node_segs,
+                GSP8         *node_stats,
+                float8       *node_root_gain,
+                float16      *node_bounds,
+                SplitP2      *best_splits,
+                float        param_min_child_weight,
+                float        param_max_delta_step,
+                float        param_reg_alpha,
+                float        param_reg_lambda,
+                bool         compact,
+                bool         constrained,
+                bool         node_masks,
+                typename EntryInfo<fixed>::EIP local_EntryInfo_uram[LANES/2][MAX_ENTRY_NUM],
+                unsigned       &stat_blocks,
+                unsigned       &stat_read_words,
+                unsigned       &stat_read_stalls,
+                unsigned       &stat_mask_words,
+                unsigned       &stat_segment_words,
+                unsigned       &stat_scan,
+                unsigned       &stat_padding,
+                unsigned       &stat_masked
+              )
+  {
+    #pragma HLS inline off
+    #pragma HLS dataflow
+    unsigned feature_num_pl = (feature_num/LANES) + (((feature_num%LANES)>0)?1:0);
+    hls::stream<SegmentCtl<LANES> > ctl_read;
+    #pragma HLS stream variable=ctl_read depth=4
+    hls::stream<SegmentCtl<LANES> > ctl_lookup;
+    #pragma HLS stream variable=ctl_lookup depth=4
+    hls::stream<typename NodeInfo<fixed>::NIP> ninfo_s;
+    #pragma HLS stream variable=ninfo_s depth=4
+    hls::stream<ap_uint<EntryP::width*LANES> > entries_s;
+    #pragma HLS stream variable=entries_s depth=128
+    hls::stream<LaneData<fixed> > lanes_s[LANES];
+    #pragma HLS stream variable=lanes_s depth=8
+    #pragma HLS array_partition variable=lanes_s complete
+    read_Segments<LANES, PORTS, fixed>(feature_num_pl, node_num, compact, node_masks, entries, entries_hi,
+                             fvalid, fdense, fmono, nfmask, node_segs, node_stats, node_root_gain, node_bounds,
+                             ctl_read, ninfo_s, entries_s, stat_blocks, stat_read_words, stat_read_stalls,
+                             stat_mask_words, stat_segment_words);
+    lookup_Segments<LANES, PORTS, MAX_ENTRY_NUM, fixed>(entry_num, feature_num, feature_num_pl, node_num,
+                             compact, local_EntryInfo_uram, ctl_read, entries_s, ctl_lookup, lanes_s,
+                             stat_scan, stat_padding, stat_masked);
+    compute_Segments<LANES, fixed>(feature_num_pl, node_num,
+                             param_min_child_weight, param_max_delta_step, param_reg_alpha, param_reg_lambda,
+                             compact, constrained, best_splits, ctl_lookup, ninfo_s, lanes_s);
+  }
+//*************************************************
+// main
+  // the stats of a child of a split, and its score at its weight as the root gain of
+  // its own splits; the children keep the weight bounds of their parent
+  template <typename fixed>
+  static NodeInfo<fixed> child_Info(  GradStatsFixed<fixed> stats,
+                NodeInfo<fixed> parent,
+                fixed         param_max_delta_step,
+                fixed         param_reg_alpha,
+                fixed         param_reg_lambda
+              )
+  {
+    #pragma HLS inline
+    NodeInfo<fixed> child;
+    child.nstats_grad = stats.sum_grad;
+    child.nstats_hess = stats.sum_hess;
+    fixed weight = calc_Weight(stats, param_max_delta_step, param_reg_alpha, param_reg_lambda,
+                               parent.wlower, parent.wupper);
+    child.nrg = calc_Score(stats, weight, param_reg_alpha, param_reg_lambda);
+    child.wlower = parent.wlower;
+    child.wupper = parent.wupper;
+    return child;
+  }
+  template <unsigned LANES, unsigned PORTS, unsigned MAX_ENTRY_NUM, unsigned MAX_NODE_NUM,
+            unsigned MAX_FEATURE_NUM, typename fixed>
+  static void exact_Kernel(  unsigned  entry_num,
+                unsigned  feature_num,
+                unsigned  node_num,
+                unsigned  entry_num_batch,
+                GSP8     *gpairs,
+                NID8    *node_idxs,
+                ap_uint<EntryP::width*LANES/PORTS>  *entries,
+                ap_uint<LANES>  *fvalid,
+                GSP8     *node_stats,
+                float8   *node_root_gain,
+                SplitP2  *best_splits,
+                float     param_min_child_weight,
+                float     param_max_delta_step,
+                float     param_reg_alpha,
+                float     param_reg_lambda,
+                unsigned  compact_entries,
+                ap_uint<LANES>  *fdense,
+                ap_uint<EntryP::width*LANES/PORTS>  *entries_hi,
+                float16  *node_bounds,
+                ap_uint<2*LANES>  *fmono,
+                unsigned  monotone,
+                ap_uint<LANES>  *nfmask,
+                unsigned  node_masks,
+                StatsP   *stats,
+                unsigned  tree_depth,
+                float     param_split_eps,
+                SeedP    *node_seeds,
+                unsigned  range_seeds,
+                unsigned *node_segs,
+                unsigned  node_partition
+              )
+  {
+    #pragma HLS inline
+    typedef typename EntryInfo<fixed>::EIP EIP;
+    typedef typename NodeInfo<fixed>::NIP NIP;
+
+    // every copy of the row and node tables serves two lanes
+    EIP local_EntryInfo_uram[LANES/2][MAX_ENTRY_NUM];
+    #pragma HLS RESOURCE variable=local_EntryInfo_uram core=XPM_MEMORY uram
+    #pragma HLS array_partition variable=local_EntryInfo_uram complete dim=1
+    #pragma HLS array_partition variable=local_EntryInfo_uram cyclic factor=4 dim=2
+    NIP local_NodeInfo_uram[LANES/2][MAX_NODE_NUM];
+    #pragma HLS RESOURCE variable=local_NodeInfo_uram core=XPM_MEMORY uram
+    #pragma HLS array_partition variable=local_NodeInfo_uram complete dim=1
+    #pragma HLS array_partition variable=local_NodeInfo_uram cyclic factor=4 dim=2
+    NodeTmpData<fixed> tmp_ndata_uram[LANES][MAX_NODE_NUM];
+    #pragma HLS array_partition variable=tmp_ndata_uram complete dim=1
+    Split<fixed> tmp_best_split_uram[LANES][MAX_NODE_NUM];
+    #pragma HLS array_partition variable=tmp_best_split_uram complete dim=1
+    // fused tree mode: the default child of the rows of every node, a copy for each
+    // of the 8 rows updated at a time
+    NID node_next[8][MAX_NODE_NUM];
+    #pragma HLS array_partition variable=node_next complete dim=1
+    // the split of every pair of children of the next level
+    unsigned pair_fid[MAX_NODE_NUM/2];
+    fixed pair_fvalue[MAX_NODE_NUM/2];
+    NIP child_info[MAX_NODE_NUM];
+    #pragma HLS array_partition variable=child_info cyclic factor=2
+    // the lanes of every block that a node of the level splits on
+    ap_uint<LANES> split_lanes[MAX_FEATURE_NUM/LANES];
+    unsigned entry_num_p8 = (entry_num>>3) + (((entry_num&0x7)>0)?1:0);
+    unsigned node_num_p8 = (node_num>>3) + (((node_num&0x7)>0)?1:0);
+    unsigned feature_num_pl = (feature_num/LANES) + (((feature_num%LANES)>0)?1:0);
+    bool compact = (compact_entries != 0);
+    // compact entries hold 2 rows of the lanes of a port in each port word
+    unsigned entry_word_batch = compact ? ((entry_num_batch>>1) + (entry_num_batch&0x1)) : entry_num_batch;
+    bool constrained = (monotone != 0);
+    bool per_node_masks = (node_masks != 0);
+    bool fused = (tree_depth > 0);
+    // the entries are a value range of every column, scanned from the state the host
+    // computed at its start; the fused mode needs whole columns
+    bool seeded = (range_seeds != 0) && !fused;
+    // the entries are partitioned by work node, scanned without the node tables, so
+    // that node_num is not bounded by MAX_NODE_NUM; it replaces the level loop
+    bool partitioned = (node_partition != 0) && !fused && !seeded;
+    unsigned level_num = partitioned ? 0 : fused ? tree_depth : 1;
+    fixed p_max_delta_step = param_max_delta_step;
+    fixed p_reg_alpha = param_reg_alpha;
+    fixed p_reg_lambda = param_reg_lambda;
+
+    P_EntryInfo_Init: for(unsigned ep = 0; ep < entry_num_p8; ep++)
+    {
+      #pragma HLS loop_tripcount min=6250 max=6250
+      #pragma HLS pipeline II=1
+      GSP8 gpairs_in = gpairs[ep];
+      NID8 node_idxs_in = node_idxs[ep];
+      U_EntryInfo_Init: for (unsigned u = 0; u < 8; u++)
+      {
+        #pragma HLS unroll
+        GradStatsFixed<fixed> tmpGSF;
+        tmpGSF.from_GSP(gpairs_in.range((u+1)*GSP::width-1, u*GSP::width));
+        EntryInfo<fixed> tmpEI;
+        tmpEI.gpair_grad = tmpGSF.sum_grad;
+        tmpEI.gpair_hess = tmpGSF.sum_hess;
+        tmpEI.nid = node_idxs_in.range((u+1)*NID::width-1, u*NID::width);;
+        U_EntryInfo_Copies: for (unsigned c = 0; c < LANES/2; c++)
+        {
+          #pragma HLS unroll
+          local_EntryInfo_uram[c][(ep<<3)+u] = tmpEI.to_EIP();
+        }
+      }
+    }
+    unsigned node_init_num = partitioned ? 0 : node_num_p8;
+    P_NodeInfo_Init: for(unsigned np = 0; np < node_init_num; np++)
+    {
+      #pragma HLS loop_tripcount min=20 max=20
+      #pragma HLS pipeline II=1
+      GSP8 nstats_in = node_stats[np];
+      float8 nrg_in = node_root_gain[np];
+      float16 bounds_in = node_bounds[np];
+      U_NodeInfo_Init: for (unsigned u = 0; u < 8; u++)
+      {
+        #pragma HLS unroll
+        NodeInfo<fixed> tmpNI = unpack_Node_Info<fixed>(nstats_in, nrg_in, bounds_in, u);
+        U_NodeInfo_Copies: for (unsigned c = 0; c < LANES/2; c++)
+        {
+          #pragma HLS unroll
+          local_NodeInfo_uram[c][(np<<3)+u] = tmpNI.to_NIP();
+        }
+      }
+    }
+    if(fused)
+    {
+      P_clear_Split_Lanes: for(unsigned fp = 0; fp < feature_num_pl; fp++)
+      {
+        #pragma HLS loop_tripcount min=384 max=384
+        #pragma HLS pipeline II=1
+        split_lanes[fp] = 0;
+      }
+    }
+    unsigned stat_clear = 0, stat_write_back = 0, stat_levels = 0, stat_position = 0;
+    unsigned stat_blocks = 0, stat_read_words = 0, stat_read_stalls = 0, stat_scan = 0;
+    unsigned stat_padding = 0, stat_inactive = 0, stat_masked = 0, stat_mask_words = 0;
+    unsigned stat_seed_words = 0, stat_segment_words = 0;
+    if(partitioned)
+    {
+      scan_Segments<LANES, PORTS, MAX_ENTRY_NUM, fixed>(entry_num, feature_num, node_num, entries, entries_hi,
+          fvalid, fdense, fmono, nfmask, node_segs, node_stats, node_root_gain, node_bounds, best_splits,
+          param_min_child_weight, param_max_delta_step, param_reg_alpha, param_reg_lambda, compact, constrained,
+          per_node_masks, local_EntryInfo_uram,
+          stat_blocks, stat_read_words, stat_read_stalls, stat_mask_words, stat_segment_words, stat_scan,
+          stat_padding, stat_masked);
+      stat_levels = 1;
+    }
+    // the splits of a fused tree are written level after level
+    unsigned split_word = 0;
+    unsigned level_node_num = node_num;
+    L_Level_Loop: for(unsigned level = 0; level < level_num; level++)
+    {
+      #pragma HLS loop_tripcount min=1 max=12
+      unsigned node_num_p2 = (level_node_num>>1) + (((level_node_num&0x1)>0)?1:0);
+      P_clear_tmp_Brams: for(unsigned np = 0; np < node_num_p2; np++)
+      {
+        #pragma HLS loop_tripcount min=80 max=80
+        #pragma HLS pipeline II=1
+        U_clear_tmp_Brams: for(unsigned u=0; u<LANES; u++)
+        {
+          #pragma HLS unroll
+          tmp_best_split_uram[u][np<<1].fvalue = 0;
+          tmp_best_split_uram[u][np<<1].sindex = 0;
+          tmp_best_split_uram[u][np<<1].loss_chg = 0;
+          tmp_best_split_uram[u][np<<1].left_child_grad = 0;
+          tmp_best_split_uram[u][np<<1].left_child_hess = 0;
+          tmp_best_split_uram[u][(np<<1)+1].fvalue = 0;
+          tmp_best_split_uram[u][(np<<1)+1].sindex = 0;
+          tmp_best_split_uram[u][(np<<1)+1].loss_chg = 0;
+          tmp_best_split_uram[u][(np<<1)+1].left_child_grad = 0;
+          tmp_best_split_uram[u][(np<<1)+1].left_child_hess = 0;
+          tmp_ndata_uram[u][np<<1].epoch = 0;
+          tmp_ndata_uram[u][(np<<1)+1].epoch = 0;
+        }
+      }
+      unsigned level_blocks, level_read_words, level_read_stalls, level_seed_words, level_scan;
+      unsigned level_padding, level_inactive, level_masked;
+      scan_Blocks<LANES, PORTS, MAX_ENTRY_NUM, MAX_NODE_NUM, fixed>(entry_num, feature_num, level_node_num,
+          entry_num_batch, entries, entries_hi, fvalid, fdense, fmono, nfmask, node_seeds,
+          param_min_child_weight, param_max_delta_step, param_reg_alpha, param_reg_lambda, compact, constrained,
+          per_node_masks, seeded,
+          local_EntryInfo_uram, local_NodeInfo_uram, tmp_ndata_uram, tmp_best_split_uram,
+          level_blocks, level_read_words, level_read_stalls, level_seed_words, level_scan, level_padding,
+          level_inactive, level_masked);
+      // the nodes the host expands, with the same float comparison as its kRtEps, get
+      // the next pair of children
+      unsigned pair_num = 0;
+      P_Write_Back: for(unsigned np = 0; np < node_num_p2; np++)
+      {
+        #pragma HLS loop_tripcount min=80 max=80
+        #pragma HLS pipeline II=1
+        SplitP2 splits_out;
+        U_Write_Back: for(unsigned h = 0; h < 2; h++)
+        {
+          #pragma HLS unroll
+          unsigned n = (np<<1) + h;
+          Split<fixed> best = best_Split<LANES, MAX_NODE_NUM, fixed>(n, tmp_best_split_uram);
+          splits_out.range(256*h+255, 256*h) = best.pack_split(compact);
+          bool expand = fused && (n < level_node_num) &&
+                        (Accum<fixed>::to_float(best.loss_chg) > param_split_eps);
+          NID next = -1;
+          if(expand)
+          {
+            unsigned fid = best.sindex & 0x7fffffff;
+            bool default_left = (best.sindex >> 31) != 0;
+            next = (pair_num<<1) | (default_left ? 0 : 1);
+            pair_fid[pair_num] = fid;
+            pair_fvalue[pair_num] = best.fvalue;
+            ap_uint<LANES> lanes = split_lanes[fid/LANES];
+            lanes.bit(fid%LANES) = 1;
+            split_lanes[fid/LANES] = lanes;
+            NodeInfo<fixed> parent;
+            parent.from_NIP(local_NodeInfo_uram[0][n]);
+            GradStatsFixed<fixed> left, right;
+            left.sum_grad = best.left_child_grad;
+            left.sum_hess = best.left_child_hess;
+            right.sum_grad = parent.nstats_grad - best.left_child_grad;
+            right.sum_hess = parent.nstats_hess - best.left_child_hess;
+            child_info[pair_num<<1] =
+                child_Info(left, parent, p_max_delta_step, p_reg_alpha, p_reg_lambda).to_NIP();
+            child_info[(pair_num<<1)+1] =
+                child_Info(right, parent, p_max_delta_step, p_reg_alpha, p_reg_lambda).to_NIP();
+            pair_num++;
+          }
+          U_Next_Copies: for(unsigned c = 0; c < 8; c++)
+          {
+            #pragma HLS unroll
+            node_next[c][n & (MAX_NODE_NUM-1)] = next;
+          }
+        }
+        best_splits[split_word + np] = splits_out;
+      }
+      split_word += node_num_p2;
+      stat_clear += node_num_p2;
+      stat_write_back += node_num_p2;
+      stat_levels++;
+      stat_blocks += level_blocks;
+      stat_read_words += level_read_words;
+      stat_read_stalls += level_read_stalls;
+      stat_seed_words += level_seed_words;
+      stat_scan += level_scan;
+      stat_padding += level_padding;
+      stat_inactive += level_inactive;
+      stat_masked += level_masked;
+      stat_mask_words += per_node_masks ? level_blocks*level_node_num : 0;
+      if(level+1 == level_num || pair_num == 0) break;
+      unsigned next_node_num = pair_num<<1;
+      // the rows of the nodes that are not split leave the tree, the others go to the
+      // default child of their node; copy 0 is read and written back, at II=2
+      P_Position_Default: for(unsigned ep = 0; ep < entry_num_p8; ep++)
+      {
+        #pragma HLS loop_tripcount min=6250 max=6250
+        #pragma HLS pipeline II=2
+        U_Position_Default: for (unsigned u = 0; u < 8; u++)
+        {
+          #pragma HLS unroll
+          EntryInfo<fixed> info;
+          info.from_EIP(local_EntryInfo_uram[0][(ep<<3)+u]);
+          NID next = -1;
+          if(info.nid < level_node_num) next = node_next[u][info.nid & (MAX_NODE_NUM-1)];
+          info.nid = next;
+          U_Position_Default_Copies: for (unsigned c = 0; c < LANES/2; c++)
+          {
+            #pragma HLS unroll
+            local_EntryInfo_uram[c][(ep<<3)+u] = info.to_EIP();
+          }
+        }
+      }
+      stat_position += entry_num_p8*2;
+      // the rows with a value of the split feature of their node go to the side of their
+      // value: only the split features are streamed again, one lane at a time
+      P_Position_Blocks: for(unsigned fp = 0; fp < feature_num_pl; fp++)
+      {
+        #pragma HLS loop_tripcount min=384 max=384
+        ap_uint<LANES> lanes = split_lanes[fp];
+        split_lanes[fp] = 0;
+        P_Position_Lanes: for(unsigned u = 0; u < LANES; u++)
+        {
+          if(lanes.bit(u) == 0) continue;
+          unsigned fid = fp*LANES + u;
+          ap_uint<EntryP::width*LANES> entries_p_in;
+          P_Position_Split: for(unsigned e = 0; e < entry_num_batch; e++)
+          {
+            #pragma HLS loop_tripcount min=50000 max=50000
+            #pragma HLS pipeline II=1
+            #pragma HLS dependence variable=local_EntryInfo_uram inter false
+            if(!compact || ((e&0x1) == 0))
+              entries_p_in = read_Entries<LANES, PORTS>(entries, entries_hi,
+                                                        fp*entry_word_batch + (compact ? (e>>1) : e));
+            Entry new_entry;
+            unsigned slot = compact_Slot<LANES, PORTS>(e, u);
+            if(compact) new_entry.from_EntryC(entries_p_in.range((slot+1)*EntryC::width-1, slot*EntryC::width));
+            else new_entry.from_EntryP(entries_p_in.range((u+1)*EntryP::width-1, u*EntryP::width));
+            if(new_entry.index < entry_num)
+            {
+              EntryInfo<fixed> info;
+              info.from_EIP(local_EntryInfo_uram[0][new_entry.index]);
+              unsigned pair = info.nid >> 1;
+              if((info.nid < next_node_num) && (pair_fid[pair & (MAX_NODE_NUM/2-1)] == fid))
+              {
+                bool left = goes_Left(entry_Value<fixed>(new_entry, compact),
+                                      pair_fvalue[pair & (MAX_NODE_NUM/2-1)], compact);
+                info.nid = (pair<<1) | (left ? 0 : 1);
+                U_Position_Split_Copies: for (unsigned c = 0; c < LANES/2; c++)
+                {
+                  #pragma HLS unroll
+                  local_EntryInfo_uram[c][new_entry.index] = info.to_EIP();
+                }
+              }
+            }
+          }
+          stat_position += entry_num_batch;
+        }
+      }
+      P_Child_Copy: for(unsigned n = 0; n < next_node_num; n++)
+      {
+        #pragma HLS loop_tripcount min=20 max=2048
+        #pragma HLS pipeline II=1
+        NIP info = child_info[n];
+        U_Child_Copies: for (unsigned c = 0; c < LANES/2; c++)
+        {
+          #pragma HLS unroll
+          local_NodeInfo_uram[c][n] = info;
+        }
+      }
+      stat_position += next_node_num;
+      level_node_num = next_node_num;
+    }
+    // the loops run at II=1, so their trip counts are their cycles (less the pipeline depth)
+    StatsP stats_out = 0;
+    stats_out.range(32*xgboost_exact::kStatEntryInit+31, 32*xgboost_exact::kStatEntryInit) = entry_num_p8;
+    stats_out.range(32*xgboost_exact::kStatNodeInit+31, 32*xgboost_exact::kStatNodeInit) = node_init_num;
+    stats_out.range(32*xgboost_exact::kStatClear+31, 32*xgboost_exact::kStatClear) = stat_clear;
+    stats_out.range(32*xgboost_exact::kStatBlocks+31, 32*xgboost_exact::kStatBlocks) = stat_blocks;
+    // the partitioned scan has a block of every node
+    unsigned block_slots = partitioned ? feature_num_pl*node_num : feature_num_pl*stat_levels;
+    stats_out.range(32*xgboost_exact::kStatBlocksSkipped+31, 32*xgboost_exact::kStatBlocksSkipped) =
+        block_slots - stat_blocks;
+    stats_out.range(32*xgboost_exact::kStatReadWords+31, 32*xgboost_exact::kStatReadWords) = stat_read_words;
+    stats_out.range(32*xgboost_exact::kStatReadStalls+31, 32*xgboost_exact::kStatReadStalls) = stat_read_stalls;
+    stats_out.range(32*xgboost_exact::kStatMaskWords+31, 32*xgboost_exact::kStatMaskWords) = stat_mask_words;
+    stats_out.range(32*xgboost_exact::kStatScanCycles+31, 32*xgboost_exact::kStatScanCycles) = stat_scan;
+    stats_out.range(32*xgboost_exact::kStatEntriesPadding+31, 32*xgboost_exact::kStatEntriesPadding) = stat_padding;
+    stats_out.range(32*xgboost_exact::kStatEntriesInactive+31, 32*xgboost_exact::kStatEntriesInactive) = stat_inactive;
+    stats_out.range(32*xgboost_exact::kStatEntriesMasked+31, 32*xgboost_exact::kStatEntriesMasked) = stat_masked;
+    stats_out.range(32*xgboost_exact::kStatWriteBack+31, 32*xgboost_exact::kStatWriteBack) = stat_write_back;
+    stats_out.range(32*xgboost_exact::kStatLevels+31, 32*xgboost_exact::kStatLevels) = stat_levels;
+    stats_out.range(32*xgboost_exact::kStatPositionCycles+31, 32*xgboost_exact::kStatPositionCycles) = stat_position;
+    stats_out.range(32*xgboost_exact::kStatSeedWords+31, 32*xgboost_exact::kStatSeedWords) = stat_seed_words;
+    stats_out.range(32*xgboost_exact::kStatSegmentWords+31, 32*xgboost_exact::kStatSegmentWords) =
+        stat_segment_words;
+    stats[0] = stats_out;
+  }
+
+#endif
@@ -0,0 +1,129 @@
+// Compile time configuration of the exact kernel, shared with the host updaters
+// so that the device layout and the split records agree on both sides.
+// Every value can be overridden with -D at kernel and library build time.
+#ifndef XGBOOST_EXACT_CONFIG_H
+#define XGBOOST_EXACT_CONFIG_H
+
+// features evaluated in parallel, one entry column per lane (multiple of 8)
+#ifndef XGBOOST_EXACT_LANES
+#define XGBOOST_EXACT_LANES 8
+#endif
+
+// AXI ports the entries are read from, each one with LANES/ENTRY_PORTS lanes of
+// every block (1 or 2); the second port is meant for a separate memory bank
+#ifndef XGBOOST_EXACT_ENTRY_PORTS
+#define XGBOOST_EXACT_ENTRY_PORTS 1
+#endif
+
+// rows and nodes held in the on-chip tables
+#ifndef XGBOOST_EXACT_MAX_ENTRY_NUM
+#define XGBOOST_EXACT_MAX_ENTRY_NUM 65536
+#endif
+#ifndef XGBOOST_EXACT_MAX_NODE_NUM
+#define XGBOOST_EXACT_MAX_NODE_NUM 2048
+#endif
+// features of a request a whole tree can be grown on, in the fused tree mode
+#ifndef XGBOOST_EXACT_MAX_FEATURE_NUM
+#define XGBOOST_EXACT_MAX_FEATURE_NUM 8192
+#endif
+
+// precision of the gradient accumulators: fixed point, or single precision float
+#define XGBOOST_EXACT_FIXED 0
+#define XGBOOST_EXACT_FLOAT 1
+#ifndef XGBOOST_EXACT_PRECISION
+#define XGBOOST_EXACT_PRECISION XGBOOST_EXACT_FIXED
+#endif
+
+// fixed point type of the gradient accumulators: total and integer bits
+// (32/16 by default, 48/24 for the wide fixed point mode)
+#ifndef XGBOOST_EXACT_ACCUM_WIDTH
+#define XGBOOST_EXACT_ACCUM_WIDTH 32
+#endif
+#ifndef XGBOOST_EXACT_ACCUM_INT
+#define XGBOOST_EXACT_ACCUM_INT 16
+#endif
+
+namespace xgboost_exact {
+
+constexpr unsigned kLanes = XGBOOST_EXACT_LANES;
+constexpr unsigned kEntryPorts = XGBOOST_EXACT_ENTRY_PORTS;
+constexpr unsigned kPortLanes = kLanes / kEntryPorts;
+constexpr unsigned kMaxEntryNum = XGBOOST_EXACT_MAX_ENTRY_NUM;
+constexpr unsigned kMaxNodeNum = XGBOOST_EXACT_MAX_NODE_NUM;
+constexpr unsigned kMaxFeatureNum = XGBOOST_EXACT_MAX_FEATURE_NUM;
+constexpr bool kFloatAccum = XGBOOST_EXACT_PRECISION == XGBOOST_EXACT_FLOAT;
+constexpr int kAccumInt = XGBOOST_EXACT_ACCUM_INT;
+// precision reported by the kernel in every split record: width and integer bits
+// of the fixed point type, or the top bit set for float
+constexpr unsigned kPrecisionTag = kFloatAccum ? (0x80000000u | (32 << 8))
+    : ((XGBOOST_EXACT_ACCUM_WIDTH << 8) | XGBOOST_EXACT_ACCUM_INT);
+// monotone direction of a feature, 2 bits per lane; the last code marks a lane of
+// bundled single valued features, valued by their position in the bundle
+constexpr unsigned kMonoInc = 1;
+constexpr unsigned kMonoDec = 2;
+constexpr unsigned kMonoBundle = 3;
+// features of a bundle, whose positions the fixed point values of the kernel hold
+constexpr unsigned kMaxBundleFeatures = 1u << (kAccumInt - 2);
+// size of a split record, two of them per 512-bit result word
+constexpr unsigned kSplitBytes = 32;
+// size of the value range seed of a node and lane: the forward and backward sums,
+// the last value before the range and a flag for a node with entries before it
+constexpr unsigned kSeedBytes = 32;
+// work nodes of a call in the node partitioned mode, bounded by the 16-bit row
+// positions of the updaters instead of the on-chip node tables
+constexpr unsigned kMaxPartitionNodeNum = 32767;
+// 32-bit counters of the stats word written by the kernel after every call; the
+// loops run at II=1, so the loop counters are cycle counts
+enum Stat : unsigned {
+  kStatEntryInit = 0,      // entry info loads
+  kStatNodeInit,           // node info loads
+  kStatClear,              // temporary state clears
+  kStatBlocks,             // lane blocks scanned
+  kStatBlocksSkipped,      // lane blocks without a valid feature
+  kStatReadWords,          // entry words read
+  kStatReadStalls,         // entry reads held back by a full stream
+  kStatMaskWords,          // node feature mask words read
+  kStatScanCycles,         // forward and backward scan iterations
+  kStatEntriesPadding,     // lane slots past the last entry of a feature
+  kStatEntriesInactive,    // entries of rows in no work node
+  kStatEntriesMasked,      // lane slots of invalid or masked features
+  kStatWriteBack,          // best split writes
+  kStatLevels,             // tree levels evaluated
+  kStatPositionCycles,     // row position updates between the levels of a fused tree
+  kStatSeedWords,          // value range seed words read, once per scan
+  kStatSegmentWords,       // segment offset and node info words read, node partitioned mode
+  kStatCount = 32
+};
+
+// number of lane blocks covering n features
+constexpr unsigned BlockCount(unsigned n) {
+  return n / kLanes + ((n % kLanes) > 0 ? 1 : 0);
+}
+
+// number of approx records of a feature of nbins quantile bins, merge adjacent bins each
+constexpr unsigned ApproxMergedBins(unsigned nbins, unsigned merge) {
+  return nbins / merge + ((nbins % merge) > 0 ? 1 : 0);
+}
+
+// the smallest power of two merge of adjacent approx bins whose records(merge) fit the
+// rows of the kernel, or 0 when none fits before the feature with the fewest bins above
+// one (min_bins, 1 without one) is left a single bin, which has no threshold: the host
+// then scans the exact entries
+template <typename F>
+inline unsigned ApproxMerge(unsigned min_bins, F records) {
+  for (unsigned merge = 1;; merge *= 2) {
+    if (merge > 1 && ApproxMergedBins(min_bins, merge) < 2) return 0;
+    if (records(merge) <= kMaxEntryNum) return merge;
+  }
+}
+
+static_assert(kLanes % 8 == 0, "lanes must be a multiple of 8");
+static_assert(kEntryPorts == 1 || kEntryPorts == 2, "1 or 2 entry ports are supported");
+static_assert(kPortLanes % 8 == 0, "the lanes of a port must be a multiple of 8");
+static_assert(kMaxNodeNum % 8 == 0, "node capacity must be a multiple of 8");
+static_assert(kMaxFeatureNum % kLanes == 0, "feature capacity must be a multiple of the lanes");
+static_assert(XGBOOST_EXACT_ACCUM_WIDTH <= 64, "fixed point accumulators up to 64 bits");
+
+}  // namespace xgboost_exact
+
+#endif  // XGBOOST_EXACT_CONFIG_H
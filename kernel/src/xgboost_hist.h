@@ -0,0 +1,398 @@
+// Histogram split finding kernel, for the large row counts the exact kernel cannot
+// hold: the rows stream through once per block of features, their quantized values
+// index the histograms of their nodes on the chip, and a scan of every histogram
+// finds the best split of each node. The histogram of a node can instead be derived
+// from the one of its parent, kept in device memory by the previous call, less the one
+// of its sibling. Shares the accumulator, gain and split code of the exact kernel.
+// Each kernel instance is a thin extern "C" wrapper around hist_Kernel, see xgboost_hist_0.cpp.
+#ifndef XGBOOST_HIST_H
+#define XGBOOST_HIST_H
+
+#include "xgboost_exact.h"
+#include "xgboost_hist_config.h"
+
+//*************************************************
+// type definitions
+  typedef ap_uint<512>                      BinW;
+  typedef ap_uint<256>                      HSRC8;
+
+  static_assert(static_cast<unsigned>(xgboost_hist::kStatCount) ==
+                static_cast<unsigned>(xgboost_exact::kStatCount),
+                "the stats word of the histogram kernel has the size of the exact one");
+  static_assert(xgboost_hist::kMonoInc == xgboost_exact::kMonoInc && xgboost_hist::kMonoDec == xgboost_exact::kMonoDec,
+                "the monotone directions of the histogram kernel are the ones of the exact kernel");
+//*************************************************
+// the raw accumulators of a lane of a histogram word
+  template <unsigned LANES, typename fixed>
+  static GradStatsFixed<fixed> hist_Lane(  const ap_uint<128*LANES>& word,
+                  unsigned    u
+                )
+  {
+    #pragma HLS inline
+    GradStatsFixed<fixed> stats;
+    stats.sum_grad = Accum<fixed>::from_bits(word.range(128*u+Accum<fixed>::width-1, 128*u));
+    stats.sum_hess = Accum<fixed>::from_bits(word.range(128*u+64+Accum<fixed>::width-1, 128*u+64));
+    return stats;
+  }
+  template <unsigned LANES, typename fixed>
+  static void set_Hist_Lane(  ap_uint<128*LANES>& word,
+                 unsigned    u,
+                 GradStatsFixed<fixed> stats
+               )
+  {
+    #pragma HLS inline
+    word.range(128*u+63, 128*u) = 0;
+    word.range(128*u+127, 128*u+64) = 0;
+    word.range(128*u+Accum<fixed>::width-1, 128*u) = Accum<fixed>::bits(stats.sum_grad);
+    word.range(128*u+64+Accum<fixed>::width-1, 128*u+64) = Accum<fixed>::bits(stats.sum_hess);
+  }
+//*************************************************
+// main
+  template <unsigned LANES, unsigned BIN_BITS, unsigned MAX_BIN, unsigned MAX_NODE_NUM, typename fixed>
+  static void hist_Kernel(  unsigned  row_num,
+                unsigned  feature_num,
+                unsigned  node_num,
+                unsigned  bin_num,
+                GSP8     *gpairs,
+                NID8     *node_idxs,
+                BinW     *bins,
+                ap_uint<LANES>  *fvalid,
+                GSP8     *node_stats,
+                float8   *node_root_gain,
+                SplitP2  *best_splits,
+                float     param_min_child_weight,
+                float     param_max_delta_step,
+                float     param_reg_alpha,
+                float     param_reg_lambda,
+                float16  *node_bounds,
+                ap_uint<2*LANES>  *fmono,
+                unsigned  monotone,
+                ap_uint<LANES>  *nfmask,
+                unsigned  node_masks,
+                HSRC8    *node_hist_src,
+                unsigned  parent_num,
+                ap_uint<128*LANES>  *hist_in,
+                ap_uint<128*LANES>  *hist_out,
+                unsigned  keep_hist,
+                StatsP   *stats
+              )
+  {
+    #pragma HLS inline
+    typedef typename GradStatsFixed<fixed>::GSFP GSFP;
+    typedef typename NodeInfo<fixed>::NIP NIP;
+    typedef ap_uint<128*LANES> HistW;
+    const unsigned ROWS_PER_WORD = BinW::width/(LANES*BIN_BITS);
+    const unsigned ROW_ALIGN = ROWS_PER_WORD > 8 ? ROWS_PER_WORD : 8;
+
+    // the histograms of the nodes, MAX_BIN slots each
+    GSFP hist_uram[LANES][MAX_NODE_NUM*MAX_BIN];
+    #pragma HLS RESOURCE variable=hist_uram core=XPM_MEMORY uram
+    #pragma HLS array_partition variable=hist_uram complete dim=1
+    NIP local_NodeInfo[MAX_NODE_NUM];
+    unsigned local_hist_src[MAX_NODE_NUM];
+    Split<fixed> tmp_best_split_uram[LANES][MAX_NODE_NUM];
+    #pragma HLS array_partition variable=tmp_best_split_uram complete dim=1
+    // the rows of a block are padded to whole words of quantized values and of gradients
+    unsigned row_num_pa = ((row_num + ROW_ALIGN - 1)/ROW_ALIGN)*ROW_ALIGN;
+    unsigned row_words = row_num_pa/ROWS_PER_WORD;
+    unsigned node_num_p8 = (node_num>>3) + (((node_num&0x7)>0)?1:0);
+    unsigned node_num_p2 = (node_num>>1) + (((node_num&0x1)>0)?1:0);
+    unsigned feature_num_pl = (feature_num/LANES) + (((feature_num%LANES)>0)?1:0);
+    bool constrained = (monotone != 0);
+    bool per_node_masks = (node_masks != 0);
+    bool keep = (keep_hist != 0);
+    fixed zero = 0.0f;
+    fixed p_min_child_weight = param_min_child_weight;
+
+    P_NodeInfo_Init: for(unsigned np = 0; np < node_num_p8; np++)
+    {
+      #pragma HLS loop_tripcount min=4 max=32
+      #pragma HLS pipeline II=1
+      GSP8 nstats_in = node_stats[np];
+      float8 nrg_in = node_root_gain[np];
+      // the lower bounds of the 8 nodes, then their upper bounds
+      float16 bounds_in = node_bounds[np];
+      HSRC8 src_in = node_hist_src[np];
+      U_NodeInfo_Init: for (unsigned u = 0; u < 8; u++)
+      {
+        #pragma HLS unroll
+        GradStatsFixed<fixed> tmpGSF;
+        tmpGSF.from_GSP(nstats_in.range((u+1)*GSP::width-1, u*GSP::width));
+        NodeInfo<fixed> tmpNI;
+        tmpNI.nstats_grad = tmpGSF.sum_grad;
+        tmpNI.nstats_hess = tmpGSF.sum_hess;
+        tmpNI.nrg = unpack_float(nrg_in.range((u+1)*32 -1, u*32));
+        tmpNI.wlower = unpack_float(bounds_in.range((u+1)*32 -1, u*32));
+        tmpNI.wupper = unpack_float(bounds_in.range((u+9)*32 -1, (u+8)*32));
+        local_NodeInfo[(np<<3)+u] = tmpNI.to_NIP();
+        local_hist_src[(np<<3)+u] = src_in.range((u+1)*32 -1, u*32).to_uint();
+      }
+    }
+    P_clear_tmp_Brams: for(unsigned n = 0; n < (node_num_p2<<1); n++)
+    {
+      #pragma HLS loop_tripcount min=32 max=256
+      #pragma HLS pipeline II=1
+      U_clear_tmp_Brams: for(unsigned u=0; u<LANES; u++)
+      {
+        #pragma HLS unroll
+        tmp_best_split_uram[u][n].fvalue = 0;
+        tmp_best_split_uram[u][n].sindex = 0;
+        tmp_best_split_uram[u][n].loss_chg = 0;
+        tmp_best_split_uram[u][n].left_child_grad = 0;
+        tmp_best_split_uram[u][n].left_child_hess = 0;
+      }
+    }
+    unsigned stat_clear = 0, stat_blocks = 0, stat_rows = 0, stat_inactive = 0, stat_missing = 0;
+    unsigned stat_subtracted = 0, stat_hist_reads = 0, stat_hist_writes = 0, stat_scan = 0;
+    L_Blocks: for(unsigned fp = 0; fp < feature_num_pl; fp++)
+    {
+      #pragma HLS loop_tripcount min=25 max=25
+      ap_uint<LANES> fvalid_in = fvalid[fp];
+      ap_uint<2*LANES> mono_in = fmono[fp];
+      // the histograms kept for the next call need every block
+      if(fvalid_in == 0 && !keep) continue;
+      stat_blocks++;
+      L_Clear_Nodes: for(unsigned n = 0; n < node_num; n++)
+      {
+        #pragma HLS loop_tripcount min=32 max=256
+        if(local_hist_src[n] != xgboost_hist::kHistFromRows) continue;
+        P_Clear_Bins: for(unsigned b = 0; b < bin_num; b++)
+        {
+          #pragma HLS loop_tripcount min=256 max=256
+          #pragma HLS pipeline II=1
+          U_Clear_Bins: for(unsigned u=0; u<LANES; u++)
+          {
+            #pragma HLS unroll
+            hist_uram[u][(n & (MAX_NODE_NUM-1))*MAX_BIN + b] = 0;
+          }
+        }
+        stat_clear += bin_num;
+      }
+      // every row adds its gradient pair to the bin of its value in the histogram of its
+      // node; the last bin updated by a lane is kept in a register, so that the runs of
+      // rows of the same bin do not wait for the memory
+      GradStatsFixed<fixed> curr_bin[LANES];
+      #pragma HLS array_partition variable=curr_bin complete
+      unsigned curr_addr[LANES];
+      #pragma HLS array_partition variable=curr_addr complete
+      bool curr_valid[LANES];
+      #pragma HLS array_partition variable=curr_valid complete
+      U_Rows_Init: for(unsigned u=0; u<LANES; u++)
+      {
+        #pragma HLS unroll
+        curr_valid[u] = false;
+        curr_addr[u] = 0;
+      }
+      GSP8 gpairs_in = 0;
+      NID8 node_idxs_in = 0;
+      BinW bins_in = 0;
+      P_Rows: for(unsigned r = 0; r < row_num_pa; r++)
+      {
+        #pragma HLS loop_tripcount min=1000000 max=1000000
+        #pragma HLS pipeline II=1
+        #pragma HLS dependence variable=hist_uram intra false
+        if((r&0x7) == 0)
+        {
+          gpairs_in = gpairs[r>>3];
+          node_idxs_in = node_idxs[r>>3];
+        }
+        if((r%ROWS_PER_WORD) == 0) bins_in = bins[fp*row_words + r/ROWS_PER_WORD];
+        GradStatsFixed<fixed> gpair;
+        gpair.from_GSP(gpairs_in.range(((r&0x7)+1)*GSP::width-1, (r&0x7)*GSP::width));
+        NID nid = node_idxs_in.range(((r&0x7)+1)*NID::width-1, (r&0x7)*NID::width);
+        bool active = (r < row_num) && (nid < node_num);
+        if(!active) stat_inactive++;
+        unsigned slot = (r%ROWS_PER_WORD)*LANES;
+        U_Rows: for (unsigned u = 0; u < LANES; u++)
+        {
+          #pragma HLS unroll
+          unsigned bin = bins_in.range((slot+u+1)*BIN_BITS-1, (slot+u)*BIN_BITS).to_uint();
+          bool present = (bin < bin_num);
+          if(active && !present) stat_missing++;
+          if(active && present)
+          {
+            unsigned addr = (nid & (MAX_NODE_NUM-1))*MAX_BIN + bin;
+            bool same = curr_valid[u] && (curr_addr[u] == addr);
+            GradStatsFixed<fixed> tmp;
+            if(same) tmp = curr_bin[u];
+            else tmp.from_GSFP(hist_uram[u][addr]);
+            if(curr_valid[u] && !same) hist_uram[u][curr_addr[u]] = curr_bin[u].to_GSFP();
+            curr_bin[u] = tmp + gpair;
+            curr_addr[u] = addr;
+            curr_valid[u] = true;
+          }
+        }
+      }
+      U_write_final_Rows: for(unsigned u=0; u<LANES; u++)
+      {
+        #pragma HLS unroll
+        if(curr_valid[u]) hist_uram[u][curr_addr[u]] = curr_bin[u].to_GSFP();
+      }
+      stat_rows += row_num_pa;
+      L_Nodes: for(unsigned n = 0; n < node_num; n++)
+      {
+        #pragma HLS loop_tripcount min=32 max=256
+        unsigned src = local_hist_src[n];
+        bool subtract = (src != xgboost_hist::kHistFromRows);
+        unsigned parent = src >> 16;
+        unsigned sibling = src & 0xffff;
+        NodeInfo<fixed> info;
+        info.from_NIP(local_NodeInfo[n]);
+        ap_uint<LANES> lanes = fvalid_in;
+        if(per_node_masks) lanes &= nfmask[fp*node_num + n];
+        // the histogram of the node, derived from its parent and sibling, kept for the
+        // next call, and the sums of its present values
+        GradStatsFixed<fixed> present[LANES];
+        #pragma HLS array_partition variable=present complete
+        U_Present_Init: for(unsigned u=0; u<LANES; u++)
+        {
+          #pragma HLS unroll
+          present[u].sum_grad = 0;
+          present[u].sum_hess = 0;
+        }
+        P_Node_Hist: for(unsigned b = 0; b < bin_num; b++)
+        {
+          #pragma HLS loop_tripcount min=256 max=256
+          #pragma HLS pipeline II=1
+          #pragma HLS dependence variable=hist_uram inter false
+          HistW parent_in = 0;
+          if(subtract) parent_in = hist_in[(fp*parent_num + parent)*bin_num + b];
+          HistW hist_word;
+          U_Node_Hist: for(unsigned u=0; u<LANES; u++)
+          {
+            #pragma HLS unroll
+            GradStatsFixed<fixed> h;
+            if(subtract)
+            {
+              GradStatsFixed<fixed> s;
+              s.from_GSFP(hist_uram[u][(sibling & (MAX_NODE_NUM-1))*MAX_BIN + b]);
+              h = hist_Lane<LANES, fixed>(parent_in, u) - s;
+              hist_uram[u][(n & (MAX_NODE_NUM-1))*MAX_BIN + b] = h.to_GSFP();
+            }
+            else h.from_GSFP(hist_uram[u][(n & (MAX_NODE_NUM-1))*MAX_BIN + b]);
+            present[u] = present[u] + h;
+            set_Hist_Lane<LANES, fixed>(hist_word, u, h);
+          }
+          if(keep) hist_out[(fp*node_num + n)*bin_num + b] = hist_word;
+        }
+        if(subtract)
+        {
+          stat_subtracted++;
+          stat_hist_reads += bin_num;
+        }
+        if(keep) stat_hist_writes += bin_num;
+        if(lanes == 0) continue;
+        // the split after bin b sends the bins up to b left and the missing values right;
+        // the one before bin b sends the missing values and the bins below b left, where
+        // the one before the first bin sends every present value right
+        Split<fixed> best[LANES];
+        #pragma HLS array_partition variable=best complete
+        GradStatsFixed<fixed> prefix[LANES];
+        #pragma HLS array_partition variable=prefix complete
+        U_Scan_Init: for(unsigned u=0; u<LANES; u++)
+        {
+          #pragma HLS unroll
+          best[u] = tmp_best_split_uram[u][n & (MAX_NODE_NUM-1)];
+          prefix[u].sum_grad = 0;
+          prefix[u].sum_hess = 0;
+        }
+        P_Scan: for(unsigned b = 0; b < bin_num; b++)
+        {
+          #pragma HLS loop_tripcount min=256 max=256
+          #pragma HLS pipeline II=1
+          U_Scan: for(unsigned u=0; u<LANES; u++)
+          {
+            #pragma HLS unroll
+            GradStatsFixed<fixed> h;
+            h.from_GSFP(hist_uram[u][(n & (MAX_NODE_NUM-1))*MAX_BIN + b]);
+            unsigned fid = fp*LANES + u;
+            bool mono_valid;
+            // before bin b, the missing values left
+            GradStatsFixed<fixed> bw_right;
+            bw_right.sum_grad = present[u].sum_grad - prefix[u].sum_grad;
+            bw_right.sum_hess = present[u].sum_hess - prefix[u].sum_hess;
+            GradStatsFixed<fixed> bw_left;
+            bw_left.sum_grad = info.nstats_grad - bw_right.sum_grad;
+            bw_left.sum_hess = info.nstats_hess - bw_right.sum_hess;
+            Split<fixed> bw_split;
+            bw_split.sindex = fid | 0x80000000;
+            bw_split.fvalue = Accum<fixed>::from_rank((b == 0) ? 0xffff : (b - 1));
+            bw_split.left_child_grad = bw_left.sum_grad;
+            bw_split.left_child_hess = bw_left.sum_hess;
+            bw_split.loss_chg = calc_Split_Gain<2*LANES, fixed>(bw_left, bw_right,
+                                                    param_min_child_weight,
+                                                    param_max_delta_step,
+                                                    param_reg_alpha,
+                                                    param_reg_lambda,
+                                                    info.wlower, info.wupper,
+                                                    mono_in.range(2*u+1, 2*u),
+                                                    constrained, mono_valid) - info.nrg;
+            bool bw_valid = lanes.bit(u) & (bw_right.sum_hess != zero) &
+                            (bw_right.sum_hess >= p_min_child_weight) &
+                            (bw_left.sum_hess >= p_min_child_weight) & mono_valid;
+            if(bw_valid & best[u].worse(bw_split)) best[u] = bw_split;
+            prefix[u] = prefix[u] + h;
+            // after bin b, the missing values right
+            GradStatsFixed<fixed> fw_right;
+            fw_right.sum_grad = info.nstats_grad - prefix[u].sum_grad;
+            fw_right.sum_hess = info.nstats_hess - prefix[u].sum_hess;
+            Split<fixed> fw_split;
+            fw_split.sindex = fid;
+            fw_split.fvalue = Accum<fixed>::from_rank(b);
+            fw_split.left_child_grad = prefix[u].sum_grad;
+            fw_split.left_child_hess = prefix[u].sum_hess;
+            fw_split.loss_chg = calc_Split_Gain<2*LANES, fixed>(prefix[u], fw_right,
+                                                    param_min_child_weight,
+                                                    param_max_delta_step,
+                                                    param_reg_alpha,
+                                                    param_reg_lambda,
+                                                    info.wlower, info.wupper,
+                                                    mono_in.range(2*u+1, 2*u),
+                                                    constrained, mono_valid) - info.nrg;
+            bool fw_valid = lanes.bit(u) & (prefix[u].sum_hess != zero) &
+                            (prefix[u].sum_hess >= p_min_child_weight) &
+                            (fw_right.sum_hess >= p_min_child_weight) & mono_valid;
+            if(fw_valid & best[u].worse(fw_split)) best[u] = fw_split;
+          }
+        }
+        stat_scan += bin_num;
+        U_Scan_Final: for(unsigned u=0; u<LANES; u++)
+        {
+          #pragma HLS unroll
+          tmp_best_split_uram[u][n & (MAX_NODE_NUM-1)] = best[u];
+        }
+      }
+    }
+    P_Write_Back: for(unsigned np = 0; np < node_num_p2; np++)
+    {
+      #pragma HLS loop_tripcount min=16 max=128
+      #pragma HLS pipeline II=1
+      SplitP2 splits_out;
+      U_Write_Back: for(unsigned h = 0; h < 2; h++)
+      {
+        #pragma HLS unroll
+        splits_out.range(256*h+255, 256*h) =
+            keep_Best<LANES, MAX_NODE_NUM, fixed>((np<<1) + h, tmp_best_split_uram, true);
+      }
+      best_splits[np] = splits_out;
+    }
+    // the loops run at II=1, so their trip counts are their cycles (less the pipeline depth)
+    StatsP stats_out = 0;
+    stats_out.range(32*xgboost_hist::kStatNodeInit+31, 32*xgboost_hist::kStatNodeInit) = node_num_p8 + node_num;
+    stats_out.range(32*xgboost_hist::kStatClear+31, 32*xgboost_hist::kStatClear) = stat_clear;
+    stats_out.range(32*xgboost_hist::kStatBlocks+31, 32*xgboost_hist::kStatBlocks) = stat_blocks;
+    stats_out.range(32*xgboost_hist::kStatBlocksSkipped+31, 32*xgboost_hist::kStatBlocksSkipped) =
+        feature_num_pl - stat_blocks;
+    stats_out.range(32*xgboost_hist::kStatRowCycles+31, 32*xgboost_hist::kStatRowCycles) = stat_rows;
+    stats_out.range(32*xgboost_hist::kStatRowsInactive+31, 32*xgboost_hist::kStatRowsInactive) = stat_inactive;
+    stats_out.range(32*xgboost_hist::kStatBinsMissing+31, 32*xgboost_hist::kStatBinsMissing) = stat_missing;
+    stats_out.range(32*xgboost_hist::kStatNodesSubtracted+31, 32*xgboost_hist::kStatNodesSubtracted) =
+        stat_subtracted;
+    stats_out.range(32*xgboost_hist::kStatHistReads+31, 32*xgboost_hist::kStatHistReads) = stat_hist_reads;
+    stats_out.range(32*xgboost_hist::kStatHistWrites+31, 32*xgboost_hist::kStatHistWrites) = stat_hist_writes;
+    stats_out.range(32*xgboost_hist::kStatScanCycles+31, 32*xgboost_hist::kStatScanCycles) = stat_scan;
+    stats_out.range(32*xgboost_hist::kStatWriteBack+31, 32*xgboost_hist::kStatWriteBack) = node_num_p2;
+    stats[0] = stats_out;
+  }
+
+#endif
@@ -0,0 +1,90 @@
+#include "xgboost_hist.h"
+
+  typedef ap_fixed<XGBOOST_HIST_ACCUM_WIDTH, XGBOOST_HIST_ACCUM_INT>   fixed;
+  typedef ap_uint<XGBOOST_HIST_LANES>                                   LaneMask;
+  typedef ap_uint<2*XGBOOST_HIST_LANES>                                 LaneMono;
+  typedef ap_uint<128*XGBOOST_HIST_LANES>                               HistW;
+
+extern "C"
+{
+  void xgboost_hist_0(  unsigned  row_num,
+                        unsigned  feature_num,
+                        unsigned  node_num,
+                        unsigned  bin_num,
+                        GSP8     *gpairs,
+                        NID8     *node_idxs,
+                        BinW     *bins,
+                        LaneMask *fvalid,
+                        GSP8     *node_stats,
+                        float8   *node_root_gain,
+                        SplitP2  *best_splits,
+                        float     param_min_child_weight,
+                        float     param_max_delta_step,
+                        float     param_reg_alpha,
+                        float     param_reg_lambda,
+                        float16  *node_bounds,
+                        LaneMono *fmono,
+                        unsigned  monotone,
+                        LaneMask *nfmask,
+                        unsigned  node_masks,
+                        HSRC8    *node_hist_src,
+                        unsigned  parent_num,
+                        HistW    *hist_in,
+                        HistW    *hist_out,
+                        unsigned  keep_hist,
+                        StatsP   *stats
+                      )
+  {
+    #pragma HLS interface s_axilite port=row_num bundle=control
+    #pragma HLS interface s_axilite port=feature_num bundle=control
+    #pragma HLS interface s_axilite port=node_num bundle=control
+    #pragma HLS interface s_axilite port=bin_num bundle=control
+
+    #pragma HLS interface m_axi port=gpairs offset=slave bundle=gmem0
+    #pragma HLS interface s_axilite port=gpairs bundle=control
+    #pragma HLS interface m_axi port=node_idxs offset=slave bundle=gmem1
+    #pragma HLS interface s_axilite port=node_idxs bundle=control
+    #pragma HLS interface m_axi port=bins offset=slave bundle=gmem2
+    #pragma HLS interface s_axilite port=bins bundle=control
+    #pragma HLS interface m_axi port=fvalid offset=slave bundle=gmem3
+    #pragma HLS interface s_axilite port=fvalid bundle=control
+    #pragma HLS interface m_axi port=fmono offset=slave bundle=gmem3
+    #pragma HLS interface s_axilite port=fmono bundle=control
+    #pragma HLS interface m_axi port=nfmask offset=slave bundle=gmem3
+    #pragma HLS interface s_axilite port=nfmask bundle=control
+    #pragma HLS interface m_axi port=node_stats offset=slave bundle=gmem4
+    #pragma HLS interface s_axilite port=node_stats bundle=control
+    #pragma HLS interface m_axi port=node_hist_src offset=slave bundle=gmem4
+    #pragma HLS interface s_axilite port=node_hist_src bundle=control
+    #pragma HLS interface m_axi port=node_root_gain offset=slave bundle=gmem5
+    #pragma HLS interface s_axilite port=node_root_gain bundle=control
+    #pragma HLS interface m_axi port=node_bounds offset=slave bundle=gmem5
+    #pragma HLS interface s_axilite port=node_bounds bundle=control
+    #pragma HLS interface m_axi port=best_splits offset=slave bundle=gmem6
+    #pragma HLS interface s_axilite port=best_splits bundle=control
+    #pragma HLS interface m_axi port=stats offset=slave bundle=gmem6
+    #pragma HLS interface s_axilite port=stats bundle=control
+    #pragma HLS interface m_axi port=hist_in offset=slave bundle=gmem7
+    #pragma HLS interface s_axilite port=hist_in bundle=control
+    #pragma HLS interface m_axi port=hist_out offset=slave bundle=gmem8
+    #pragma HLS interface s_axilite port=hist_out bundle=control
+
+    #pragma HLS interface s_axilite port=param_min_child_weight bundle=control
+    #pragma HLS interface s_axilite port=param_max_delta_step bundle=control
+    #pragma HLS interface s_axilite port=param_reg_alpha bundle=control
+    #pragma HLS interface s_axilite port=param_reg_lambda bundle=control
+    #pragma HLS interface s_axilite port=monotone bundle=control
+    #pragma HLS interface s_axilite port=node_masks bundle=control
+    #pragma HLS interface s_axilite port=parent_num bundle=control
+    #pragma HLS interface s_axilite port=keep_hist bundle=control
+
+    #pragma HLS interface s_axilite port=return bundle=control
+
+    hist_Kernel<XGBOOST_HIST_LANES, XGBOOST_HIST_BIN_BITS, XGBOOST_HIST_MAX_BIN, XGBOOST_HIST_MAX_NODE_NUM, fixed>(
+        row_num, feature_num, node_num, bin_num,
+        gpairs, node_idxs, bins, fvalid, node_stats, node_root_gain, best_splits,
+        param_min_child_weight, param_max_delta_step, param_reg_alpha, param_reg_lambda,
+        node_bounds, fmono, monotone, nfmask, node_masks,
+        node_hist_src, parent_num, hist_in, hist_out, keep_hist, stats);
+  }
+}
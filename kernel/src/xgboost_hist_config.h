@@ -0,0 +1,95 @@
+// Compile time configuration of the histogram kernel, shared with the grow_fpga_hist
+// updaters so that the device layout and the split records agree on both sides.
+// Every value can be overridden with -D at kernel and library build time.
+#ifndef XGBOOST_HIST_CONFIG_H
+#define XGBOOST_HIST_CONFIG_H
+
+// features binned in parallel, one bin column per lane; 4 lanes fill the 512-bit
+// histogram words
+#ifndef XGBOOST_HIST_LANES
+#define XGBOOST_HIST_LANES 4
+#endif
+
+// bits of a quantized value (8 or 16); the all-ones value marks a missing one
+#ifndef XGBOOST_HIST_BIN_BITS
+#define XGBOOST_HIST_BIN_BITS 8
+#endif
+
+// histogram slots of a node on the chip (a power of two), and the nodes held
+#ifndef XGBOOST_HIST_MAX_BIN
+#define XGBOOST_HIST_MAX_BIN 256
+#endif
+#ifndef XGBOOST_HIST_MAX_NODE_NUM
+#define XGBOOST_HIST_MAX_NODE_NUM 256
+#endif
+
+// fixed point type of the histogram accumulators: total and integer bits; wide
+// enough for the node sums of the large datasets the kernel is meant for, and
+// exact, so that the histograms derived by subtraction match the built ones
+#ifndef XGBOOST_HIST_ACCUM_WIDTH
+#define XGBOOST_HIST_ACCUM_WIDTH 48
+#endif
+#ifndef XGBOOST_HIST_ACCUM_INT
+#define XGBOOST_HIST_ACCUM_INT 24
+#endif
+
+namespace xgboost_hist {
+
+constexpr unsigned kLanes = XGBOOST_HIST_LANES;
+constexpr unsigned kBinBits = XGBOOST_HIST_BIN_BITS;
+constexpr unsigned kMaxNodeNum = XGBOOST_HIST_MAX_NODE_NUM;
+constexpr unsigned kBinSlots = XGBOOST_HIST_MAX_BIN;
+// code of a missing value, and the bins of a feature the kernel can hold
+constexpr unsigned kMissingBin = (1u << kBinBits) - 1;
+constexpr unsigned kMaxBin = kBinSlots < kMissingBin ? kBinSlots : kMissingBin;
+constexpr int kAccumInt = XGBOOST_HIST_ACCUM_INT;
+// precision reported by the kernel in every split record, as in the exact kernel
+constexpr unsigned kPrecisionTag = (XGBOOST_HIST_ACCUM_WIDTH << 8) | XGBOOST_HIST_ACCUM_INT;
+// rows of a block of quantized values in a 512-bit word; the rows of a layout are
+// padded to kRowAlign, a whole number of these words and of gradient words
+constexpr unsigned kRowsPerWord = 512 / (kLanes * kBinBits);
+constexpr unsigned kRowAlign = kRowsPerWord > 8 ? kRowsPerWord : 8;
+// a bin of a block in the device histograms: the raw grad and hess accumulators
+// of every lane, 64 bits each
+constexpr unsigned kHistBytes = kLanes * 16;
+// histogram source of a node built from its rows; the others get the slot of their
+// parent in the previous call in the upper 16 bits and their sibling in the lower
+constexpr unsigned kHistFromRows = 0xffffffff;
+// size of a split record, two of them per 512-bit result word
+constexpr unsigned kSplitBytes = 32;
+// 2-bit monotone direction of a lane in fmono, the codes of the exact kernel
+constexpr unsigned kMonoInc = 1;
+constexpr unsigned kMonoDec = 2;
+// 32-bit counters of the stats word written by the kernel after every call; the
+// loops run at II=1, so the loop counters are cycle counts
+enum Stat : unsigned {
+  kStatNodeInit = 0,       // node info loads
+  kStatClear,              // histogram bin clears
+  kStatBlocks,             // lane blocks binned
+  kStatBlocksSkipped,      // lane blocks without a valid feature
+  kStatRowCycles,          // rows streamed
+  kStatRowsInactive,       // rows in no node built from its rows
+  kStatBinsMissing,        // lane slots of a missing value
+  kStatNodesSubtracted,    // node histograms derived from the parent and sibling
+  kStatHistReads,          // parent histogram words read
+  kStatHistWrites,         // histogram words kept for the next call
+  kStatScanCycles,         // split scan iterations
+  kStatWriteBack,          // best split writes
+  kStatCount = 32
+};
+
+// number of lane blocks covering n features
+constexpr unsigned BlockCount(unsigned n) {
+  return n / kLanes + ((n % kLanes) > 0 ? 1 : 0);
+}
+
+static_assert(kLanes == 1 || kLanes == 2 || kLanes == 4, "1, 2 or 4 lanes fit the histogram words");
+static_assert(kBinBits == 8 || kBinBits == 16, "8 or 16 bit quantized values are supported");
+static_assert((kBinSlots & (kBinSlots - 1)) == 0, "histogram slots must be a power of two");
+static_assert(kBinSlots <= (1u << kBinBits), "more histogram slots than quantized values");
+static_assert(kMaxNodeNum % 8 == 0 && kMaxNodeNum <= 65536, "node capacity must be a multiple of 8");
+static_assert(XGBOOST_HIST_ACCUM_WIDTH <= 64, "fixed point accumulators up to 64 bits");
+
+}  // namespace xgboost_hist
+
+#endif  // XGBOOST_HIST_CONFIG_H
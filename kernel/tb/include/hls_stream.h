@@ -0,0 +1,38 @@
+// Unbounded hls::stream for C simulation without Vivado HLS: the dataflow
+// processes of a call run one after the other, so every stream holds all the
+// data of its producer
+#ifndef XGBOOST_EXACT_TB_HLS_STREAM_H
+#define XGBOOST_EXACT_TB_HLS_STREAM_H
+
+#include <cassert>
+#include <deque>
+
+namespace hls {
+
+template <typename T>
+class stream {
+ public:
+  stream() {}
+  explicit stream(const char*) {}
+  void write(const T& v) { q_.push_back(v); }
+  T read() {
+    assert(!q_.empty() && "read from an empty stream");
+    T v = q_.front();
+    q_.pop_front();
+    return v;
+  }
+  void operator<<(const T& v) { write(v); }
+  void operator>>(T& v) { v = read(); }
+  bool empty() const { return q_.empty(); }
+  bool full() const { return false; }
+  size_t size() const { return q_.size(); }
+
+ private:
+  stream(const stream&);
+  stream& operator=(const stream&);
+  std::deque<T> q_;
+};
+
+}  // namespace hls
+
+#endif  // XGBOOST_EXACT_TB_HLS_STREAM_H
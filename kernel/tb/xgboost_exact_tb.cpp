@@ -0,0 +1,816 @@
+// C simulation testbench of the exact kernel: random tree levels are packed the
+// way the updater packs them, run through xgboost_exact_0 and its best splits are
+// checked against an exact enumeration of the same candidates on the cpu.
+//
+//   xgboost_exact_tb [trials] [seed]
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "xgboost_exact.h"
+
+#if XGBOOST_EXACT_PRECISION == XGBOOST_EXACT_FLOAT
+  typedef float                                                         fixed;
+#else
+  typedef ap_fixed<XGBOOST_EXACT_ACCUM_WIDTH, XGBOOST_EXACT_ACCUM_INT> fixed;
+#endif
+  typedef ap_uint<XGBOOST_EXACT_LANES>                                  LaneMask;
+  typedef ap_uint<2*XGBOOST_EXACT_LANES>                                LaneMono;
+  typedef ap_uint<EntryP::width*XGBOOST_EXACT_LANES/XGBOOST_EXACT_ENTRY_PORTS> EntryPW;
+
+extern "C" void xgboost_exact_0(unsigned entry_num, unsigned feature_num, unsigned node_num,
+    unsigned entry_num_batch, GSP8 *gpairs, NID8 *node_idxs, EntryPW *entries, LaneMask *fvalid,
+    GSP8 *node_stats, float8 *node_root_gain, SplitP2 *best_splits, float param_min_child_weight,
+    float param_max_delta_step, float param_reg_alpha, float param_reg_lambda, unsigned compact_entries,
+    LaneMask *fdense, EntryPW *entries_hi, float16 *node_bounds, LaneMono *fmono, unsigned monotone,
+    LaneMask *nfmask, unsigned node_masks, StatsP *stats, unsigned tree_depth, float param_split_eps,
+    SeedP *node_seeds, unsigned range_seeds, unsigned *node_segs, unsigned node_partition);
+
+namespace {
+
+using namespace xgboost_exact;
+
+const float kRtEps = 1e-6f;
+
+struct HostEntry {
+  uint32_t index;
+  float fvalue;
+};
+
+// split record of the kernel, as read back by the updater
+struct HostSplit {
+  float loss_chg;
+  uint32_t sindex;
+  float split_value;
+  float left_sum_grad;
+  float left_sum_hess;
+  uint32_t tag;
+  uint32_t pad[2];
+};
+
+// one level of a tree: the rows of its work nodes and the columns of a request; a
+// fused call grows depth levels from it, with value ranges every range of the
+// entries of the columns gets a call of its own, a partitioned level has the
+// entries of every node apart, a bundled level has its single valued features
+// bundled into shared columns
+struct Level {
+  unsigned rows, features, nodes, depth, ranges;
+  bool single_pass, compact, monotone, node_masks, partition, bundled;
+  float min_child_weight, reg_alpha, reg_lambda, gscale;
+  std::vector<float> grad, hess;
+  std::vector<short> position;
+  // entries of every feature sorted by value, and its distinct values
+  std::vector<std::vector<HostEntry>> columns;
+  std::vector<std::vector<float>> values;
+  std::vector<bool> fvalid, fdense, fbundle;
+  std::vector<std::vector<bool>> nfmask;
+  std::vector<int> fmono;
+  std::vector<double> sum_grad, sum_hess, root_gain;
+  std::vector<float> wlower, wupper;
+};
+
+double ThresholdL1(double g, double alpha) {
+  if (g > alpha) return g - alpha;
+  if (g < -alpha) return g + alpha;
+  return 0.0;
+}
+
+double Gain(const Level& lv, double g, double h) {
+  double t = ThresholdL1(g, lv.reg_alpha);
+  return t * t / (h + lv.reg_lambda);
+}
+
+double Weight(const Level& lv, unsigned n, double g, double h) {
+  double w = -ThresholdL1(g, lv.reg_alpha) / (h + lv.reg_lambda);
+  return std::min(std::max(w, static_cast<double>(lv.wlower[n])), static_cast<double>(lv.wupper[n]));
+}
+
+double Score(const Level& lv, double g, double h, double w) {
+  return -(w * (2.0 * g + (h + lv.reg_lambda) * w) + 2.0 * lv.reg_alpha * std::fabs(w));
+}
+
+// loss change of a split of node n on feature fid, false if it is not allowed
+bool SplitGain(const Level& lv, unsigned n, unsigned fid, double lg, double lh, double* loss_chg) {
+  double rg = lv.sum_grad[n] - lg, rh = lv.sum_hess[n] - lh;
+  if (lh < lv.min_child_weight || rh < lv.min_child_weight) return false;
+  if (!lv.monotone) {
+    *loss_chg = Gain(lv, lg, lh) + Gain(lv, rg, rh) - lv.root_gain[n];
+    return true;
+  }
+  double wl = Weight(lv, n, lg, lh), wr = Weight(lv, n, rg, rh);
+  if ((lv.fmono[fid] > 0 && wl > wr) || (lv.fmono[fid] < 0 && wl < wr)) return false;
+  *loss_chg = Score(lv, lg, lh, wl) + Score(lv, rg, rh, wr) - lv.root_gain[n];
+  return true;
+}
+
+// features of node n the kernel scans
+bool Allowed(const Level& lv, unsigned n, unsigned fid) {
+  return lv.fvalid[fid] && (!lv.node_masks || lv.nfmask[n][fid]);
+}
+
+// a block is scanned once when all its valid features are dense
+bool SinglePassBlock(const Level& lv, unsigned fid) {
+  unsigned begin = (fid / kLanes) * kLanes;
+  unsigned end = std::min(begin + kLanes, lv.features);
+  for (unsigned f = begin; f < end; f++)
+    if (lv.fvalid[f] && !lv.fdense[f]) return false;
+  return true;
+}
+
+// best loss change of node n over the candidates of grow_colmaker: the forward scan
+// sends the missing values right, the backward one left, starting with all present
+// values right; a single pass block only scans forward, with the default left
+double BestSplit(const Level& lv, unsigned n) {
+  double best = 0.0;
+  for (unsigned f = 0; f < lv.features; f++) {
+    if (!Allowed(lv, n, f)) continue;
+    std::vector<HostEntry> e;
+    for (const auto& x : lv.columns[f])
+      if (lv.position[x.index] == static_cast<short>(n)) e.push_back(x);
+    if (e.empty()) continue;
+    double pg = 0.0, ph = 0.0;
+    for (const auto& x : e) {
+      pg += lv.grad[x.index];
+      ph += lv.hess[x.index];
+    }
+    auto update = [&](double lg, double lh) {
+      double loss_chg;
+      if (SplitGain(lv, n, f, lg, lh, &loss_chg) && loss_chg > best) best = loss_chg;
+    };
+    double cg = 0.0, ch = 0.0;
+    for (size_t i = 0; i < e.size(); i++) {
+      if (i > 0 && e[i - 1].fvalue != e[i].fvalue) update(cg, ch);
+      cg += lv.grad[e[i].index];
+      ch += lv.hess[e[i].index];
+    }
+    if (lv.single_pass && SinglePassBlock(lv, f)) continue;
+    double rg = pg, rh = ph;
+    update(lv.sum_grad[n] - rg, lv.sum_hess[n] - rh);
+    for (size_t i = 0; i < e.size(); i++) {
+      if (i > 0 && e[i - 1].fvalue != e[i].fvalue) update(lv.sum_grad[n] - rg, lv.sum_hess[n] - rh);
+      rg -= lv.grad[e[i].index];
+      rh -= lv.hess[e[i].index];
+    }
+  }
+  return best;
+}
+
+// left sums of a split of node n, as the updater applies it
+void LeftSums(const Level& lv, unsigned n, unsigned fid, float split_value, bool default_left,
+              double* lg, double* lh) {
+  double pg = 0.0, ph = 0.0;
+  *lg = 0.0;
+  *lh = 0.0;
+  for (const auto& x : lv.columns[fid]) {
+    if (lv.position[x.index] != static_cast<short>(n)) continue;
+    pg += lv.grad[x.index];
+    ph += lv.hess[x.index];
+    if (x.fvalue < split_value) {
+      *lg += lv.grad[x.index];
+      *lh += lv.hess[x.index];
+    }
+  }
+  if (default_left) {
+    *lg += lv.sum_grad[n] - pg;
+    *lh += lv.sum_hess[n] - ph;
+  }
+}
+
+// the threshold of a split found on compact entries, as DecodeSplitValue rebuilds it
+float DecodeSplitValue(const Level& lv, const HostSplit& split) {
+  uint32_t ranks;
+  std::memcpy(&ranks, &split.split_value, sizeof(ranks));
+  const auto& values = lv.values[split.sindex & 0x7fffffff];
+  uint32_t prev = ranks >> 16, curr = ranks & 0xffff;
+  if (prev >= values.size()) return 0.0f;
+  if (curr == 0xffff) return values[prev] - (std::fabs(values[prev]) + kRtEps);
+  if (curr >= values.size()) return 0.0f;
+  return (values[prev] + values[curr]) * 0.5f;
+}
+
+// the power of two gradient scale of GradientScale in the updater
+float GradScale(const Level& lv) {
+  if (kFloatAccum) return 1.0f;
+  double sum_grad = 0.0, sum_hess = 0.0, sum_gain = 0.0;
+  for (unsigned r = 0; r < lv.rows; r++) {
+    sum_grad += std::fabs(lv.grad[r]);
+    sum_hess += lv.hess[r];
+    sum_gain += lv.grad[r] * lv.grad[r] / (lv.hess[r] + lv.reg_lambda);
+  }
+  double bound = std::max(std::max(sum_grad, sum_hess), sum_gain);
+  if (!(bound > 0.0)) return 1.0f;
+  int exp = static_cast<int>(std::floor(std::log2(std::ldexp(1.0, kAccumInt - 2) / bound)));
+  exp = std::min(std::max(exp, -30), 30);
+  return std::ldexp(1.0f, exp);
+}
+
+// sums and root gains of the nodes from the positions of the rows
+void NodeSums(Level* lv) {
+  lv->sum_grad.assign(lv->nodes, 0.0);
+  lv->sum_hess.assign(lv->nodes, 0.0);
+  for (unsigned r = 0; r < lv->rows; r++)
+    if (lv->position[r] >= 0) {
+      lv->sum_grad[lv->position[r]] += lv->grad[r];
+      lv->sum_hess[lv->position[r]] += lv->hess[r];
+    }
+  lv->root_gain.resize(lv->nodes);
+  for (unsigned n = 0; n < lv->nodes; n++) lv->root_gain[n] = Gain(*lv, lv->sum_grad[n], lv->sum_hess[n]);
+}
+
+Level RandomLevel(std::mt19937* rng) {
+  auto uniform = [&](unsigned lo, unsigned hi) {
+    return std::uniform_int_distribution<unsigned>(lo, hi)(*rng);
+  };
+  auto coin = [&](double p) { return std::bernoulli_distribution(p)(*rng); };
+  auto real = [&](double lo, double hi) { return std::uniform_real_distribution<double>(lo, hi)(*rng); };
+  Level lv;
+  lv.rows = uniform(1, 2000);
+  lv.features = uniform(1, 4 * kLanes + 3);
+  lv.nodes = uniform(1, 24);
+  lv.single_pass = coin(0.5);
+  lv.compact = coin(0.3);
+  lv.monotone = coin(0.3);
+  lv.node_masks = coin(0.3);
+  // the fused tree mode runs without monotone constraints and per node masks
+  lv.depth = coin(0.3) ? uniform(1, 5) : 0;
+  if (lv.depth) lv.monotone = lv.node_masks = false;
+  lv.ranges = (!lv.depth && coin(0.3)) ? uniform(2, 3) : 1;
+  lv.partition = !lv.depth && lv.ranges == 1 && coin(0.3);
+  // more nodes than the node tables of the kernel hold
+  if (lv.partition && coin(0.1)) lv.nodes = kMaxNodeNum + uniform(1, 64);
+  // the updater bundles the features of the column layout scanned at every node
+  lv.bundled = !lv.depth && lv.ranges == 1 && !lv.partition && !lv.compact && !lv.node_masks && coin(0.3);
+  if (lv.bundled) lv.features = uniform(kLanes, 8 * kLanes);
+  lv.min_child_weight = coin(0.5) ? 1.0f : static_cast<float>(real(0.0, 4.0));
+  lv.reg_alpha = coin(0.7) ? 0.0f : static_cast<float>(real(0.0, 1.0));
+  lv.reg_lambda = static_cast<float>(real(0.5, 2.0));
+  lv.grad.resize(lv.rows);
+  lv.hess.resize(lv.rows);
+  lv.position.resize(lv.rows);
+  for (unsigned r = 0; r < lv.rows; r++) {
+    lv.grad[r] = static_cast<float>(real(-1.0, 1.0));
+    lv.hess[r] = static_cast<float>(real(0.01, 1.0));
+    // rows of finished nodes or out of the subsample
+    lv.position[r] = coin(0.15) ? -1 : static_cast<short>(uniform(0, lv.nodes - 1));
+  }
+  // dense, sparse and few valued features, values on a 1/16 grid that both the
+  // fixed point and the float kernels hold exactly; mostly one-hot like features
+  // for the bundled levels
+  lv.columns.resize(lv.features);
+  lv.values.resize(lv.features);
+  lv.fdense.resize(lv.features);
+  lv.fbundle.assign(lv.features, false);
+  for (unsigned f = 0; f < lv.features; f++) {
+    double density = coin(0.4) ? 1.0 : real(0.05, 0.95);
+    unsigned levels = coin(0.3) ? uniform(1, 4) : 2048;
+    unsigned onehot = (lv.bundled && coin(0.7)) ? uniform(1, levels) : 0;
+    if (onehot) density = real(0.01, 0.3);
+    for (unsigned r = 0; r < lv.rows; r++)
+      if (coin(density))
+        lv.columns[f].push_back(HostEntry{r, static_cast<float>(onehot ? onehot - 1 : uniform(0, levels - 1)) / 16.0f - 64.0f});
+    std::stable_sort(lv.columns[f].begin(), lv.columns[f].end(),
+                     [](const HostEntry& a, const HostEntry& b) { return a.fvalue < b.fvalue; });
+    for (const auto& x : lv.columns[f])
+      if (lv.values[f].empty() || lv.values[f].back() != x.fvalue) lv.values[f].push_back(x.fvalue);
+    lv.fdense[f] = lv.single_pass && lv.columns[f].size() == lv.rows;
+  }
+  // colsample of the level, and of every node
+  lv.fvalid.resize(lv.features);
+  for (unsigned f = 0; f < lv.features; f++) lv.fvalid[f] = lv.bundled || coin(0.8);
+  lv.nfmask.assign(lv.nodes, std::vector<bool>(lv.features, true));
+  if (lv.node_masks)
+    for (unsigned n = 0; n < lv.nodes; n++)
+      for (unsigned f = 0; f < lv.features; f++) lv.nfmask[n][f] = lv.fvalid[f] && coin(0.7);
+  lv.fmono.assign(lv.features, 0);
+  const float wlimit = std::ldexp(1.0f, kAccumInt - 2);
+  lv.wlower.assign(lv.nodes, -wlimit);
+  lv.wupper.assign(lv.nodes, wlimit);
+  if (lv.monotone) {
+    for (unsigned f = 0; f < lv.features; f++) lv.fmono[f] = static_cast<int>(uniform(0, 2)) - 1;
+    for (unsigned n = 0; n < lv.nodes; n++)
+      if (coin(0.5)) {
+        lv.wlower[n] = static_cast<float>(real(-1.0, 0.0));
+        lv.wupper[n] = static_cast<float>(real(0.0, 1.0));
+      }
+  }
+  NodeSums(&lv);
+  lv.gscale = GradScale(lv);
+  return lv;
+}
+
+uint32_t FloatBits(float v) {
+  uint32_t bits;
+  std::memcpy(&bits, &v, sizeof(bits));
+  return bits;
+}
+
+template <typename W>
+void Put32(W* word, unsigned slot, uint32_t bits) {
+  word->range(slot * 32 + 31, slot * 32) = bits;
+}
+
+struct Result {
+  int mismatches;
+  std::vector<uint32_t> stats;
+};
+
+// first sorted entry of value range r of a column of n entries, as in the updater
+unsigned RangeBegin(unsigned n, unsigned r, unsigned ranges) {
+  return static_cast<unsigned>(static_cast<uint64_t>(n) * r / ranges);
+}
+
+// the value of an entry as the kernel compares it: the float bits or the rank
+uint32_t ValueBits(const Level& lv, unsigned fid, float fvalue) {
+  if (!lv.compact) return FloatBits(fvalue);
+  const auto& values = lv.values[fid];
+  return std::lower_bound(values.begin(), values.end(), fvalue) - values.begin();
+}
+
+// the scan state of every node and lane at the start of value range r, as
+// RangeSeeds of the updater packs it
+std::vector<SeedP> RangeSeeds(const Level& lv, unsigned r) {
+  const float s = lv.gscale;
+  std::vector<SeedP> seeds(BlockCount(lv.features) * lv.nodes * kLanes, 0);
+  for (unsigned f = 0; f < lv.features; f++) {
+    const auto& col = lv.columns[f];
+    std::vector<double> tg(lv.nodes, 0.0), th(lv.nodes, 0.0), pg(lv.nodes, 0.0), ph(lv.nodes, 0.0);
+    std::vector<uint32_t> prev(lv.nodes, 0);
+    std::vector<bool> has_prev(lv.nodes, false);
+    unsigned begin = RangeBegin(col.size(), r, lv.ranges);
+    for (size_t i = 0; i < col.size(); i++) {
+      short n = lv.position[col[i].index];
+      if (n < 0) continue;
+      tg[n] += lv.grad[col[i].index];
+      th[n] += lv.hess[col[i].index];
+      if (i >= begin) continue;
+      pg[n] += lv.grad[col[i].index];
+      ph[n] += lv.hess[col[i].index];
+      prev[n] = ValueBits(lv, f, col[i].fvalue);
+      has_prev[n] = true;
+    }
+    for (unsigned n = 0; n < lv.nodes; n++) {
+      SeedP& seed = seeds[((f / kLanes) * lv.nodes + n) * kLanes + f % kLanes];
+      Put32(&seed, 0, FloatBits(static_cast<float>(pg[n] * s)));
+      Put32(&seed, 1, FloatBits(static_cast<float>(ph[n] * s)));
+      Put32(&seed, 2, FloatBits(static_cast<float>((tg[n] - pg[n]) * s)));
+      Put32(&seed, 3, FloatBits(static_cast<float>((th[n] - ph[n]) * s)));
+      Put32(&seed, 4, prev[n]);
+      seed.bit(160) = has_prev[n] ? 1 : 0;
+    }
+  }
+  return seeds;
+}
+
+HostSplit ReadSplit(const SplitP2* best_splits, unsigned n) {
+  uint32_t words[8];
+  for (unsigned j = 0; j < 8; j++)
+    words[j] = best_splits[n / 2].range((n % 2) * 256 + j * 32 + 31, (n % 2) * 256 + j * 32).to_uint();
+  HostSplit split;
+  std::memcpy(&split, words, sizeof(split));
+  return split;
+}
+
+void WriteSplit(SplitP2* best_splits, unsigned n, const HostSplit& split) {
+  uint32_t words[8];
+  std::memcpy(words, &split, sizeof(split));
+  for (unsigned j = 0; j < 8; j++)
+    best_splits[n / 2].range((n % 2) * 256 + j * 32 + 31, (n % 2) * 256 + j * 32) = words[j];
+}
+
+// the merge of the splits of the requests in SyncBestSolution: the larger loss
+// change, the smaller feature on ties
+bool NeedReplace(const HostSplit& cur, const HostSplit& split) {
+  if ((cur.sindex & 0x7fffffff) <= (split.sindex & 0x7fffffff)) return split.loss_chg > cur.loss_chg;
+  return !(cur.loss_chg > split.loss_chg);
+}
+
+// check the splits of the nodes of a level, returns the mismatches
+int CheckSplits(const Level& lv, const SplitP2* best_splits, bool verbose) {
+  const float s = lv.gscale;
+  int mismatches = 0;
+  for (unsigned n = 0; n < lv.nodes; n++) {
+    HostSplit split = ReadSplit(best_splits, n);
+    double best = BestSplit(lv, n);
+    double loss_chg = split.loss_chg / s;
+    // fixed point sums round every gradient, the gains follow their magnitude
+    double tol = 1e-3 * std::max(1.0, std::fabs(best)) +
+        (kFloatAccum ? 0.0 : std::ldexp(4.0 * lv.rows, kAccumInt - XGBOOST_EXACT_ACCUM_WIDTH) / s);
+    const char* error = nullptr;
+    uint32_t fid = split.sindex & 0x7fffffff;
+    bool default_left = (split.sindex >> 31) != 0;
+    float split_value = lv.compact ? DecodeSplitValue(lv, split) : split.split_value;
+    double lg = 0.0, lh = 0.0, eval = 0.0;
+    if (split.tag != kPrecisionTag) {
+      error = "precision tag";
+    } else if (std::fabs(loss_chg - best) > tol) {
+      error = "loss change";
+    } else if (best > tol) {
+      // the split found must be one of the best ones
+      if (fid >= lv.features || !Allowed(lv, n, fid)) {
+        error = "feature";
+      } else {
+        LeftSums(lv, n, fid, split_value, default_left, &lg, &lh);
+        if (!SplitGain(lv, n, fid, lg, lh, &eval) || std::fabs(eval - loss_chg) > tol)
+          error = "split";
+        else if (std::fabs(lg - split.left_sum_grad / s) > tol || std::fabs(lh - split.left_sum_hess / s) > tol)
+          error = "left sums";
+      }
+    }
+    if (error) mismatches++;
+    if (error || verbose)
+      printf("  node %u: ref %.5f | kernel %.5f f%u%s %.4f left %.4f/%.4f (applied %.5f, %.4f/%.4f)%s%s\n",
+             n, best, loss_chg, fid, default_left ? "L" : "R", split_value, split.left_sum_grad / s,
+             split.left_sum_hess / s, eval, lg, lh, error ? " MISMATCH " : "", error ? error : "");
+  }
+  return mismatches;
+}
+
+// the column layout of a bundled level, as BundleFeatures of the updater lays it out:
+// the single valued features without a monotone direction go first fit by entry count
+// into bundles of at most the entries of the longest column, whose entries carry the
+// position of their feature in the bundle as value; cols gets the features of every
+// layout column
+Level BundleLevel(const Level& lv, std::vector<std::vector<unsigned>>* cols) {
+  unsigned capacity = 0;
+  for (const auto& c : lv.columns) capacity = std::max<unsigned>(capacity, c.size());
+  std::vector<unsigned> order;
+  for (unsigned f = 0; f < lv.features; f++)
+    if (lv.values[f].size() == 1 && lv.fmono[f] == 0) order.push_back(f);
+  std::stable_sort(order.begin(), order.end(),
+                   [&lv](unsigned a, unsigned b) { return lv.columns[a].size() > lv.columns[b].size(); });
+  std::vector<std::vector<unsigned>> groups;
+  std::vector<unsigned> load;
+  for (unsigned f : order) {
+    size_t g = 0;
+    while (g < groups.size() && (load[g] + lv.columns[f].size() > capacity || groups[g].size() == kMaxBundleFeatures))
+      g++;
+    if (g == groups.size()) {
+      groups.emplace_back();
+      load.push_back(0);
+    }
+    groups[g].push_back(f);
+    load[g] += lv.columns[f].size();
+  }
+  std::vector<bool> bundled(lv.features, false);
+  for (const auto& group : groups)
+    for (unsigned f : group) bundled[f] = group.size() > 1;
+  cols->clear();
+  for (unsigned f = 0; f < lv.features; f++)
+    if (!bundled[f]) cols->push_back(std::vector<unsigned>(1, f));
+  for (auto& group : groups) {
+    if (group.size() < 2) continue;
+    std::sort(group.begin(), group.end());
+    cols->push_back(group);
+  }
+  Level out = lv;
+  out.features = cols->size();
+  out.columns.assign(out.features, std::vector<HostEntry>());
+  out.values.assign(out.features, std::vector<float>());
+  out.fvalid.assign(out.features, true);
+  out.fdense.assign(out.features, false);
+  out.fbundle.assign(out.features, false);
+  out.fmono.assign(out.features, 0);
+  out.nfmask.assign(out.nodes, std::vector<bool>(out.features, true));
+  for (unsigned c = 0; c < out.features; c++) {
+    const auto& feats = (*cols)[c];
+    if (feats.size() == 1) {
+      out.columns[c] = lv.columns[feats[0]];
+      out.values[c] = lv.values[feats[0]];
+      out.fdense[c] = lv.fdense[feats[0]];
+      out.fmono[c] = lv.fmono[feats[0]];
+      continue;
+    }
+    out.fbundle[c] = true;
+    for (unsigned pos = 0; pos < feats.size(); pos++) {
+      for (const auto& x : lv.columns[feats[pos]]) out.columns[c].push_back(HostEntry{x.index, static_cast<float>(pos)});
+      out.values[c].push_back(static_cast<float>(pos));
+    }
+  }
+  return out;
+}
+
+// the splits of the layout columns of a bundled level on the features of the level, as
+// FeatureBundles::Split of the updater decodes them
+void DecodeBundles(const Level& lv, const std::vector<std::vector<unsigned>>& cols, SplitP2* best_splits) {
+  for (unsigned n = 0; n < lv.nodes; n++) {
+    HostSplit split = ReadSplit(best_splits, n);
+    const uint32_t c = split.sindex & 0x7fffffff, default_left = split.sindex & 0x80000000;
+    if (c >= cols.size()) continue;
+    if (cols[c].size() == 1) {
+      split.sindex = cols[c][0] | default_left;
+    } else {
+      int pos = static_cast<int>(std::floor(split.split_value)) + (default_left ? 1 : 0);
+      pos = std::min(std::max(pos, 0), static_cast<int>(cols[c].size()) - 1);
+      const unsigned fid = cols[c][pos];
+      const float v = lv.values[fid][0];
+      split.sindex = fid | default_left;
+      split.split_value = default_left ? v : v + std::fabs(v) + kRtEps;
+    }
+    WriteSplit(best_splits, n, split);
+  }
+}
+
+// apply the splits of a level like the updater, with the expansion test of the
+// kernel: the children of the k-th split node are 2k and 2k+1; false if none split
+bool ApplySplits(Level* lv, const SplitP2* best_splits) {
+  std::vector<int> pair(lv->nodes, -1);
+  std::vector<HostSplit> splits(lv->nodes);
+  unsigned pairs = 0;
+  for (unsigned n = 0; n < lv->nodes; n++) {
+    splits[n] = ReadSplit(best_splits, n);
+    if (splits[n].loss_chg > kRtEps * lv->gscale) pair[n] = pairs++;
+  }
+  std::vector<short> next(lv->rows, -1);
+  for (unsigned r = 0; r < lv->rows; r++) {
+    short n = lv->position[r];
+    if (n < 0 || pair[n] < 0) continue;
+    next[r] = static_cast<short>(2 * pair[n] + ((splits[n].sindex >> 31) ? 0 : 1));
+  }
+  for (unsigned n = 0; n < lv->nodes; n++) {
+    if (pair[n] < 0) continue;
+    uint32_t fid = splits[n].sindex & 0x7fffffff;
+    float split_value = lv->compact ? DecodeSplitValue(*lv, splits[n]) : splits[n].split_value;
+    for (const auto& x : lv->columns[fid])
+      if (lv->position[x.index] == static_cast<short>(n))
+        next[x.index] = static_cast<short>(2 * pair[n] + (x.fvalue < split_value ? 0 : 1));
+  }
+  lv->position = next;
+  lv->nodes = 2 * pairs;
+  lv->nfmask.assign(lv->nodes, std::vector<bool>(lv->features, true));
+  // fused trials have no weight bounds
+  const float wlower = lv->wlower[0], wupper = lv->wupper[0];
+  lv->wlower.assign(lv->nodes, wlower);
+  lv->wupper.assign(lv->nodes, wupper);
+  NodeSums(lv);
+  return pairs > 0;
+}
+
+// pack a column layout of kLanes entries per row into the entry ports; compact
+// entries hold the rows 2w and 2w+1 of the port lanes in word w, the block of every
+// row gives the features of its lanes
+void PackPorts(const Level& lv, const std::vector<HostEntry>& layout, const std::vector<unsigned>& row_block,
+               std::vector<EntryPW>* entries, std::vector<EntryPW>* entries_hi) {
+  const unsigned rows = row_block.size();
+  for (unsigned port = 0; port < kEntryPorts; port++) {
+    std::vector<EntryPW>& words = port == 0 ? *entries : *entries_hi;
+    if (lv.compact) {
+      // 16-bit row and 16-bit rank
+      words.assign(std::max(rows / 2, 1u), 0);
+      for (unsigned i = 0; i < rows * kPortLanes; i++) {
+        unsigned row = i / kPortLanes, lane = port * kPortLanes + i % kPortLanes;
+        const HostEntry& e = layout[row * kLanes + lane];
+        uint32_t entry = 0xffff;
+        if (e.index != 0xffffffffu) entry = (ValueBits(lv, row_block[row] * kLanes + lane, e.fvalue) << 16) | e.index;
+        Put32(&words[i / (2 * kPortLanes)], i % (2 * kPortLanes), entry);
+      }
+    } else {
+      words.assign(std::max(rows, 1u), 0);
+      for (unsigned i = 0; i < rows; i++)
+        for (unsigned u = 0; u < kPortLanes; u++) {
+          const HostEntry& e = layout[i * kLanes + port * kPortLanes + u];
+          Put32(&words[i], 2 * u, e.index);
+          Put32(&words[i], 2 * u + 1, FloatBits(e.fvalue));
+        }
+    }
+  }
+  // the upper lanes of a two port kernel, never read by a single port one
+  if (kEntryPorts == 1) *entries_hi = *entries;
+}
+
+// pack the entries of value range r of the columns of a level into the entry ports,
+// batch rows per block of kLanes features; padding rows of index -1
+unsigned PackEntries(const Level& lv, unsigned r, std::vector<EntryPW>* entries, std::vector<EntryPW>* entries_hi) {
+  const unsigned nblk = BlockCount(lv.features);
+  unsigned batch = 1;
+  for (const auto& c : lv.columns)
+    batch = std::max(batch, RangeBegin(c.size(), r + 1, lv.ranges) - RangeBegin(c.size(), r, lv.ranges));
+  // a compact block is a whole number of words
+  const unsigned stride = lv.compact ? batch + batch % 2 : batch;
+  std::vector<HostEntry> layout(nblk * stride * kLanes, HostEntry{0xffffffffu, 0.0f});
+  std::vector<unsigned> row_block(nblk * stride);
+  for (unsigned i = 0; i < row_block.size(); i++) row_block[i] = i / stride;
+  for (unsigned f = 0; f < lv.features; f++) {
+    unsigned begin = RangeBegin(lv.columns[f].size(), r, lv.ranges);
+    unsigned end = RangeBegin(lv.columns[f].size(), r + 1, lv.ranges);
+    for (unsigned i = begin; i < end; i++)
+      layout[((f / kLanes) * stride + i - begin) * kLanes + f % kLanes] = lv.columns[f][i];
+  }
+  PackPorts(lv, layout, row_block, entries, entries_hi);
+  return batch;
+}
+
+// pack the entries of a level partitioned by node, as the updater does in the node
+// partitioned mode: the segments of the blocks of node 0, then of node 1...; a segment
+// has the entries of the node in every lane, as many rows as its longest lane among the
+// features the node scans, even for compact entries; segs gets the first row of every
+// segment and the end of the last one
+void PackSegments(const Level& lv, std::vector<EntryPW>* entries, std::vector<EntryPW>* entries_hi,
+                  std::vector<unsigned>* segs) {
+  const unsigned nblk = BlockCount(lv.features);
+  std::vector<unsigned> count(lv.nodes * lv.features, 0);
+  for (unsigned f = 0; f < lv.features; f++)
+    for (const auto& x : lv.columns[f])
+      if (lv.position[x.index] >= 0) count[lv.position[x.index] * lv.features + f]++;
+  segs->assign(lv.nodes * nblk + 1, 0);
+  for (unsigned n = 0; n < lv.nodes; n++)
+    for (unsigned b = 0; b < nblk; b++) {
+      unsigned rows = 0;
+      for (unsigned f = b * kLanes; f < std::min((b + 1) * kLanes, lv.features); f++)
+        if (Allowed(lv, n, f)) rows = std::max(rows, count[n * lv.features + f]);
+      if (lv.compact) rows += rows % 2;
+      (*segs)[n * nblk + b + 1] = (*segs)[n * nblk + b] + rows;
+    }
+  const unsigned rows = segs->back();
+  std::vector<HostEntry> layout(rows * kLanes, HostEntry{0xffffffffu, 0.0f});
+  std::vector<unsigned> row_block(rows);
+  for (unsigned k = 0; k < lv.nodes * nblk; k++)
+    for (unsigned i = (*segs)[k]; i < (*segs)[k + 1]; i++) row_block[i] = k % nblk;
+  for (unsigned f = 0; f < lv.features; f++) {
+    std::vector<unsigned> cursor(lv.nodes, 0);
+    for (const auto& x : lv.columns[f]) {
+      short n = lv.position[x.index];
+      if (n < 0 || !Allowed(lv, n, f)) continue;
+      layout[((*segs)[n * nblk + f / kLanes] + cursor[n]++) * kLanes + f % kLanes] = x;
+    }
+  }
+  PackPorts(lv, layout, row_block, entries, entries_hi);
+}
+
+// cycles of a call: the scan stages overlap, the init, write back and position loops
+// and the seeds of the value ranges do not
+uint64_t ModelCycles(const std::vector<uint32_t>& stats) {
+  return static_cast<uint64_t>(stats[kStatEntryInit]) + stats[kStatNodeInit] + stats[kStatClear] +
+      std::max<uint64_t>(static_cast<uint64_t>(stats[kStatReadWords]) + stats[kStatMaskWords] +
+                         stats[kStatSegmentWords], stats[kStatScanCycles]) + stats[kStatSeedWords] +
+      stats[kStatWriteBack] +
+      stats[kStatPositionCycles];
+}
+
+// the merge of approx bins picked by the updater for a level of nodes x features dense
+// features of nbins bins each, with one record per node and merged bin
+unsigned ApproxLevelMerge(unsigned nodes, unsigned features, unsigned nbins) {
+  return ApproxMerge(nbins, [&](unsigned merge) {
+    return static_cast<uint64_t>(nodes) * features * ApproxMergedBins(nbins, merge);
+  });
+}
+
+// the approx merges of levels that fit with some bins per feature, and of levels
+// that only fit with a single bin per feature, which must fall back to the exact
+// entries (0) instead of leaving the features without thresholds
+int CheckApproxMerge() {
+  struct Case { unsigned nodes, features, nbins, merge; };
+  const unsigned rows = kMaxEntryNum;
+  const Case cases[] = {
+    {1, 8, 256, 1},
+    {4, rows / 4 / 256, 256, 1},
+    {4, rows / 4 / 64, 256, 4},
+    {2, rows / 2 / 2, 256, 128},
+    {2, rows / 2 / 2 + 1, 256, 0},
+    {2, rows / 2 / 2 + 1, 2, 0},
+    {rows / 3000 + 1, 1500, 256, 0},
+    {rows / 1500 + 1, 1500, 256, 0},
+  };
+  int failed = 0;
+  for (const auto& c : cases) {
+    unsigned merge = ApproxLevelMerge(c.nodes, c.features, c.nbins);
+    if (merge != c.merge) {
+      printf("approx merge of %u nodes x %u features of %u bins: %u, expected %u\n", c.nodes, c.features,
+             c.nbins, merge, c.merge);
+      failed++;
+    }
+  }
+  return failed;
+}
+
+// pack a level like the updater, run the kernel and check its splits, level by
+// level for a fused call; the calls of the value ranges are merged like the requests
+// of the updater, and the slowest one gives the stats. A bundled level runs on its
+// column layout, and its splits are checked on the features after decoding
+Result RunLevel(const Level& level, bool verbose) {
+  std::vector<std::vector<unsigned>> cols;
+  const Level lv = level.bundled ? BundleLevel(level, &cols) : level;
+  const unsigned nblk = BlockCount(lv.features);
+  const unsigned node_words = (lv.nodes + 7) / 8;
+  const float s = lv.gscale;
+  std::vector<GSP8> gpairs((lv.rows + 7) / 8, 0);
+  std::vector<NID8> node_idxs((lv.rows + 7) / 8, 0);
+  for (unsigned r = 0; r < (lv.rows + 7) / 8 * 8; r++) {
+    short pos = r < lv.rows ? lv.position[r] : -1;
+    node_idxs[r / 8].range((r % 8) * 16 + 15, (r % 8) * 16) = static_cast<unsigned short>(pos);
+    if (r >= lv.rows) continue;
+    Put32(&gpairs[r / 8], 2 * (r % 8), FloatBits(lv.grad[r] * s));
+    Put32(&gpairs[r / 8], 2 * (r % 8) + 1, FloatBits(lv.hess[r] * s));
+  }
+  std::vector<LaneMask> fvalid(nblk, 0), fdense(nblk, 0), nfmask(nblk * lv.nodes, 0);
+  std::vector<LaneMono> fmono(nblk, 0);
+  for (unsigned f = 0; f < lv.features; f++) {
+    unsigned b = f / kLanes, u = f % kLanes;
+    if (lv.fvalid[f]) fvalid[b].bit(u) = 1;
+    if (lv.fdense[f]) fdense[b].bit(u) = 1;
+    if (lv.fmono[f]) fmono[b].range(2 * u + 1, 2 * u) = lv.fmono[f] > 0 ? kMonoInc : kMonoDec;
+    if (lv.fbundle[f]) fmono[b].range(2 * u + 1, 2 * u) = kMonoBundle;
+    for (unsigned n = 0; n < lv.nodes; n++)
+      if (lv.nfmask[n][f] && lv.fvalid[f]) nfmask[b * lv.nodes + n].bit(u) = 1;
+  }
+  std::vector<GSP8> node_stats(node_words, 0);
+  std::vector<float8> node_root_gain(node_words, 0);
+  std::vector<float16> node_bounds(node_words, 0);
+  for (unsigned n = 0; n < lv.nodes; n++) {
+    Put32(&node_stats[n / 8], 2 * (n % 8), FloatBits(static_cast<float>(lv.sum_grad[n] * s)));
+    Put32(&node_stats[n / 8], 2 * (n % 8) + 1, FloatBits(static_cast<float>(lv.sum_hess[n] * s)));
+    Put32(&node_root_gain[n / 8], n % 8, FloatBits(static_cast<float>(lv.root_gain[n] * s)));
+    Put32(&node_bounds[n / 8], n % 8, FloatBits(lv.wlower[n]));
+    Put32(&node_bounds[n / 8], 8 + n % 8, FloatBits(lv.wupper[n]));
+  }
+  // the levels of a fused call at most double their nodes
+  unsigned levels = std::max(lv.depth, 1u), split_words = 0;
+  for (unsigned d = 0; d < levels; d++) split_words += ((lv.nodes << d) + 1) / 2;
+  std::vector<SplitP2> best_splits(split_words, 0);
+  Result res;
+  res.mismatches = 0;
+  for (unsigned r = 0; r < lv.ranges; r++) {
+    std::vector<EntryPW> entries, entries_hi;
+    std::vector<unsigned> segs(1, 0);
+    unsigned batch = 0;
+    if (lv.partition) PackSegments(lv, &entries, &entries_hi, &segs);
+    else batch = PackEntries(lv, r, &entries, &entries_hi);
+    std::vector<SeedP> seeds = lv.ranges > 1 ? RangeSeeds(lv, r) : std::vector<SeedP>(1, 0);
+    std::vector<SplitP2> range_splits(split_words, 0);
+    StatsP stats = 0;
+    xgboost_exact_0(lv.rows, lv.features, lv.nodes, batch, gpairs.data(), node_idxs.data(),
+                    entries.data(), fvalid.data(), node_stats.data(), node_root_gain.data(),
+                    range_splits.data(), lv.min_child_weight * s, 0.0f, lv.reg_alpha * s, lv.reg_lambda * s,
+                    lv.compact, fdense.data(), entries_hi.data(), node_bounds.data(), fmono.data(),
+                    lv.monotone, lv.node_masks ? nfmask.data() : fvalid.data(), lv.node_masks, &stats, lv.depth,
+                    kRtEps * s, seeds.data(), lv.ranges > 1, segs.data(), lv.partition);
+    std::vector<uint32_t> range_stats;
+    for (unsigned i = 0; i < kStatCount; i++) range_stats.push_back(stats.range(32 * i + 31, 32 * i).to_uint());
+    if (r == 0 || ModelCycles(range_stats) > ModelCycles(res.stats)) res.stats = range_stats;
+    if (r == 0) {
+      best_splits = range_splits;
+      continue;
+    }
+    for (unsigned n = 0; n < lv.nodes; n++) {
+      HostSplit split = ReadSplit(range_splits.data(), n);
+      if (NeedReplace(ReadSplit(best_splits.data(), n), split)) WriteSplit(best_splits.data(), n, split);
+    }
+  }
+  if (level.bundled) DecodeBundles(level, cols, best_splits.data());
+  Level cur = level;
+  unsigned word = 0, depth = 0;
+  for (;;) {
+    if (lv.depth && verbose) printf(" level %u: %u nodes\n", depth, cur.nodes);
+    res.mismatches += CheckSplits(cur, &best_splits[word], verbose);
+    unsigned level_words = (cur.nodes + 1) / 2;
+    if (++depth == levels || !ApplySplits(&cur, &best_splits[word])) break;
+    word += level_words;
+  }
+  if (depth != res.stats[kStatLevels]) {
+    printf("  %u levels, kernel %u MISMATCH levels\n", depth, res.stats[kStatLevels]);
+    res.mismatches++;
+  }
+  return res;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  unsigned trials = argc > 1 ? static_cast<unsigned>(atoi(argv[1])) : 100;
+  unsigned seed = argc > 2 ? static_cast<unsigned>(atoi(argv[2])) : 1;
+  bool verbose = getenv("XGBOOST_EXACT_TB_VERBOSE") != nullptr;
+  printf("kernel: %u lanes, %u entry ports, %s accumulators (tag 0x%08x)\n", kLanes, kEntryPorts,
+         kFloatAccum ? "float" : "fixed point", kPrecisionTag);
+  std::mt19937 rng(seed);
+  unsigned failed = 0;
+  uint64_t cycles = 0, slots = 0, idle = 0;
+  for (unsigned t = 0; t < trials; t++) {
+    Level lv = RandomLevel(&rng);
+    printf("trial %u: %u rows, %u features, %u nodes%s%s%s%s%s%s%s, %u value ranges, alpha %.3f, scale 2^%d\n", t,
+           lv.rows, lv.features, lv.nodes, lv.depth ? ", fused" : "", lv.single_pass ? ", single pass" : "",
+           lv.compact ? ", compact" : "", lv.monotone ? ", monotone" : "", lv.node_masks ? ", node masks" : "",
+           lv.partition ? ", partitioned" : "", lv.bundled ? ", bundled" : "", lv.ranges, lv.reg_alpha, static_cast<int>(std::log2(lv.gscale)));
+    Result res = RunLevel(lv, verbose);
+    const auto& st = res.stats;
+    uint64_t level_cycles = ModelCycles(st);
+    uint64_t level_slots = static_cast<uint64_t>(st[kStatScanCycles]) * kLanes;
+    cycles += level_cycles;
+    slots += level_slots;
+    idle += static_cast<uint64_t>(st[kStatEntriesPadding]) + st[kStatEntriesInactive] + st[kStatEntriesMasked];
+    printf("  %s: %llu model cycles, %u/%u blocks, %u entry words, %u scan iterations, "
+           "lane slots %u padding %u inactive %u masked\n",
+           res.mismatches ? "FAILED" : "passed", static_cast<unsigned long long>(level_cycles),
+           st[kStatBlocks], st[kStatBlocks] + st[kStatBlocksSkipped], st[kStatReadWords],
+           st[kStatScanCycles], st[kStatEntriesPadding], st[kStatEntriesInactive], st[kStatEntriesMasked]);
+    if (res.mismatches) failed++;
+  }
+  printf("%u/%u trials passed, %llu model cycles, %.1f%% of the lane slots idle\n", trials - failed, trials,
+         static_cast<unsigned long long>(cycles), slots ? 100.0 * idle / slots : 0.0);
+  int approx_failed = CheckApproxMerge();
+  printf("approx merges %s\n", approx_failed ? "FAILED" : "passed");
+  return (failed || approx_failed) ? 1 : 0;
+}
@@ -0,0 +1,501 @@
+// C simulation testbench of the histogram kernel: random levels of quantized rows are
+// packed the way the grow_fpga_hist updater packs them and run through xgboost_hist_0,
+// then the children of their nodes are run again with the histograms of the larger ones
+// derived from the kept parent histograms. The best splits of both calls are checked
+// against an enumeration of the same bin candidates on the cpu.
+//
+//   xgboost_hist_tb [trials] [seed]
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "xgboost_hist.h"
+
+  typedef ap_fixed<XGBOOST_HIST_ACCUM_WIDTH, XGBOOST_HIST_ACCUM_INT>   fixed;
+  typedef ap_uint<XGBOOST_HIST_LANES>                                   LaneMask;
+  typedef ap_uint<2*XGBOOST_HIST_LANES>                                 LaneMono;
+  typedef ap_uint<128*XGBOOST_HIST_LANES>                               HistW;
+
+extern "C" void xgboost_hist_0(unsigned row_num, unsigned feature_num, unsigned node_num, unsigned bin_num,
+    GSP8 *gpairs, NID8 *node_idxs, BinW *bins, LaneMask *fvalid, GSP8 *node_stats, float8 *node_root_gain,
+    SplitP2 *best_splits, float param_min_child_weight, float param_max_delta_step, float param_reg_alpha,
+    float param_reg_lambda, float16 *node_bounds, LaneMono *fmono, unsigned monotone, LaneMask *nfmask,
+    unsigned node_masks, HSRC8 *node_hist_src, unsigned parent_num, HistW *hist_in, HistW *hist_out,
+    unsigned keep_hist, StatsP *stats);
+
+namespace {
+
+using namespace xgboost_hist;
+
+const uint32_t kNoThreshold = 0xffff;
+
+// split record of the kernel, as read back by the updater
+struct HostSplit {
+  float loss_chg;
+  uint32_t sindex;
+  uint32_t threshold;
+  float left_sum_grad;
+  float left_sum_hess;
+  uint32_t tag;
+  uint32_t pad[2];
+};
+
+// the rows of a tree and the quantized values of its features; a level is the nodes
+// of a call, with the rows it streams and the source of every histogram
+struct Data {
+  unsigned rows, features, bin_num;
+  bool monotone, node_masks;
+  float min_child_weight, reg_alpha, reg_lambda, gscale;
+  std::vector<float> grad, hess;
+  // bin of every row and feature, kMissingBin for a missing value
+  std::vector<std::vector<uint32_t>> bins;
+  std::vector<unsigned> fbins;
+  std::vector<bool> fvalid;
+  std::vector<int> fmono;
+};
+
+struct Level {
+  unsigned nodes;
+  std::vector<short> position;
+  // rows streamed by the kernel, in their order in the device layout
+  std::vector<unsigned> layout;
+  std::vector<uint32_t> hist_src;
+  std::vector<std::vector<bool>> nfmask;
+  std::vector<double> sum_grad, sum_hess, root_gain;
+  std::vector<float> wlower, wupper;
+};
+
+double ThresholdL1(double g, double alpha) {
+  if (g > alpha) return g - alpha;
+  if (g < -alpha) return g + alpha;
+  return 0.0;
+}
+
+double Gain(const Data& d, double g, double h) {
+  double t = ThresholdL1(g, d.reg_alpha);
+  return t * t / (h + d.reg_lambda);
+}
+
+double Weight(const Data& d, const Level& lv, unsigned n, double g, double h) {
+  double w = -ThresholdL1(g, d.reg_alpha) / (h + d.reg_lambda);
+  return std::min(std::max(w, static_cast<double>(lv.wlower[n])), static_cast<double>(lv.wupper[n]));
+}
+
+double Score(const Data& d, double g, double h, double w) {
+  return -(w * (2.0 * g + (h + d.reg_lambda) * w) + 2.0 * d.reg_alpha * std::fabs(w));
+}
+
+// loss change of a split of node n on feature fid, false if it is not allowed
+bool SplitGain(const Data& d, const Level& lv, unsigned n, unsigned fid, double lg, double lh,
+               double* loss_chg) {
+  double rg = lv.sum_grad[n] - lg, rh = lv.sum_hess[n] - lh;
+  if (lh < d.min_child_weight || rh < d.min_child_weight) return false;
+  if (!d.monotone) {
+    *loss_chg = Gain(d, lg, lh) + Gain(d, rg, rh) - lv.root_gain[n];
+    return true;
+  }
+  double wl = Weight(d, lv, n, lg, lh), wr = Weight(d, lv, n, rg, rh);
+  if ((d.fmono[fid] > 0 && wl > wr) || (d.fmono[fid] < 0 && wl < wr)) return false;
+  *loss_chg = Score(d, lg, lh, wl) + Score(d, rg, rh, wr) - lv.root_gain[n];
+  return true;
+}
+
+bool Allowed(const Data& d, const Level& lv, unsigned n, unsigned fid) {
+  return d.fvalid[fid] && (!d.node_masks || lv.nfmask[n][fid]);
+}
+
+// histogram of feature f of node n: the sums of its rows of every bin
+void NodeHist(const Data& d, const Level& lv, unsigned n, unsigned f, std::vector<double>* hg,
+              std::vector<double>* hh) {
+  hg->assign(d.bin_num, 0.0);
+  hh->assign(d.bin_num, 0.0);
+  for (unsigned r = 0; r < d.rows; r++) {
+    if (lv.position[r] != static_cast<short>(n) || d.bins[f][r] == kMissingBin) continue;
+    (*hg)[d.bins[f][r]] += d.grad[r];
+    (*hh)[d.bins[f][r]] += d.hess[r];
+  }
+}
+
+// best loss change of node n over the candidates of the kernel: after every bin with
+// the missing values right, and before every bin with the missing values left
+double BestSplit(const Data& d, const Level& lv, unsigned n) {
+  double best = 0.0;
+  std::vector<double> hg, hh;
+  for (unsigned f = 0; f < d.features; f++) {
+    if (!Allowed(d, lv, n, f)) continue;
+    NodeHist(d, lv, n, f, &hg, &hh);
+    double pg = 0.0, ph = 0.0;
+    for (unsigned b = 0; b < d.bin_num; b++) {
+      pg += hg[b];
+      ph += hh[b];
+    }
+    auto update = [&](double lg, double lh) {
+      double loss_chg;
+      if (SplitGain(d, lv, n, f, lg, lh, &loss_chg) && loss_chg > best) best = loss_chg;
+    };
+    double cg = 0.0, ch = 0.0;
+    for (unsigned b = 0; b < d.bin_num; b++) {
+      if (ph - ch > 0.0) update(lv.sum_grad[n] - (pg - cg), lv.sum_hess[n] - (ph - ch));
+      cg += hg[b];
+      ch += hh[b];
+      if (ch > 0.0) update(cg, ch);
+    }
+  }
+  return best;
+}
+
+// left sums of a split of node n, as the updater applies its threshold
+void LeftSums(const Data& d, const Level& lv, unsigned n, unsigned fid, uint32_t threshold,
+              bool default_left, double* lg, double* lh) {
+  *lg = 0.0;
+  *lh = 0.0;
+  for (unsigned r = 0; r < d.rows; r++) {
+    if (lv.position[r] != static_cast<short>(n)) continue;
+    uint32_t bin = d.bins[fid][r];
+    bool left = bin == kMissingBin ? default_left : (threshold != kNoThreshold && bin <= threshold);
+    if (left) {
+      *lg += d.grad[r];
+      *lh += d.hess[r];
+    }
+  }
+}
+
+// the power of two gradient scale of HistGradientScale in the updater
+float GradScale(const Data& d) {
+  double sum_grad = 0.0, sum_hess = 0.0, sum_gain = 0.0;
+  for (unsigned r = 0; r < d.rows; r++) {
+    sum_grad += std::fabs(d.grad[r]);
+    sum_hess += d.hess[r];
+    sum_gain += d.grad[r] * d.grad[r] / (d.hess[r] + d.reg_lambda);
+  }
+  double bound = std::max(std::max(sum_grad, sum_hess), sum_gain);
+  if (!(bound > 0.0)) return 1.0f;
+  int exp = static_cast<int>(std::floor(std::log2(std::ldexp(1.0, kAccumInt - 2) / bound)));
+  exp = std::min(std::max(exp, -30), 30);
+  return std::ldexp(1.0f, exp);
+}
+
+// sums and root gains of the nodes from the positions of the rows
+void NodeSums(const Data& d, Level* lv) {
+  lv->sum_grad.assign(lv->nodes, 0.0);
+  lv->sum_hess.assign(lv->nodes, 0.0);
+  for (unsigned r = 0; r < d.rows; r++)
+    if (lv->position[r] >= 0) {
+      lv->sum_grad[lv->position[r]] += d.grad[r];
+      lv->sum_hess[lv->position[r]] += d.hess[r];
+    }
+  lv->root_gain.resize(lv->nodes);
+  for (unsigned n = 0; n < lv->nodes; n++) lv->root_gain[n] = Gain(d, lv->sum_grad[n], lv->sum_hess[n]);
+}
+
+template <typename R>
+void RandomMasks(const Data& d, Level* lv, R coin) {
+  lv->nfmask.assign(lv->nodes, std::vector<bool>(d.features, true));
+  if (d.node_masks)
+    for (unsigned n = 0; n < lv->nodes; n++)
+      for (unsigned f = 0; f < d.features; f++) lv->nfmask[n][f] = d.fvalid[f] && coin(0.7);
+}
+
+void RandomData(std::mt19937* rng, Data* d, Level* lv) {
+  auto uniform = [&](unsigned lo, unsigned hi) {
+    return std::uniform_int_distribution<unsigned>(lo, hi)(*rng);
+  };
+  auto coin = [&](double p) { return std::bernoulli_distribution(p)(*rng); };
+  auto real = [&](double lo, double hi) { return std::uniform_real_distribution<double>(lo, hi)(*rng); };
+  d->rows = uniform(1, 3000);
+  d->features = uniform(1, 6 * kLanes + 1);
+  d->bin_num = coin(0.3) ? uniform(1, 8) : uniform(1, kMaxBin);
+  d->monotone = coin(0.3);
+  d->node_masks = coin(0.3);
+  d->min_child_weight = coin(0.5) ? 1.0f : static_cast<float>(real(0.0, 4.0));
+  d->reg_alpha = coin(0.7) ? 0.0f : static_cast<float>(real(0.0, 1.0));
+  d->reg_lambda = static_cast<float>(real(0.5, 2.0));
+  d->grad.resize(d->rows);
+  d->hess.resize(d->rows);
+  for (unsigned r = 0; r < d->rows; r++) {
+    d->grad[r] = static_cast<float>(real(-1.0, 1.0));
+    d->hess[r] = static_cast<float>(real(0.01, 1.0));
+  }
+  // dense and sparse features, with all the bins or a few of them
+  d->bins.resize(d->features);
+  d->fbins.resize(d->features);
+  for (unsigned f = 0; f < d->features; f++) {
+    double density = coin(0.4) ? 1.0 : real(0.05, 0.95);
+    d->fbins[f] = coin(0.5) ? d->bin_num : uniform(1, d->bin_num);
+    d->bins[f].resize(d->rows);
+    for (unsigned r = 0; r < d->rows; r++)
+      d->bins[f][r] = coin(density) ? uniform(0, d->fbins[f] - 1) : kMissingBin;
+  }
+  d->fvalid.resize(d->features);
+  for (unsigned f = 0; f < d->features; f++) d->fvalid[f] = coin(0.8);
+  d->fmono.assign(d->features, 0);
+  if (d->monotone)
+    for (unsigned f = 0; f < d->features; f++) d->fmono[f] = static_cast<int>(uniform(0, 2)) - 1;
+  lv->nodes = uniform(1, 24);
+  lv->position.resize(d->rows);
+  for (unsigned r = 0; r < d->rows; r++)
+    // rows of finished nodes or out of the subsample
+    lv->position[r] = coin(0.15) ? -1 : static_cast<short>(uniform(0, lv->nodes - 1));
+  for (unsigned r = 0; r < d->rows; r++) lv->layout.push_back(r);
+  lv->hist_src.assign(lv->nodes, kHistFromRows);
+  RandomMasks(*d, lv, coin);
+  const float wlimit = std::ldexp(1.0f, kAccumInt - 2);
+  lv->wlower.assign(lv->nodes, -wlimit);
+  lv->wupper.assign(lv->nodes, wlimit);
+  if (d->monotone)
+    for (unsigned n = 0; n < lv->nodes; n++)
+      if (coin(0.5)) {
+        lv->wlower[n] = static_cast<float>(real(-1.0, 0.0));
+        lv->wupper[n] = static_cast<float>(real(0.0, 1.0));
+      }
+  NodeSums(*d, lv);
+  d->gscale = GradScale(*d);
+}
+
+// the children of the nodes of a level, 2n and 2n+1 for node n, with the histogram of
+// one of them derived from its parent and sibling; the layout keeps the rows of the
+// other ones, or all the rows with the derived ones inactive
+Level ChildLevel(std::mt19937* rng, const Data& d, const Level& parent) {
+  auto coin = [&](double p) { return std::bernoulli_distribution(p)(*rng); };
+  Level lv;
+  lv.nodes = 2 * parent.nodes;
+  lv.position.resize(d.rows);
+  for (unsigned r = 0; r < d.rows; r++)
+    lv.position[r] = parent.position[r] < 0 ? -1 : static_cast<short>(2 * parent.position[r] + coin(0.5));
+  NodeSums(d, &lv);
+  lv.hist_src.assign(lv.nodes, kHistFromRows);
+  for (unsigned n = 0; n < parent.nodes; n++) {
+    if (!coin(0.7)) continue;
+    // the larger child is derived
+    unsigned derived = lv.sum_hess[2 * n] > lv.sum_hess[2 * n + 1] ? 2 * n : 2 * n + 1;
+    lv.hist_src[derived] = (n << 16) | (derived ^ 1);
+  }
+  bool compact = coin(0.5);
+  for (unsigned r = 0; r < d.rows; r++) {
+    if (compact && (lv.position[r] < 0 || lv.hist_src[lv.position[r]] != kHistFromRows)) continue;
+    lv.layout.push_back(r);
+  }
+  RandomMasks(d, &lv, coin);
+  lv.wlower.assign(lv.nodes, parent.wlower[0]);
+  lv.wupper.assign(lv.nodes, parent.wupper[0]);
+  for (unsigned n = 0; n < lv.nodes; n++) {
+    lv.wlower[n] = parent.wlower[n / 2];
+    lv.wupper[n] = parent.wupper[n / 2];
+  }
+  return lv;
+}
+
+uint32_t FloatBits(float v) {
+  uint32_t bits;
+  std::memcpy(&bits, &v, sizeof(bits));
+  return bits;
+}
+
+template <typename W>
+void Put32(W* word, unsigned slot, uint32_t bits) {
+  word->range(slot * 32 + 31, slot * 32) = bits;
+}
+
+HostSplit ReadSplit(const std::vector<SplitP2>& best_splits, unsigned n) {
+  uint32_t words[8];
+  for (unsigned j = 0; j < 8; j++)
+    words[j] = best_splits[n / 2].range((n % 2) * 256 + j * 32 + 31, (n % 2) * 256 + j * 32).to_uint();
+  HostSplit split;
+  std::memcpy(&split, words, sizeof(split));
+  return split;
+}
+
+// check the splits of the nodes of a level, returns the mismatches
+int CheckSplits(const Data& d, const Level& lv, const std::vector<SplitP2>& best_splits, bool verbose) {
+  const float s = d.gscale;
+  int mismatches = 0;
+  for (unsigned n = 0; n < lv.nodes; n++) {
+    HostSplit split = ReadSplit(best_splits, n);
+    double best = BestSplit(d, lv, n);
+    double loss_chg = split.loss_chg / s;
+    // fixed point sums round every gradient, the gains follow their magnitude
+    double tol = 1e-3 * std::max(1.0, std::fabs(best)) +
+        std::ldexp(4.0 * d.rows, kAccumInt - XGBOOST_HIST_ACCUM_WIDTH) / s;
+    const char* error = nullptr;
+    uint32_t fid = split.sindex & 0x7fffffff;
+    bool default_left = (split.sindex >> 31) != 0;
+    double lg = 0.0, lh = 0.0, eval = 0.0;
+    if (split.tag != kPrecisionTag) {
+      error = "precision tag";
+    } else if (std::fabs(loss_chg - best) > tol) {
+      error = "loss change";
+    } else if (best > tol) {
+      // the split found must be one of the best ones
+      if (fid >= d.features || !Allowed(d, lv, n, fid)) {
+        error = "feature";
+      } else if (split.threshold != kNoThreshold && split.threshold >= d.bin_num) {
+        error = "threshold";
+      } else {
+        LeftSums(d, lv, n, fid, split.threshold, default_left, &lg, &lh);
+        if (!SplitGain(d, lv, n, fid, lg, lh, &eval) || std::fabs(eval - loss_chg) > tol)
+          error = "split";
+        else if (std::fabs(lg - split.left_sum_grad / s) > tol || std::fabs(lh - split.left_sum_hess / s) > tol)
+          error = "left sums";
+      }
+    }
+    if (error) mismatches++;
+    if (error || verbose)
+      printf("  node %u%s: ref %.5f | kernel %.5f f%u%s bin %d left %.4f/%.4f (applied %.5f, %.4f/%.4f)%s%s\n",
+             n, lv.hist_src[n] != kHistFromRows ? " (derived)" : "", best, loss_chg, fid,
+             default_left ? "L" : "R", split.threshold == kNoThreshold ? -1 : static_cast<int>(split.threshold),
+             split.left_sum_grad / s, split.left_sum_hess / s, eval, lg, lh, error ? " MISMATCH " : "",
+             error ? error : "");
+  }
+  return mismatches;
+}
+
+// check the kept histograms against the ones of the rows of every node
+int CheckHist(const Data& d, const Level& lv, const std::vector<HistW>& hist) {
+  const float s = d.gscale;
+  const double tol = std::ldexp(2.0 * d.rows, kAccumInt - XGBOOST_HIST_ACCUM_WIDTH) / s + 1e-4;
+  int mismatches = 0;
+  std::vector<double> hg, hh;
+  for (unsigned f = 0; f < d.features; f++)
+    for (unsigned n = 0; n < lv.nodes; n++) {
+      NodeHist(d, lv, n, f, &hg, &hh);
+      for (unsigned b = 0; b < d.bin_num; b++) {
+        GradStatsFixed<fixed> h =
+            hist_Lane<kLanes, fixed>(hist[((f / kLanes) * lv.nodes + n) * d.bin_num + b], f % kLanes);
+        if (std::fabs(h.sum_grad.to_double() / s - hg[b]) > tol ||
+            std::fabs(h.sum_hess.to_double() / s - hh[b]) > tol) {
+          if (mismatches == 0)
+            printf("  f%u node %u bin %u: %.5f/%.5f, kernel %.5f/%.5f MISMATCH histogram\n", f, n, b, hg[b],
+                   hh[b], h.sum_grad.to_double() / s, h.sum_hess.to_double() / s);
+          mismatches++;
+        }
+      }
+    }
+  return mismatches ? 1 : 0;
+}
+
+struct Result {
+  int mismatches;
+  std::vector<uint32_t> stats;
+};
+
+// pack a level like the updater, run the kernel and check its splits
+Result RunLevel(const Data& d, const Level& lv, unsigned parent_num, std::vector<HistW>* hist_in,
+                std::vector<HistW>* hist_out, bool keep, bool verbose) {
+  const unsigned nblk = BlockCount(d.features);
+  const unsigned node_words = (lv.nodes + 7) / 8;
+  const unsigned rows = static_cast<unsigned>(lv.layout.size());
+  const unsigned rows_pa = (rows + kRowAlign - 1) / kRowAlign * kRowAlign;
+  const unsigned row_words = rows_pa / kRowsPerWord;
+  const float s = d.gscale;
+  std::vector<GSP8> gpairs(rows_pa / 8, 0);
+  std::vector<NID8> node_idxs(rows_pa / 8, 0);
+  std::vector<BinW> bins(std::max(nblk * row_words, 1u), 0);
+  for (unsigned i = 0; i < rows_pa; i++) {
+    short pos = -1;
+    if (i < rows) {
+      unsigned r = lv.layout[i];
+      // the rows of derived nodes are not streamed
+      if (lv.position[r] >= 0 && lv.hist_src[lv.position[r]] == kHistFromRows) pos = lv.position[r];
+      Put32(&gpairs[i / 8], 2 * (i % 8), FloatBits(d.grad[r] * s));
+      Put32(&gpairs[i / 8], 2 * (i % 8) + 1, FloatBits(d.hess[r] * s));
+    }
+    node_idxs[i / 8].range((i % 8) * 16 + 15, (i % 8) * 16) = static_cast<unsigned short>(pos);
+    for (unsigned b = 0; b < nblk; b++)
+      for (unsigned u = 0; u < kLanes; u++) {
+        unsigned f = b * kLanes + u;
+        uint32_t bin = (i < rows && f < d.features) ? d.bins[f][lv.layout[i]] : kMissingBin;
+        unsigned slot = (i % kRowsPerWord) * kLanes + u;
+        bins[b * row_words + i / kRowsPerWord].range((slot + 1) * kBinBits - 1, slot * kBinBits) = bin;
+      }
+  }
+  std::vector<LaneMask> fvalid(nblk, 0), nfmask(nblk * lv.nodes, 0);
+  std::vector<LaneMono> fmono(nblk, 0);
+  for (unsigned f = 0; f < d.features; f++) {
+    unsigned b = f / kLanes, u = f % kLanes;
+    if (d.fvalid[f]) fvalid[b].bit(u) = 1;
+    if (d.fmono[f]) fmono[b].range(2 * u + 1, 2 * u) = d.fmono[f] > 0 ? xgboost_exact::kMonoInc
+                                                                      : xgboost_exact::kMonoDec;
+    for (unsigned n = 0; n < lv.nodes; n++)
+      if (lv.nfmask[n][f] && d.fvalid[f]) nfmask[b * lv.nodes + n].bit(u) = 1;
+  }
+  std::vector<GSP8> node_stats(node_words, 0);
+  std::vector<float8> node_root_gain(node_words, 0);
+  std::vector<float16> node_bounds(node_words, 0);
+  std::vector<HSRC8> node_hist_src(node_words, 0);
+  for (unsigned n = 0; n < lv.nodes; n++) {
+    Put32(&node_stats[n / 8], 2 * (n % 8), FloatBits(static_cast<float>(lv.sum_grad[n] * s)));
+    Put32(&node_stats[n / 8], 2 * (n % 8) + 1, FloatBits(static_cast<float>(lv.sum_hess[n] * s)));
+    Put32(&node_root_gain[n / 8], n % 8, FloatBits(static_cast<float>(lv.root_gain[n] * s)));
+    Put32(&node_bounds[n / 8], n % 8, FloatBits(lv.wlower[n]));
+    Put32(&node_bounds[n / 8], 8 + n % 8, FloatBits(lv.wupper[n]));
+    Put32(&node_hist_src[n / 8], n % 8, lv.hist_src[n]);
+  }
+  hist_out->assign(std::max(nblk * lv.nodes * d.bin_num, 1u), 0);
+  if (hist_in->empty()) hist_in->assign(1, 0);
+  std::vector<SplitP2> best_splits((lv.nodes + 1) / 2, 0);
+  StatsP stats = 0;
+  xgboost_hist_0(rows, d.features, lv.nodes, d.bin_num, gpairs.data(), node_idxs.data(), bins.data(),
+                 fvalid.data(), node_stats.data(), node_root_gain.data(), best_splits.data(),
+                 d.min_child_weight * s, 0.0f, d.reg_alpha * s, d.reg_lambda * s, node_bounds.data(),
+                 fmono.data(), d.monotone, d.node_masks ? nfmask.data() : fvalid.data(), d.node_masks,
+                 node_hist_src.data(), parent_num, hist_in->data(), hist_out->data(), keep, &stats);
+  Result res;
+  for (unsigned i = 0; i < kStatCount; i++) res.stats.push_back(stats.range(32 * i + 31, 32 * i).to_uint());
+  res.mismatches = CheckSplits(d, lv, best_splits, verbose);
+  if (keep) res.mismatches += CheckHist(d, lv, *hist_out);
+  return res;
+}
+
+// cycles of a call: the clear, row, histogram and scan loops of every block in sequence
+uint64_t ModelCycles(const std::vector<uint32_t>& stats) {
+  return static_cast<uint64_t>(stats[kStatNodeInit]) + stats[kStatClear] + stats[kStatRowCycles] +
+      stats[kStatHistWrites] + stats[kStatScanCycles] + stats[kStatWriteBack];
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  unsigned trials = argc > 1 ? static_cast<unsigned>(atoi(argv[1])) : 100;
+  unsigned seed = argc > 2 ? static_cast<unsigned>(atoi(argv[2])) : 1;
+  bool verbose = getenv("XGBOOST_HIST_TB_VERBOSE") != nullptr;
+  printf("kernel: %u lanes, %u-bit bins, %u bins, %u nodes (tag 0x%08x)\n", kLanes, kBinBits, kMaxBin,
+         kMaxNodeNum, kPrecisionTag);
+  std::mt19937 rng(seed);
+  unsigned failed = 0;
+  uint64_t cycles = 0, rows = 0, derived = 0;
+  for (unsigned t = 0; t < trials; t++) {
+    Data d;
+    Level parent;
+    RandomData(&rng, &d, &parent);
+    Level child = ChildLevel(&rng, d, parent);
+    bool keep_child = std::bernoulli_distribution(0.5)(rng);
+    printf("trial %u: %u rows, %u features, %u bins, %u+%u nodes%s%s, alpha %.3f, scale 2^%d\n", t, d.rows,
+           d.features, d.bin_num, parent.nodes, child.nodes, d.monotone ? ", monotone" : "",
+           d.node_masks ? ", node masks" : "", d.reg_alpha, static_cast<int>(std::log2(d.gscale)));
+    std::vector<HistW> hist_none, hist_parent, hist_child;
+    Result res = RunLevel(d, parent, 0, &hist_none, &hist_parent, true, verbose);
+    Result res_child = RunLevel(d, child, parent.nodes, &hist_parent, &hist_child, keep_child, verbose);
+    int mismatches = res.mismatches + res_child.mismatches;
+    for (const Result* r : {&res, &res_child}) {
+      const auto& st = r->stats;
+      cycles += ModelCycles(st);
+      rows += st[kStatRowCycles];
+      derived += st[kStatNodesSubtracted];
+      printf("  %s: %llu model cycles, %u/%u blocks, %u row cycles (%u inactive, %u missing slots), "
+             "%u derived, %u scan iterations\n",
+             r->mismatches ? "FAILED" : "passed", static_cast<unsigned long long>(ModelCycles(st)),
+             st[kStatBlocks], st[kStatBlocks] + st[kStatBlocksSkipped], st[kStatRowCycles],
+             st[kStatRowsInactive], st[kStatBinsMissing], st[kStatNodesSubtracted], st[kStatScanCycles]);
+    }
+    if (mismatches) failed++;
+  }
+  printf("%u/%u trials passed, %llu model cycles, %llu row cycles, %llu derived histograms\n", trials - failed,
+         trials, static_cast<unsigned long long>(cycles), static_cast<unsigned long long>(rows),
+         static_cast<unsigned long long>(derived));
+  return failed ? 1 : 0;
+}
@@ -8,6 +8,10 @@ if [ "$1" = "patch-coral" ]; then
 	# copy actual updater to src/
 	mkdir xgboost/src/inaccel
 	cp src/inaccel/updater_fpga_coral.cc xgboost/src/inaccel
+	cp src/inaccel/updater_fpga_hist_coral.cc xgboost/src/inaccel
+	# kernel configuration shared with the updater
+	cp ../kernel/src/xgboost_exact_config.h xgboost/src/inaccel
+	cp ../kernel/src/xgboost_hist_config.h xgboost/src/inaccel
 	cd xgboost && make clean
 elif [ "$1" = "reverse-coral" ]; then
 	patch -Rs xgboost/src/gbm/gbtree.cc src/patch/gbtree.cc.patch
@@ -30,6 +34,9 @@ elif [ "$1" = "patch-standalone" ]; then
 	# copy actual updater to src/
 	mkdir xgboost/src/inaccel
 	cp src/inaccel/updater_fpga.cc xgboost/src/inaccel
+	cp src/inaccel/updater_fpga_hist.cc xgboost/src/inaccel
+	cp ../kernel/src/xgboost_exact_config.h xgboost/src/inaccel
+	cp ../kernel/src/xgboost_hist_config.h xgboost/src/inaccel
 	cp src/inaccel/runtime-api.h xgboost/src/inaccel
 	cp src/inaccel/runtime-api.cc xgboost/src/inaccel
 	cp src/inaccel/runtime.h xgboost/src/inaccel
@@ -19,51 +19,686 @@ limitations under the License.
 #include <memory>
 #include <vector>
 #include <cmath>
+#include <cstring>
 #include <algorithm>
+#include <limits>
+#include <sstream>
+#include <string>
 
 #include "../common/random.h"
 #include "../common/bitmap.h"
 #include "../common/timer.h"
 #include "../tree/split_evaluator.h"
+#include "../tree/constraints.h"
 #include "../tree/param.h"
 
+#include "xgboost_exact_config.h"
 #include "runtime-api.h"
 
 namespace xgboost {
 namespace inaccel {
 
 using xgboost::tree::GradStats;
+using xgboost_exact::kLanes;
+using xgboost_exact::kEntryPorts;
+using xgboost_exact::kPortLanes;
+using xgboost_exact::BlockCount;
+using xgboost::FeatureInteractionConstraintHost;
 using xgboost::tree::SplitEvaluator;
 using xgboost::tree::TrainParam;
 
 DMLC_REGISTRY_FILE_TAG(updater_fpga);
 
+// entries of the initial layout of a request built on the host at a time, 256 MiB
+constexpr size_t kLayoutGroupEntries = size_t(1) << 25;
+
+// training parameters specific to the fpga updater
+struct FpgaTrainParam : public dmlc::Parameter<FpgaTrainParam> {
+	// interval (in levels) of the exact re-summation of the node statistics
+	int fpga_resum_interval;
+	// fraction of active rows below which the device layout is compacted
+	float fpga_compact_threshold;
+	// whether the device layout uses the 32-bit compact entries
+	bool fpga_compact_entries;
+	// whether the kernel scans the dense feature blocks once
+	bool fpga_single_pass;
+	// whether the gradients are scaled per tree to the range of the fixed point kernel
+	bool fpga_grad_scale;
+	// whether the kernel grows the whole tree in one call
+	bool fpga_fused_tree;
+	// nodes expanded together by the loss guided growth
+	int fpga_lossguide_batch;
+	// whether the kernels split the sorted entries of every feature into value ranges
+	bool fpga_value_ranges;
+	// whether the entries are laid out by work node at every level
+	bool fpga_node_partition;
+	// fraction of the rows with the largest gradients kept by the goss sampling
+	float fpga_goss_top_rate;
+	// fraction of the rows sampled at random from the rest by the goss sampling
+	float fpga_goss_other_rate;
+	// whether the single valued features are bundled into shared layout columns
+	bool fpga_feature_bundling;
+	// whether the kernel scans per tree quantile bins of the features instead of their entries
+	bool fpga_approx;
+	// device memory of an entry port of a request above which its layout stays on the host, in MiB
+	int fpga_layout_budget;
+	// whether the sorted columns are built by a radix sort of the rows instead of the column pages
+	bool fpga_radix_sort;
+	DMLC_DECLARE_PARAMETER(FpgaTrainParam) {
+		DMLC_DECLARE_FIELD(fpga_resum_interval)
+				.set_lower_bound(0)
+				.set_default(0)
+				.describe("Recompute the statistics of the new nodes with a pass over all rows "
+						  "every this many levels, instead of deriving them from the split results "
+						  "of the accelerator. 0 means never.");
+		DMLC_DECLARE_FIELD(fpga_compact_threshold)
+				.set_range(0.0f, 1.0f)
+				.set_default(0.0f)
+				.describe("Rebuild the device layout with the entries of the active rows only, "
+						  "when the active rows drop below this fraction of the rows of the current "
+						  "layout. 0 disables the compaction.");
+		DMLC_DECLARE_FIELD(fpga_compact_entries)
+				.set_default(false)
+				.describe("Store each device entry in 32 bits, as a 16-bit row index and the "
+						  "16-bit rank of its value among the distinct values of the feature. "
+						  "Requires less than 65536 rows.");
+		DMLC_DECLARE_FIELD(fpga_single_pass)
+				.set_default(false)
+				.describe("Evaluate the blocks of features without missing values with a single "
+						  "scan of their entries, instead of a forward and a backward scan. Their "
+						  "splits get the default left direction, as in the exact cpu updater.");
+		DMLC_DECLARE_FIELD(fpga_grad_scale)
+				.set_default(true)
+				.describe("Scale the gradients of each tree by a power of two that fits their "
+						  "sums and gains to the integer bits of the fixed point accumulators of "
+						  "the kernel. Has no effect on a float kernel.");
+		DMLC_DECLARE_FIELD(fpga_fused_tree)
+				.set_default(false)
+				.describe("Grow all the levels of a tree with a single call of one kernel, that "
+						  "keeps the positions of the rows on the chip. Falls back to a call per "
+						  "level with monotone constraints, colsample_bylevel, colsample_bynode, "
+						  "interaction constraints, fpga_resum_interval, distributed training or "
+						  "trees that exceed the node and feature capacity of the kernel.");
+		DMLC_DECLARE_FIELD(fpga_lossguide_batch)
+				.set_lower_bound(0)
+				.set_default(0)
+				.describe("With grow_policy=lossguide, the number of best nodes expanded together "
+						  "before their children are evaluated in one kernel call. 0 fills the node "
+						  "capacity of the kernel, 1 follows the exact loss guided order.");
+		DMLC_DECLARE_FIELD(fpga_value_ranges)
+				.set_default(false)
+				.describe("Give every kernel all the features and a contiguous range of the sorted "
+						  "entries of each, with the sums of the entries before the range, instead "
+						  "of a part of the features. Balances the kernels on datasets with few "
+						  "features. Disables fpga_fused_tree.");
+		DMLC_DECLARE_FIELD(fpga_node_partition)
+				.set_default(false)
+				.describe("Lay the sorted entries of every feature out by work node at each level, "
+						  "so that the kernel scans the entries of one node at a time with its sums "
+						  "in registers. Lifts the node capacity of the kernel to 32767 work nodes. "
+						  "Disables fpga_fused_tree and fpga_compact_threshold, has no effect with "
+						  "fpga_value_ranges.");
+		DMLC_DECLARE_FIELD(fpga_goss_top_rate)
+				.set_range(0.0f, 1.0f)
+				.set_default(0.0f)
+				.describe("Grow every tree on a gradient-based one-side sample of the rows: this "
+						  "fraction of the rows with the largest |gradient| and fpga_goss_other_rate "
+						  "of the rows at random from the rest, with their gradients scaled up to "
+						  "compensate. The device holds only the sampled rows, so that the kernel "
+						  "work shrinks with the sample and datasets with more rows than the kernel "
+						  "supports can be trained as long as every sample fits. 0 disables it.");
+		DMLC_DECLARE_FIELD(fpga_goss_other_rate)
+				.set_range(0.0f, 1.0f)
+				.set_default(0.1f)
+				.describe("Fraction of the rows sampled at random from the rows with smaller "
+						  "gradients by fpga_goss_top_rate.");
+		DMLC_DECLARE_FIELD(fpga_feature_bundling)
+				.set_default(false)
+				.describe("Bundle the features with a single present value, like one-hot columns, "
+						  "into shared columns of the device layout, so that the kernel scans a lane "
+						  "per bundle instead of a lane per feature. The splits stay exact. Has no "
+						  "effect with fpga_compact_entries, fpga_value_ranges, fpga_node_partition, "
+						  "column sampling or interaction constraints, and disables fpga_fused_tree.");
+		DMLC_DECLARE_FIELD(fpga_approx)
+				.set_default(false)
+				.describe("Cut every feature into at most max_bin quantile bins per tree, weighted "
+						  "by the hessian, and send the kernel one record per work node and bin "
+						  "with the summed gradients of its rows instead of the sorted entries. The "
+						  "thresholds fall on the bin boundaries. Adjacent bins are merged when the "
+						  "records of a level exceed the rows of the kernel, the level scans the "
+						  "exact entries when not even that fits. Has no effect with "
+						  "fpga_compact_entries, fpga_value_ranges or fpga_node_partition, and "
+						  "disables fpga_fused_tree and fpga_feature_bundling.");
+		DMLC_DECLARE_FIELD(fpga_layout_budget)
+				.set_lower_bound(0)
+				.set_default(0)
+				.describe("Keep the entry layout of a request on the host when an entry port of it "
+						  "takes more than this many MiB of device memory, and stream it to the "
+						  "kernel a window of feature blocks at a time, through two device buffers "
+						  "per port so that the upload of the next window overlaps the kernel call "
+						  "on the current one. 0 keeps every layout on the device. Has no effect "
+						  "with fpga_value_ranges or fpga_node_partition, and disables fpga_fused_tree.");
+		DMLC_DECLARE_FIELD(fpga_radix_sort)
+				.set_default(false)
+				.describe("Build the sorted columns of the training matrix from its row pages, read "
+						  "twice, with a parallel radix sort of the values of every feature, a block "
+						  "of features per thread, instead of the sorted column pages of the matrix. "
+						  "The sorted columns are still kept in host memory as one page, which the "
+						  "passes of every tree read. Equal values keep their row order, so the "
+						  "layouts are the same up to the order of equal values.");
+	}
+};
+
+DMLC_REGISTER_PARAMETER(FpgaTrainParam);
+
+// pack entry port `port` of a device column layout of batch_rows rows per block of
+// kLanes features into the compact entry format: 16-bit row index and 16-bit rank of
+// the value inside the feature, 2 rows of the port lanes per port word of the kernel;
+// padding entries get row 0xffff. A node partitioned layout is a single block of
+// batch_rows rows, row_block gives the block of the features of every row
+inline std::vector<uint32_t> PackCompactEntries(const std::vector<Entry>& layout, uint32_t batch_rows,
+											  uint32_t port, uint32_t col_begin,
+											  const std::vector<std::vector<float>>& feat_values,
+											  const std::vector<uint32_t>* row_block = nullptr) {
+	auto nrow_mlt = batch_rows*kLanes;
+	auto nrow_port_c = (batch_rows + (batch_rows%2))*kPortLanes;
+	auto ncol_mlt = static_cast<uint32_t>(layout.size()/nrow_mlt);
+	std::vector<uint32_t> compact(ncol_mlt*nrow_port_c, 0xffff);
+	#pragma omp parallel for schedule(static)
+	for (uint32_t ncidx = 0; ncidx < ncol_mlt; ncidx++) {
+		for (uint32_t i = 0; i < batch_rows*kPortLanes; i++) {
+			auto lane = port*kPortLanes + i%kPortLanes;
+			const Entry& e = layout[ncidx*nrow_mlt + (i/kPortLanes)*kLanes + lane];
+			if (e.index == static_cast<bst_uint>(-1)) continue;
+			auto block = row_block ? (*row_block)[i/kPortLanes] : ncidx;
+			const auto& values = feat_values[col_begin + block*kLanes + lane];
+			auto rank = static_cast<uint32_t>(
+					std::lower_bound(values.begin(), values.end(), e.fvalue) - values.begin());
+			compact[ncidx*nrow_port_c + i] = (rank << 16) | e.index;
+		}
+	}
+	return compact;
+}
+
+// the entries of port `port` of a device column layout: the kPortLanes lanes of the
+// port of every row of every block
+inline std::vector<Entry> PortEntries(const std::vector<Entry>& layout, uint32_t port) {
+	std::vector<Entry> entries(layout.size()/kEntryPorts);
+	#pragma omp parallel for schedule(static)
+	for (size_t i = 0; i < entries.size(); i++)
+		entries[i] = layout[(i/kPortLanes)*kLanes + port*kPortLanes + i%kPortLanes];
+	return entries;
+}
+
+// first sorted entry of value range `range` of a column of ndata entries, split evenly
+// into nranges ranges
+inline uint32_t RangeBegin(uint32_t ndata, uint32_t range, uint32_t nranges) {
+	return static_cast<uint32_t>(static_cast<uint64_t>(ndata)*range/nranges);
+}
+
+// the entry ports of the layouts over the device budget, kept on the host in the
+// format of the device; port p of request req is ports[p*nRequests+req], empty for a
+// layout on the device. The blocks of a port are contiguous and of equal size, so a
+// window of blocks is a slice of it
+struct HostLayout {
+	size_t budget{0};
+	std::vector<std::vector<char>> ports;
+	inline bool Streamed(uint32_t req) const { return req < ports.size() && !ports[req].empty(); }
+};
+
+// upload a device column layout to the entry ports of request req; port p is kept in
+// buffers[p*nRequests+req], allocated in the memory bank of the same index, or in the
+// host ports of `host` when it exceeds their budget. A layout of nblocks blocks may be
+// uploaded a group of blocks at a time, `layout` holding the blocks from block_begin:
+// the first group allocates the ports, the next ones are written at their offset
+inline void UploadLayout(cl_world world, const std::vector<Entry>& layout, uint32_t batch_rows,
+						 uint32_t col_begin, bool compact,
+						 const std::vector<std::vector<float>>& feat_values,
+						 uint32_t nRequests, uint32_t req, std::vector<void*>* buffers,
+						 const std::vector<uint32_t>* row_block = nullptr,
+						 HostLayout* host = nullptr, uint32_t block_begin = 0, uint32_t nblocks = 0) {
+	const auto blocks = static_cast<uint32_t>(layout.size()/(batch_rows*kLanes));
+	if (nblocks == 0) nblocks = blocks;
+	col_begin += block_begin*kLanes;
+	for (uint32_t port = 0; port < kEntryPorts; port++) {
+		auto buf = port*nRequests + req;
+		std::vector<uint32_t> words;
+		std::vector<Entry> entries;
+		const char* data = reinterpret_cast<const char*>(layout.data());
+		size_t bytes = layout.size()*sizeof(Entry);
+		if (compact) {
+			words = PackCompactEntries(layout, batch_rows, port, col_begin, feat_values, row_block);
+			data = reinterpret_cast<const char*>(words.data());
+			bytes = words.size()*sizeof(uint32_t);
+		} else if (kEntryPorts > 1) {
+			entries = PortEntries(layout, port);
+			data = reinterpret_cast<const char*>(entries.data());
+			bytes = entries.size()*sizeof(Entry);
+		}
+		const size_t total = bytes/blocks*nblocks;
+		const size_t offset = bytes/blocks*block_begin;
+		if (host != nullptr) {
+			if (host->budget > 0 && total > host->budget) {
+				if (block_begin == 0) host->ports[buf].resize(total);
+				std::copy(data, data + bytes, host->ports[buf].begin() + offset);
+				(*buffers)[buf] = 0;
+				continue;
+			}
+			std::vector<char>().swap(host->ports[buf]);
+		}
+		if (block_begin == 0) (*buffers)[buf] = InAccel::malloc(world, total, buf);
+		InAccel::memcpy_to(world, (*buffers)[buf], offset, const_cast<char*>(data), bytes);
+	}
+}
+
+// power of two scale of the gradients of a tree, that fills the integer bits of
+// the fixed point accumulators of the kernel, keeping a factor of two of headroom.
+// The node sums are bounded by the sums of |g| and h over the rows, the gains are
+// estimated by the sum of g^2/(h+lambda); power of two scales keep the kernel
+// results exactly invertible
+inline float GradientScale(const std::vector<GradientPair>& gpair, float reg_lambda) {
+	double sum_grad = 0.0, sum_hess = 0.0, sum_gain = 0.0;
+	for (const auto& g : gpair) {
+		if (g.GetHess() < 0.0f) continue;
+		sum_grad += std::fabs(g.GetGrad());
+		sum_hess += g.GetHess();
+		if (g.GetHess() + reg_lambda > 0.0f)
+			sum_gain += g.GetGrad() * g.GetGrad() / (g.GetHess() + reg_lambda);
+	}
+	double bound = std::max(std::max(sum_grad, sum_hess), sum_gain);
+	if (!(bound > 0.0)) return 1.0f;
+	int exp = static_cast<int>(std::floor(std::log2(std::ldexp(1.0, xgboost_exact::kAccumInt - 2) / bound)));
+	exp = std::min(std::max(exp, -30), 30);
+	return std::ldexp(1.0f, exp);
+}
+
+// gradient-based one-side sampling of the rows of a tree: the top_rate fraction of the
+// rows with the largest |g| and a random other_rate fraction of the rest, whose
+// gradient pairs are scaled by (1-top_rate)/other_rate to keep the node sums unbiased.
+// The rows left out get a negative hessian, like the deleted rows
+inline std::vector<GradientPair> GossSample(const std::vector<GradientPair>& gpair,
+											float top_rate, float other_rate) {
+	std::vector<uint32_t> rows;
+	for (uint32_t i = 0; i < gpair.size(); i++)
+		if (gpair[i].GetHess() >= 0.0f) rows.push_back(i);
+	auto ntop = static_cast<size_t>(top_rate * rows.size());
+	auto nother = std::min(static_cast<size_t>(other_rate * rows.size()), rows.size() - ntop);
+	std::nth_element(rows.begin(), rows.begin() + ntop, rows.end(), [&gpair](uint32_t a, uint32_t b) {
+		return std::fabs(gpair[a].GetGrad()) > std::fabs(gpair[b].GetGrad());
+	});
+	//the random rows of the rest by a partial shuffle
+	auto& rnd = common::GlobalRandom();
+	for (size_t i = ntop; i < ntop + nother; i++) {
+		std::uniform_int_distribution<size_t> pick(i, rows.size() - 1);
+		std::swap(rows[i], rows[pick(rnd)]);
+	}
+	std::vector<GradientPair> sampled(gpair.size(), GradientPair(0.0f, -1.0f));
+	for (size_t i = 0; i < ntop; i++)
+		sampled[rows[i]] = gpair[rows[i]];
+	const float weight = (1.0f - top_rate) / other_rate;
+	for (size_t i = ntop; i < ntop + nother; i++)
+		sampled[rows[i]] = GradientPair(gpair[rows[i]].GetGrad() * weight, gpair[rows[i]].GetHess() * weight);
+	return sampled;
+}
+
+// the sorted columns of the training matrix as a single page, iterated like the
+// batches of DMatrix::GetSortedColumnBatches: the page of an in memory matrix, or the
+// pages of an external memory one merged column by column by value. The merge copies
+// the entries of every page to their place in the merged page and merges the runs of
+// the pages of each column in place, without a second copy of the entries; the merged
+// page holds every entry of the matrix in host memory for the life of the updater, so
+// an external memory matrix must fit in host RAM as one sorted copy. With radix they
+// are built from the row pages
+class SortedColumns {
+ public:
+	inline void Init(DMatrix* dmat, bool radix) {
+		const auto ncol = static_cast<size_t>(dmat->Info().num_col_);
+		page_ = nullptr;
+		merged_.Clear();
+		if (radix) {
+			this->RadixSort(dmat, ncol);
+			page_ = &merged_;
+			return;
+		}
+		if (dmat->SingleColBlock()) {
+			for (const auto &batch : dmat->GetSortedColumnBatches()) page_ = &batch;
+			return;
+		}
+		auto& offset = merged_.offset.HostVector();
+		auto& data = merged_.data.HostVector();
+		offset.assign(ncol + 1, 0);
+		for (const auto &batch : dmat->GetSortedColumnBatches())
+			for (size_t cidx = 0; cidx < std::min(batch.Size(), ncol); cidx++)
+				offset[cidx + 1] += batch[cidx].size();
+		for (size_t cidx = 0; cidx < ncol; cidx++) offset[cidx + 1] += offset[cidx];
+		data.resize(offset[ncol]);
+		std::vector<std::vector<size_t>> runs(ncol);
+		for (const auto &batch : dmat->GetSortedColumnBatches()) {
+			#pragma omp parallel for schedule(dynamic)
+			for (size_t cidx = 0; cidx < std::min(batch.Size(), ncol); cidx++) {
+				auto col = batch[cidx];
+				size_t begin = runs[cidx].empty() ? 0 : runs[cidx].back();
+				std::copy(col.data(), col.data() + col.size(), data.begin() + offset[cidx] + begin);
+				runs[cidx].push_back(begin + col.size());
+			}
+		}
+		#pragma omp parallel for schedule(dynamic)
+		for (size_t cidx = 0; cidx < ncol; cidx++) {
+			auto first = data.begin() + offset[cidx];
+			for (size_t r = 1; r < runs[cidx].size(); r++)
+				std::inplace_merge(first, first + runs[cidx][r-1], first + runs[cidx][r], Entry::CmpValue);
+		}
+		page_ = &merged_;
+	}
+	inline const SparsePage* begin() const { return page_; }
+	inline const SparsePage* end() const { return page_ == nullptr ? page_ : page_ + 1; }
+
+ private:
+	// the entries of every column in row order, the rows of a page split into a
+	// contiguous chunk per thread whose entries follow those of the chunks before it,
+	// then a radix sort of every column, a block of kLanes columns per task so that the
+	// columns of a block and the sort buffers of its thread stay in cache. The row pages
+	// are read twice, to count the entries of every chunk and column and to place them;
+	// the counts of a page are kept for the second read
+	inline void RadixSort(DMatrix* dmat, size_t ncol) {
+		auto& offset = merged_.offset.HostVector();
+		auto& data = merged_.data.HostVector();
+		const auto nthread = static_cast<size_t>(omp_get_max_threads());
+		std::vector<std::vector<std::vector<size_t>>> page_counts;
+		offset.assign(ncol + 1, 0);
+		for (const auto &batch : dmat->GetRowBatches()) {
+			const size_t nrow = batch.Size();
+			page_counts.emplace_back(nthread, std::vector<size_t>(ncol, 0));
+			auto& counts = page_counts.back();
+			#pragma omp parallel for schedule(static, 1)
+			for (size_t t = 0; t < nthread; t++)
+				for (size_t i = nrow*t/nthread; i < nrow*(t+1)/nthread; i++)
+					for (const auto& e : batch[i]) counts[t][e.index]++;
+			for (size_t t = 0; t < nthread; t++)
+				for (size_t cidx = 0; cidx < ncol; cidx++) offset[cidx + 1] += counts[t][cidx];
+		}
+		for (size_t cidx = 0; cidx < ncol; cidx++) offset[cidx + 1] += offset[cidx];
+		data.resize(offset[ncol]);
+		std::vector<size_t> fill(offset.begin(), offset.end() - 1);
+		size_t page = 0;
+		for (const auto &batch : dmat->GetRowBatches()) {
+			auto& cursor = page_counts[page++];
+			for (size_t cidx = 0; cidx < ncol; cidx++) {
+				for (size_t t = 0; t < nthread; t++) {
+					size_t n = cursor[t][cidx];
+					cursor[t][cidx] = fill[cidx];
+					fill[cidx] += n;
+				}
+			}
+			const size_t nrow = batch.Size();
+			#pragma omp parallel for schedule(static, 1)
+			for (size_t t = 0; t < nthread; t++)
+				for (size_t i = nrow*t/nthread; i < nrow*(t+1)/nthread; i++)
+					for (const auto& e : batch[i])
+						data[cursor[t][e.index]++] = Entry(static_cast<bst_uint>(batch.base_rowid + i), e.fvalue);
+		}
+		const size_t nblock = (ncol + kLanes - 1)/kLanes;
+		#pragma omp parallel
+		{
+			std::vector<uint32_t> keys, keys_tmp;
+			std::vector<Entry> tmp;
+			#pragma omp for schedule(dynamic)
+			for (size_t b = 0; b < nblock; b++)
+				for (size_t cidx = b*kLanes; cidx < std::min((b+1)*kLanes, ncol); cidx++)
+					RadixSortColumn(data.data() + offset[cidx], offset[cidx + 1] - offset[cidx],
+									&keys, &keys_tmp, &tmp);
+		}
+	}
+	// stable LSD radix sort of n entries by value, 8 bits a pass on the bits of the
+	// values mapped to unsigned order, -0 to 0 so equal values keep their row order;
+	// the passes with one digit for all the keys are skipped
+	static inline void RadixSortColumn(Entry* entries, size_t n, std::vector<uint32_t>* keys,
+									   std::vector<uint32_t>* keys_tmp, std::vector<Entry>* tmp) {
+		if (n < 2) return;
+		keys->resize(n);
+		keys_tmp->resize(n);
+		tmp->resize(n);
+		for (size_t i = 0; i < n; i++) {
+			uint32_t u;
+			std::memcpy(&u, &entries[i].fvalue, sizeof(u));
+			if (u == 0x80000000U) u = 0;
+			(*keys)[i] = (u & 0x80000000U) ? ~u : (u | 0x80000000U);
+		}
+		Entry* src = entries;
+		Entry* dst = tmp->data();
+		uint32_t* ksrc = keys->data();
+		uint32_t* kdst = keys_tmp->data();
+		for (uint32_t shift = 0; shift < 32; shift += 8) {
+			size_t count[257] = {0};
+			for (size_t i = 0; i < n; i++) count[((ksrc[i] >> shift) & 0xff) + 1]++;
+			if (count[((ksrc[0] >> shift) & 0xff) + 1] == n) continue;
+			for (uint32_t d = 0; d < 256; d++) count[d + 1] += count[d];
+			for (size_t i = 0; i < n; i++) {
+				auto pos = count[(ksrc[i] >> shift) & 0xff]++;
+				dst[pos] = src[i];
+				kdst[pos] = ksrc[i];
+			}
+			std::swap(src, dst);
+			std::swap(ksrc, kdst);
+		}
+		if (src != entries) std::copy(src, src + n, entries);
+	}
+
+	const SparsePage* page_{nullptr};
+	SparsePage merged_;
+};
+
+// the layout columns of the features: a column per feature, or a bundle of single valued
+// features like one-hot columns, whose entries carry the position of their feature in the
+// bundle as value. The kernel restarts the sums of a bundle lane at every value, so the
+// entries of a bundle may share rows
+struct FeatureBundles {
+	// the features of every layout column
+	std::vector<std::vector<uint32_t>> cols;
+	// the layout column of every feature
+	std::vector<uint32_t> col_of;
+	// the present value of every single valued feature
+	std::vector<float> value;
+	// the entries of every bundle, sorted by position; empty for the other columns
+	std::vector<std::vector<Entry>> entries;
+	inline bool Bundled() const { return cols.size() < col_of.size(); }
+	inline bool IsBundle(uint32_t c) const { return cols[c].size() > 1; }
+	// the sorted entries of layout column c
+	inline SparsePage::Inst Column(const SparsePage& batch, uint32_t c) const {
+		if (IsBundle(c)) return SparsePage::Inst(entries[c].data(), entries[c].size());
+		return batch[cols[c][0]];
+	}
+	// the feature and threshold of a split of layout column sindex+offset: a bundle split
+	// sends the feature at the position below the threshold left with the missing values
+	// right, or the feature above it right with the missing values left
+	inline unsigned Split(unsigned sindex, uint32_t offset, float* split_value) const {
+		const uint32_t c = (sindex & 0x7fffffff) + offset;
+		const unsigned default_left = sindex & 0x80000000;
+		if (c >= cols.size()) return sindex + offset;
+		if (!IsBundle(c)) return cols[c][0] | default_left;
+		int pos = static_cast<int>(std::floor(*split_value)) + (default_left ? 1 : 0);
+		pos = std::min(std::max(pos, 0), static_cast<int>(cols[c].size()) - 1);
+		const uint32_t fid = cols[c][pos];
+		const float v = value[fid];
+		*split_value = default_left ? v : v + std::fabs(v) + kRtEps;
+		return fid | default_left;
+	}
+};
+
+// bundle the single valued features without a monotone constraint, first fit by entry
+// count into bundles of at most capacity entries, the rows of the longest column; the
+// other features keep their order and the bundles follow them
+inline FeatureBundles BundleFeatures(DMatrix* dmat, const SortedColumns& columns, uint32_t capacity,
+									 const std::vector<int>& monotone, bool enable) {
+	const auto ncol = static_cast<uint32_t>(dmat->Info().num_col_);
+	FeatureBundles bundles;
+	bundles.col_of.resize(ncol);
+	bundles.value.assign(ncol, 0.0f);
+	std::vector<uint32_t> nentries(ncol, 0);
+	std::vector<char> single(ncol, 0);
+	for (const auto &batch : columns) {
+		#pragma omp parallel for schedule(static)
+		for (uint32_t cidx = 0; cidx < ncol; cidx++) {
+			auto col = batch[cidx];
+			const auto ndata = static_cast<uint32_t>(col.size());
+			nentries[cidx] = ndata;
+			if (ndata == 0) continue;
+			bundles.value[cidx] = col[0].fvalue;
+			single[cidx] = col[0].fvalue == col[ndata-1].fvalue &&
+					!(cidx < monotone.size() && monotone[cidx] != 0);
+		}
+	}
+	std::vector<uint32_t> order;
+	for (uint32_t cidx = 0; enable && cidx < ncol; cidx++)
+		if (single[cidx]) order.push_back(cidx);
+	std::stable_sort(order.begin(), order.end(), [&nentries](uint32_t a, uint32_t b) {
+		return nentries[a] > nentries[b];
+	});
+	std::vector<std::vector<uint32_t>> groups;
+	std::vector<uint32_t> load;
+	for (auto fid : order) {
+		size_t g = 0;
+		while (g < groups.size() && (load[g] + nentries[fid] > capacity ||
+				groups[g].size() == xgboost_exact::kMaxBundleFeatures)) g++;
+		if (g == groups.size()) {
+			groups.emplace_back();
+			load.push_back(0);
+		}
+		groups[g].push_back(fid);
+		load[g] += nentries[fid];
+	}
+	std::vector<char> bundled(ncol, 0);
+	for (const auto& group : groups)
+		for (auto fid : group) bundled[fid] = group.size() > 1;
+	for (uint32_t cidx = 0; cidx < ncol; cidx++)
+		if (!bundled[cidx]) bundles.cols.push_back({cidx});
+	for (auto& group : groups) {
+		if (group.size() < 2) continue;
+		std::sort(group.begin(), group.end());
+		bundles.cols.push_back(group);
+	}
+	const auto ncol_layout = static_cast<uint32_t>(bundles.cols.size());
+	for (uint32_t c = 0; c < ncol_layout; c++)
+		for (auto fid : bundles.cols[c]) bundles.col_of[fid] = c;
+	bundles.entries.resize(ncol_layout);
+	for (const auto &batch : columns) {
+		#pragma omp parallel for schedule(dynamic)
+		for (uint32_t c = 0; c < ncol_layout; c++) {
+			if (!bundles.IsBundle(c)) continue;
+			for (uint32_t pos = 0; pos < bundles.cols[c].size(); pos++)
+				for (const auto& e : batch[bundles.cols[c][pos]])
+					bundles.entries[c].emplace_back(e.index, static_cast<float>(pos));
+		}
+	}
+	return bundles;
+}
+
+// readable form of the counters written by the kernel after a call; the loop
+// counters are cycles of the kernel clock, any time beyond their sum went to
+// the memory stalls the kernel cannot observe
+template <typename T>
+inline std::string FormatKernelStats(const T* stats) {
+	using namespace xgboost_exact;
+	std::ostringstream os;
+	os << "init " << stats[kStatEntryInit] << "+" << stats[kStatNodeInit] << "+" << stats[kStatClear]
+	   << " blocks " << stats[kStatBlocks] << " (skipped " << stats[kStatBlocksSkipped] << ")"
+	   << " read " << stats[kStatReadWords] << " (stalled " << stats[kStatReadStalls]
+	   << ", masks " << stats[kStatMaskWords] << ")"
+	   << " scan " << stats[kStatScanCycles]
+	   << " slots padding " << stats[kStatEntriesPadding] << " inactive " << stats[kStatEntriesInactive]
+	   << " masked " << stats[kStatEntriesMasked]
+	   << " write back " << stats[kStatWriteBack]
+	   << " levels " << stats[kStatLevels] << " position " << stats[kStatPositionCycles]
+	   << " seeds " << stats[kStatSeedWords] << " segments " << stats[kStatSegmentWords];
+	return os.str();
+}
+
+// the kernel counters summed over the calls of every level of the trees, a level being
+// a kernel call of a tree: a depth, or a round of lossguide; printed at debug verbosity
+// next to the Monitor timings of the updater
+struct KernelLevelStats {
+	std::vector<std::vector<uint64_t>> levels;
+	std::vector<uint64_t> calls;
+	inline void Add(size_t level, const uint32_t* stats) {
+		if (levels.size() <= level) {
+			levels.resize(level + 1, std::vector<uint64_t>(xgboost_exact::kStatCount, 0));
+			calls.resize(level + 1, 0);
+		}
+		for (uint32_t k = 0; k < xgboost_exact::kStatCount; k++) levels[level][k] += stats[k];
+		calls[level]++;
+	}
+	inline void Print(const std::string& label) const {
+		if (levels.empty()) return;
+		LOG(DEBUG) << "======== Kernel counters: " << label << " ========";
+		for (size_t level = 0; level < levels.size(); level++)
+			LOG(DEBUG) << "level " << level << ": " << calls[level] << " calls, "
+					   << FormatKernelStats(levels[level].data());
+	}
+};
+
+// write blocks [block, block+nblock) of the column layout of a request of batch_rows
+// rows per block to out, value range `range` of its columns from col_begin; a block
+// per task, written a row of its lanes at a time
+inline void FillBlocks(const SparsePage& batch, const FeatureBundles& bundles, uint32_t col_begin,
+					   uint32_t ncol_req, uint32_t block, uint32_t nblock, uint32_t range,
+					   uint32_t nranges, uint32_t batch_rows, Entry* out) {
+	#pragma omp parallel for schedule(dynamic)
+	for (uint32_t ncidx = 0; ncidx < nblock; ncidx++) {
+		const auto cbegin = col_begin + (block + ncidx)*kLanes;
+		const auto nlane = std::min(kLanes, col_begin + ncol_req - cbegin);
+		const Entry* lane_data[kLanes];
+		uint32_t lane_rows[kLanes];
+		uint32_t nrows = 0;
+		for (uint32_t lane = 0; lane < nlane; lane++) {
+			auto col = bundles.Column(batch, cbegin + lane);
+			const auto ndata = static_cast<uint32_t>(col.size());
+			const auto rbegin = RangeBegin(ndata, range, nranges);
+			lane_data[lane] = col.data() + rbegin;
+			lane_rows[lane] = RangeBegin(ndata, range + 1, nranges) - rbegin;
+			nrows = std::max(nrows, lane_rows[lane]);
+		}
+		Entry* block_out = out + static_cast<size_t>(ncidx)*batch_rows*kLanes;
+		for (uint32_t r = 0; r < nrows; r++)
+			for (uint32_t lane = 0; lane < nlane; lane++)
+				if (r < lane_rows[lane]) block_out[r*kLanes + lane] = lane_data[lane][r];
+	}
+}
+
 // actual builder that runs the algorithm
 // distributed column maker
 class DistFpgaMaker : public TreeUpdater {
  public:
 	~DistFpgaMaker()
 	{
-		for(uint32_t req = 0; req<nRequests_; req++)
-		{
-			InAccel::free(world_, dmat_fpga_[req]);
+		kernel_stats_.Print(Name());
+		for(uint32_t buf = 0; buf<dmat_fpga_.size(); buf++)
+			if(dmat_fpga_[buf] != 0) InAccel::free(world_, dmat_fpga_[buf]);
+		for(uint32_t req = 0; req<fdense_fpga_.size(); req++)
+			InAccel::free(world_, fdense_fpga_[req]);
+		for(uint32_t req = 0; req<engine_.size(); req++)
 			InAccel::release_engine(engine_[req]);
-		}
 		InAccel::release_program(world_);
 		InAccel::release_world(world_);
 	}
 	void Configure(const Args& args) override {
 		param_.InitAllowUnknown(args);
+		fparam_.InitAllowUnknown(args);
 		pruner_.reset(TreeUpdater::Create("prune", tparam_));
 		pruner_->Configure(args);
 		spliteval_.reset(SplitEvaluator::Create(param_.split_evaluator));
 		spliteval_->Init(args);
 		is_dmat_fpga_initialized_ = false;
-		nRequests_ = 2;
+		// a fused tree needs all the features in one kernel; with value ranges the two
+		// kernels get all the features, request req the range req%nRanges_ of the features
+		// of part req/nRanges_
+		nRanges_ = fparam_.fpga_value_ranges ? 2 : 1;
+		fused_tree_ = this->FusedTree();
+		nRequests_ = fused_tree_ ? 1 : 2;
 		world_ = InAccel::create_world(0);
 
 		InAccel::create_program(world_, std::getenv("BITSTREAM") );
-		engine_.resize(nRequests_);
+		// both engines even for a fused tree, which the data may still split in two requests
+		engine_.resize(2);
 		// without coral to manage the requests,
 		// the number of reqs must match the actual reqs inside the bitstream
 		// the memory bank should match with the req id,
@@ -71,6 +706,20 @@ class DistFpgaMaker : public TreeUpdater {
 		engine_[0] = InAccel::create_engine(world_, "xgboost_exact_0" );
 		engine_[1] = InAccel::create_engine(world_, "xgboost_exact_1" );
 	}
+	// whether the trees are grown with a single kernel call, by the parameters that
+	// make the builder fall back to a call per level; those keep both kernels busy
+	inline bool FusedTree() const {
+		const bool monotone = param_.split_evaluator.find("monotonic") != std::string::npos &&
+				std::any_of(param_.monotone_constraints.begin(), param_.monotone_constraints.end(),
+							[](int c) { return c != 0; });
+		return fparam_.fpga_fused_tree && !fparam_.fpga_value_ranges && !fparam_.fpga_node_partition &&
+				!(fparam_.fpga_approx && !fparam_.fpga_compact_entries) &&
+				!(fparam_.fpga_feature_bundling && !fparam_.fpga_compact_entries) &&
+				fparam_.fpga_layout_budget == 0 && fparam_.fpga_resum_interval == 0 &&
+				rabit::GetWorldSize() == 1 && param_.grow_policy != TrainParam::kLossGuide && !monotone &&
+				param_.colsample_bylevel == 1.0f && param_.colsample_bynode == 1.0f &&
+				param_.interaction_constraints.empty();
+	}
 	char const* Name() const override {
 		return "grow_fpga";
 	}
@@ -82,69 +731,166 @@ class DistFpgaMaker : public TreeUpdater {
 		const auto ncol = static_cast<uint32_t>(dmat->Info().num_col_);
 		if (is_dmat_fpga_initialized_ == false) {
 			monitor_.Start("Init dmat_fpga");
+			CHECK(nrow <= xgboost_exact::kMaxEntryNum || fparam_.fpga_goss_top_rate > 0.0f)
+				<< "The kernel supports up to " << xgboost_exact::kMaxEntryNum
+				<< " rows, more with fpga_goss_top_rate";
+			// more features than a fused tree takes make it a call per level on both kernels
+			if (fused_tree_ && ncol > xgboost_exact::kMaxFeatureNum) {
+				fused_tree_ = false;
+				nRequests_ = 2;
+			}
+			monitor_.Start("Merge column pages");
+			columns_.Init(dmat, fparam_.fpga_radix_sort);
+			monitor_.Stop("Merge column pages");
+			// with goss every tree lays out the rows of its sample before the first call, the
+			// layout of all the rows is never scanned
+			const bool goss = fparam_.fpga_goss_top_rate > 0.0f;
 			max_rows_ = 0;
-			for (const auto &batch : dmat->GetSortedColumnBatches()) {
+			for (const auto &batch : columns_) {
+				if (goss) break;
 				for (uint32_t cidx = 0; cidx < ncol; cidx++) {
 					auto col = batch[cidx];
-					auto rows = static_cast<uint32_t>(col.size());
-					if(rows > max_rows_) max_rows_ = rows;
+					auto ndata = static_cast<uint32_t>(col.size());
+					for (uint32_t range = 0; range < nRanges_; range++) {
+						auto rows = RangeBegin(ndata, range+1, nRanges_) - RangeBegin(ndata, range, nRanges_);
+						if(rows > max_rows_) max_rows_ = rows;
+					}
 				}
 			}
-			std::vector<std::vector<Entry>> dmat_fpga_tmp;
-			dmat_fpga_tmp.resize(nRequests_);
-			dmat_fpga_.resize(nRequests_);
-			req_cols_.resize(nRequests_+1);
+			dmat_fpga_.resize(nRequests_*kEntryPorts);
+			// bundles of single valued features, when every feature is scanned at every node
+			const bool bundling = fparam_.fpga_feature_bundling && !fparam_.fpga_compact_entries &&
+					nRanges_ == 1 && !fparam_.fpga_node_partition && param_.colsample_bytree == 1.0f &&
+					param_.colsample_bylevel == 1.0f && param_.colsample_bynode == 1.0f &&
+					param_.interaction_constraints.empty() && !fparam_.fpga_approx;
+			//the bundles of a goss window fill at most the rows of the kernel
+			bundles_ = BundleFeatures(dmat, columns_, goss ? xgboost_exact::kMaxEntryNum : max_rows_,
+									  param_.monotone_constraints, bundling);
+			const auto ncol_layout = static_cast<uint32_t>(bundles_.cols.size());
+			uint32_t nparts = nRequests_/nRanges_;
+			req_cols_.resize(nparts+1);
 			req_cols_[0] = 0;
-			uint32_t ncol_div = ncol/nRequests_;
-			uint32_t ncol_mod = ncol%nRequests_;
-			auto nrow_mlt = max_rows_*8;
-			Entry invalid;
-			invalid.fvalue = 0;
-			invalid.index = -1;
-			for(uint32_t req = 0; req<nRequests_; req++) {
-				req_cols_[req+1] = req_cols_[req] + ncol_div + ((ncol_mod>0)?1:0);
+			uint32_t ncol_div = ncol_layout/nparts;
+			uint32_t ncol_mod = ncol_layout%nparts;
+			for(uint32_t part = 0; part<nparts; part++) {
+				req_cols_[part+1] = req_cols_[part] + ncol_div + ((ncol_mod>0)?1:0);
 				ncol_mod-=((ncol_mod>0)?1:0);
-				auto ncol_req = req_cols_[req+1] - req_cols_[req];
-				auto ncol_mlt = ncol_req/8 + ((ncol_req%8)>0?1:0);
-				dmat_fpga_tmp[req].resize(ncol_mlt*nrow_mlt);
-				std::fill(dmat_fpga_tmp[req].begin(),dmat_fpga_tmp[req].end(),invalid);
-				for (const auto &batch : dmat->GetSortedColumnBatches()) {
+			}
+			if (fparam_.fpga_compact_entries) {
+				CHECK_LT(nrow, 65536U) << "fpga_compact_entries requires less than 65536 rows";
+				feat_values_.resize(ncol);
+				for (const auto &batch : columns_) {
 					#pragma omp parallel for schedule(static)
-					for (uint32_t cidx = req_cols_[req]; cidx < req_cols_[req+1]; cidx++) {
+					for (uint32_t cidx = 0; cidx < ncol; cidx++) {
 						auto col = batch[cidx];
-						auto rblock_idx = (cidx-req_cols_[req])%8;
-						auto ncidx = (cidx-req_cols_[req])/8;
+						auto& values = feat_values_[cidx];
 						const auto ndata = static_cast<uint32_t>(col.size());
-						for (uint32_t ridx = 0; ridx < ndata; ridx++) {
-							const Entry e = col[ridx];
-							auto rblock = ridx*8;
-							dmat_fpga_tmp[req][ncidx*nrow_mlt + rblock + rblock_idx] = e;
-						}
+						for (uint32_t ridx = 0; ridx < ndata; ridx++)
+							if (values.empty() || values.back() != col[ridx].fvalue)
+								values.push_back(col[ridx].fvalue);
 					}
 				}
 			}
+			auto nrow_mlt = max_rows_*kLanes;
+			Entry invalid;
+			invalid.fvalue = 0;
+			invalid.index = -1;
+			// the value ranges and the node partition keep their layouts on the device
+			dmat_host_.budget = (nRanges_ == 1 && !fparam_.fpga_node_partition)
+					? static_cast<size_t>(fparam_.fpga_layout_budget) << 20 : 0;
+			dmat_host_.ports.assign(nRequests_*kEntryPorts, std::vector<char>());
+			// the layout of a request is built and written to the device a group of blocks
+			// at a time, so the host holds at most kLayoutGroupEntries entries of it
+			const uint32_t group = std::max<uint32_t>(kLayoutGroupEntries/std::max(nrow_mlt, 1U), 1);
+			std::vector<Entry> dmat_fpga_tmp;
+			for(uint32_t req = 0; req<nRequests_ && !goss; req++) {
+				auto range = req%nRanges_;
+				auto col_begin = req_cols_[req/nRanges_];
+				auto ncol_req = req_cols_[req/nRanges_+1] - col_begin;
+				auto ncol_mlt = BlockCount(ncol_req);
+				for (uint32_t block = 0; block < ncol_mlt; block += group) {
+					auto nblock = std::min(group, ncol_mlt - block);
+					dmat_fpga_tmp.assign(static_cast<size_t>(nblock)*nrow_mlt, invalid);
+					for (const auto &batch : columns_)
+						FillBlocks(batch, bundles_, col_begin, ncol_req, block, nblock, range, nRanges_,
+								   max_rows_, dmat_fpga_tmp.data());
+					UploadLayout(world_, dmat_fpga_tmp, max_rows_, col_begin, fparam_.fpga_compact_entries,
+								 feat_values_, nRequests_, req, &dmat_fpga_, nullptr, &dmat_host_, block, ncol_mlt);
+				}
+			}
+			std::vector<Entry>().swap(dmat_fpga_tmp);
+			// mask of the features without missing values of every block, for the single pass mode
+			fdense_fpga_.resize(nRequests_);
+			fdense_host_.assign(nRequests_, std::vector<char>());
 			for(uint32_t req = 0; req<nRequests_; req++) {
-				dmat_fpga_[req] = InAccel::malloc(world_, dmat_fpga_tmp[req].size()*sizeof(Entry), req);
-				InAccel::memcpy_to(world_, dmat_fpga_[req], 0, dmat_fpga_tmp[req].data(),
-								   dmat_fpga_tmp[req].size()*sizeof(Entry));
+				auto ncol_req = req_cols_[req/nRanges_+1] - req_cols_[req/nRanges_];
+				auto ncol_mlt = BlockCount(ncol_req);
+				std::vector<char> fdense_tmp(ncol_mlt*kLanes/8, 0);
+				if (fparam_.fpga_single_pass) {
+					for (const auto &batch : columns_) {
+						for (uint32_t cidx = req_cols_[req/nRanges_]; cidx < req_cols_[req/nRanges_+1]; cidx++) {
+							if (!bundles_.IsBundle(cidx) && batch[cidx].size() == nrow)
+								fdense_tmp[(cidx-req_cols_[req/nRanges_])/8] |= (1<<((cidx-req_cols_[req/nRanges_])%8));
+						}
+					}
+				}
+				fdense_fpga_[req] = InAccel::malloc(world_, fdense_tmp.size()*sizeof(char), req);
+				InAccel::memcpy_to(world_, fdense_fpga_[req], 0, fdense_tmp.data(),
+								   fdense_tmp.size()*sizeof(char));
+				//the windows of a host layout get slices of it
+				if (dmat_host_.Streamed(req)) fdense_host_[req].swap(fdense_tmp);
 			}
 			is_dmat_fpga_initialized_ = true;
 			monitor_.Stop("Init dmat_fpga");
 		}
-		Builder builder( nrow, ncol, max_rows_, nRequests_, param_, monitor_, world_, engine_,
+		std::vector<GradientPair>& gpair_h = gpair->HostVector();
+		//with goss the tree is grown on a sample of the rows, numbered in row order on the device
+		std::vector<GradientPair> gpair_goss;
+		std::vector<int> row_window;
+		uint32_t window_rows = nrow;
+		if (fparam_.fpga_goss_top_rate > 0.0f) {
+			CHECK_LE(fparam_.fpga_goss_top_rate + fparam_.fpga_goss_other_rate, 1.0f)
+				<< "fpga_goss_top_rate + fpga_goss_other_rate must not exceed 1";
+			monitor_.Start("Goss sample");
+			gpair_goss = GossSample(gpair_h, fparam_.fpga_goss_top_rate, fparam_.fpga_goss_other_rate);
+			row_window.assign(nrow, -1);
+			window_rows = 0;
+			for (uint32_t i = 0; i < nrow; i++)
+				if (gpair_goss[i].GetHess() >= 0.0f) row_window[i] = window_rows++;
+			CHECK_LE(window_rows, xgboost_exact::kMaxEntryNum) << "The goss sample has " << window_rows
+				<< " rows, the kernel supports up to " << xgboost_exact::kMaxEntryNum
+				<< ". Please reduce fpga_goss_top_rate or fpga_goss_other_rate";
+			monitor_.Stop("Goss sample");
+		}
+		std::vector<GradientPair>& gpair_tree = row_window.empty() ? gpair_h : gpair_goss;
+		const float gscale = (fparam_.fpga_grad_scale && !xgboost_exact::kFloatAccum)
+				? GradientScale(gpair_tree, param_.reg_lambda) : 1.0f;
+		Builder builder( nrow, ncol, max_rows_, nRequests_, nRanges_, param_, fparam_, feat_values_, bundles_, columns_,
+						 dmat_host_, fdense_host_, gscale,
+						 row_window, window_rows, monitor_, kernel_stats_, world_, engine_,
 						 std::unique_ptr<SplitEvaluator>(spliteval_->GetHostClone()));
 		monitor_.Start("Init gpair_fpga");
-		std::vector<GradientPair>& gpair_h = gpair->HostVector();
-		size_t gpair_fpga_size = gpair_h.size() + (((gpair_h.size()%8)>0)?(8 - (gpair_h.size()%8)):0);
+		size_t gpair_fpga_size = window_rows + (((window_rows%8)>0)?(8 - (window_rows%8)):0);
+		std::vector<GradientPair> gpair_scaled;
+		if (gscale != 1.0f || !row_window.empty()) {
+			gpair_scaled.resize(window_rows);
+			for (size_t i = 0; i < gpair_tree.size(); i++) {
+				if (!row_window.empty() && row_window[i] < 0) continue;
+				gpair_scaled[row_window.empty() ? i : row_window[i]] =
+						GradientPair(gpair_tree[i].GetGrad()*gscale, gpair_tree[i].GetHess()*gscale);
+			}
+		}
+		GradientPair* gpair_src = gpair_scaled.empty() ? gpair_h.data() : gpair_scaled.data();
 		gpair_fpga_.resize(nRequests_);
 		for(uint32_t req = 0; req<nRequests_; req++)
 		{
 			gpair_fpga_[req] = InAccel::malloc(world_, gpair_fpga_size*sizeof(GradientPair), req);
-			InAccel::memcpy_to(world_, gpair_fpga_[req], 0, gpair_h.data(), gpair_h.size()*sizeof(GradientPair));
+			InAccel::memcpy_to(world_, gpair_fpga_[req], 0, gpair_src, window_rows*sizeof(GradientPair));
 		}
 		monitor_.Stop("Init gpair_fpga");
 		monitor_.Start("builder Update");
-		builder.Update( gpair->ConstHostVector(), gpair_fpga_, dmat, dmat_fpga_, req_cols_, trees[0]);
+		builder.Update( gpair_tree, gpair_fpga_, dmat, dmat_fpga_, fdense_fpga_, req_cols_,
+						trees[0]);
 		monitor_.Stop("builder Update");
 		monitor_.Start("pruner Update");
 		pruner_->Update(gpair, dmat, trees);
@@ -155,17 +901,33 @@ class DistFpgaMaker : public TreeUpdater {
 	}
  protected:
 	common::Monitor monitor_;
+	// the kernel counters of the trees, by level
+	KernelLevelStats kernel_stats_;
 	unsigned nRequests_;
+	unsigned nRanges_;
 	uint32_t max_rows_;
 	cl_world world_;
 	std::vector<cl_engine> engine_;
 	TrainParam param_;
+	FpgaTrainParam fparam_;
 	std::unique_ptr<SplitEvaluator> spliteval_;
 	std::unique_ptr<TreeUpdater> pruner_;
 	bool is_dmat_fpga_initialized_;
+	// a single request for the fused trees
+	bool fused_tree_;
 	//device buffers
 	std::vector<void*> dmat_fpga_;
 	std::vector<uint32_t> req_cols_;
+	std::vector<void*> fdense_fpga_;
+	// the layouts over fpga_layout_budget, and the dense masks of their requests
+	HostLayout dmat_host_;
+	std::vector<std::vector<char>> fdense_host_;
+	// the sorted columns of the training matrix, over all of its pages
+	SortedColumns columns_;
+	// distinct values of each feature, the rank to value tables of the compact entries
+	std::vector<std::vector<float>> feat_values_;
+	// the layout columns of the features
+	FeatureBundles bundles_;
 	std::vector<void*> gpair_fpga_;
 	// data structure
 	struct XGBOOST_ALIGNAS(8) GradStatsInAccel {
@@ -209,6 +971,8 @@ class DistFpgaMaker : public TreeUpdater {
 	  unsigned nu2;
 	  unsigned nu3;
 	};
+	static_assert(sizeof(SplitEntryInAccelRet) == xgboost_exact::kSplitBytes,
+				  "SplitEntryInAccelRet does not match the split records of the kernel.");
 	struct SplitEntryInAccel {
 	  float loss_chg{0.0f};
 	  unsigned sindex{0};
@@ -285,6 +1049,16 @@ class DistFpgaMaker : public TreeUpdater {
 		SplitEntryInAccel best;
 		NodeEntryInAccel() : root_gain{0.0f}, weight{0.0f} {}
 	};
+	// a node of the loss guided growth waiting to be expanded, the best loss change
+	// first and the older node first on ties
+	struct ExpandEntryInAccel {
+		int nid;
+		float loss_chg;
+		uint64_t timestamp;
+		static bool Compare(const ExpandEntryInAccel& a, const ExpandEntryInAccel& b) {
+			return a.loss_chg == b.loss_chg ? a.timestamp > b.timestamp : a.loss_chg < b.loss_chg;
+		}
+	};
  private:
 	class Builder {
 	 protected:
@@ -292,9 +1066,26 @@ class DistFpgaMaker : public TreeUpdater {
 	 	unsigned ncols_;
 	 	unsigned max_rows_;
 	 	unsigned nRequests_;
+	 	unsigned nRanges_;
 
 		const TrainParam& param_;
+		const FpgaTrainParam& fparam_;
+		const std::vector<std::vector<float>>& feat_values_;
+		const FeatureBundles& bundles_;
+		// the sorted columns of the training matrix
+		const SortedColumns& columns_;
+		const HostLayout& dmat_host_;
+		const std::vector<std::vector<char>>& fdense_host_;
+		// power of two scale of the gradients on the device
+		const float gscale_;
+		// device row of every row of a goss sample, -1 for the rows left out; empty
+		// when the device holds all the rows
+		const std::vector<int>& row_window_;
+		const unsigned window_rows_;
 		common::Monitor& monitor_;
+		// the counters of the kernel calls, by level
+		KernelLevelStats& kernel_stats_;
+		size_t kernel_level_{0};
 		const cl_world& world_;
 		const std::vector<cl_engine>& engine_;
 		const int nthread_;
@@ -305,9 +1096,66 @@ class DistFpgaMaker : public TreeUpdater {
 		std::vector<NodeEntryInAccel> snode_;
 		std::vector<void*> snode_stats_;
 		std::vector<void*> snode_rg_;
+		std::vector<void*> snode_bounds_;
+		std::vector<void*> feat_mono_fpga_;
+		std::vector<void*> node_fmask_fpga_;
 		std::vector<void*> feat_valid_fpga_;
+		std::vector<void*> node_seeds_fpga_;
+		std::vector<void*> node_segs_fpga_;
+		std::vector<void*> approx_gpair_fpga_;
+		std::vector<void*> approx_position_fpga_;
+		std::vector<void*> approx_entries_;
+		std::vector<void*> dmat_active_;
+		std::vector<uint32_t> entry_batch_;
+		bool layout_compacted_;
+		size_t layout_rows_;
+		// entries laid out by work node at every level, in dmat_active_
+		bool partition_;
+		// quantile bins scanned instead of the entries, and whether the level got them
+		bool approx_;
+		bool approx_level_;
+		// the first value of every bin of a layout column, and the bin of its sorted entries
+		std::vector<std::vector<float>> approx_cuts_;
+		std::vector<std::vector<uint16_t>> approx_bins_;
+		// the records of a level per request: rows, rows per block and bins per record
+		std::vector<uint32_t> approx_rows_;
+		std::vector<uint32_t> approx_batch_;
+		std::vector<uint32_t> approx_merge_;
+		// the compacted and approx layouts over the budget, as dmat_host_
+		HostLayout active_host_;
+		HostLayout approx_host_;
+		// a layout of the tree is streamed a window of blocks at a time
+		bool stream_;
+		// the feature masks of the level, sliced for the windows of a streamed layout
+		std::vector<std::vector<char>> feat_valid_host_;
+		std::vector<std::vector<char>> feat_mono_host_;
+		std::vector<std::vector<char>> node_fmask_host_;
+		// the device buffers of a window of blocks of a request: its entry ports and the
+		// slices of the feature masks; two of them per request, the windows alternate
+		struct LayoutWindow {
+			std::vector<void*> entries;
+			std::vector<size_t> capacity;
+			void* fvalid{nullptr};
+			void* fdense{nullptr};
+			void* fmono{nullptr};
+			void* nfmask{nullptr};
+		};
+		std::vector<LayoutWindow> windows_;
 		std::vector<int> qexpand_;
+		std::vector<int> qwork_;
 		std::vector<int> node2workindex_;
+		// weight bounds of the nodes, mirroring the ones of the monotone evaluator
+		bool monotone_;
+		std::vector<float> wlower_;
+		std::vector<float> wupper_;
+		// features sampled per node or restricted by interaction constraints
+		bool node_masks_;
+		FeatureInteractionConstraintHost interaction_constraints_;
+		// whole tree grown by the call of the root level, the split records of all
+		// its levels and the first record of the next level
+		bool fused_;
+		std::vector<SplitEntryInAccelRet> fused_splits_;
+		size_t fused_offset_;
 		std::unique_ptr<SplitEvaluator> spliteval_;
 	 private:
 		common::BitMap bitmap_;
@@ -315,12 +1163,19 @@ class DistFpgaMaker : public TreeUpdater {
 		rabit::Reducer<SplitEntryInAccel, SplitEntryInAccel::Reduce> reducer_;
 	 public:
 		// constructor
-		explicit Builder( unsigned nrow, unsigned ncol, unsigned max_rows, unsigned nRequests,
-						  const TrainParam& param, common::Monitor& monitor,
+		explicit Builder( unsigned nrow, unsigned ncol, unsigned max_rows, unsigned nRequests, unsigned nRanges,
+						  const TrainParam& param, const FpgaTrainParam& fparam,
+						  const std::vector<std::vector<float>>& feat_values,
+						  const FeatureBundles& bundles, const SortedColumns& columns,
+						  const HostLayout& dmat_host, const std::vector<std::vector<char>>& fdense_host,
+						  float gscale, const std::vector<int>& row_window, unsigned window_rows,
+						  common::Monitor& monitor, KernelLevelStats& kernel_stats,
 						  const cl_world& world, const std::vector<cl_engine>& engine,
 						  std::unique_ptr<SplitEvaluator> spliteval)
-				: nrows_(nrow), ncols_(ncol), max_rows_(max_rows), nRequests_(nRequests), param_(param),
-				  monitor_(monitor), world_(world), engine_(engine), nthread_(omp_get_max_threads()),
+				: nrows_(nrow), ncols_(ncol), max_rows_(max_rows), nRequests_(nRequests), nRanges_(nRanges), param_(param),
+				  fparam_(fparam), feat_values_(feat_values), bundles_(bundles), columns_(columns),
+				  dmat_host_(dmat_host), fdense_host_(fdense_host), gscale_(gscale),
+				  row_window_(row_window), window_rows_(window_rows), monitor_(monitor), kernel_stats_(kernel_stats), world_(world), engine_(engine), nthread_(omp_get_max_threads()),
 				  spliteval_(std::move(spliteval)) {}	  
 		~Builder()
 		{
@@ -341,11 +1196,47 @@ class DistFpgaMaker : public TreeUpdater {
 					InAccel::free(world_, snode_rg_[req]);
 					snode_rg_[req] = 0;
 				}
+				if(snode_bounds_[req] != 0)
+				{
+					InAccel::free(world_, snode_bounds_[req]);
+					snode_bounds_[req] = 0;
+				}
 				if(feat_valid_fpga_[req] != 0)
 				{
 					InAccel::free(world_, feat_valid_fpga_[req]);
 					feat_valid_fpga_[req] = 0;
 				}
+				if(feat_mono_fpga_[req] != 0)
+				{
+					InAccel::free(world_, feat_mono_fpga_[req]);
+					feat_mono_fpga_[req] = 0;
+				}
+				if(node_fmask_fpga_[req] != 0)
+				{
+					InAccel::free(world_, node_fmask_fpga_[req]);
+					node_fmask_fpga_[req] = 0;
+				}
+				if(node_seeds_fpga_[req] != 0)
+				{
+					InAccel::free(world_, node_seeds_fpga_[req]);
+					node_seeds_fpga_[req] = 0;
+				}
+				if(node_segs_fpga_[req] != 0)
+				{
+					InAccel::free(world_, node_segs_fpga_[req]);
+					node_segs_fpga_[req] = 0;
+				}
+			}
+			this->FreeApproxBuffers();
+			for (auto& window : windows_)
+				this->FreeWindow(&window);
+			for(uint32_t buf = 0; buf<dmat_active_.size(); buf++)
+			{
+				if(dmat_active_[buf] != 0)
+				{
+					InAccel::free(world_, dmat_active_[buf]);
+					dmat_active_[buf] = 0;
+				}
 			}
 		}
 		// update one tree, growing
@@ -353,6 +1244,7 @@ class DistFpgaMaker : public TreeUpdater {
 							const std::vector<void*>& gpair_fpga,
 							DMatrix* p_fmat,
 							const std::vector<void*>& dmat_fpga,
+							const std::vector<void*>& fdense_fpga,
 							const std::vector<uint32_t>& req_cols,
 							RegTree* p_tree) {
 			monitor_.Init("Builder");
@@ -360,35 +1252,40 @@ class DistFpgaMaker : public TreeUpdater {
 			std::vector<int> newnodes;
 			this->InitData(gpair, *p_fmat, *p_tree);
 			this->InitNewNode(qexpand_, gpair, *p_fmat, *p_tree);
+			if (approx_) this->ApproxCuts(gpair, p_fmat);
 			monitor_.Stop("Builder Init");
-			for (int depth = 0; depth < param_.max_depth; ++depth) {
-				monitor_.Start("Builder Create Cubes");
-				this->CreateCubes( depth, *p_tree, req_cols);
-				monitor_.Stop("Builder Create Cubes");
-				monitor_.Start("Builder Find Splits");
-				this->FindSplit( qexpand_, gpair_fpga, dmat_fpga, req_cols, p_tree);
-				monitor_.Stop("Builder Find Splits");
-				monitor_.Start("Builder Update Tree");
-				this->ResetPosition(qexpand_, p_fmat, *p_tree);
-				this->UpdateQueueExpand(*p_tree, qexpand_, &newnodes);
-				this->InitNewNode(newnodes, gpair, *p_fmat, *p_tree);
-				for (auto nid : qexpand_) {
-					if ((*p_tree)[nid].IsLeaf()) {
-						continue;
+			if (param_.grow_policy == TrainParam::kLossGuide) {
+				this->GrowLossguide(gpair, gpair_fpga, p_fmat, dmat_fpga, fdense_fpga, req_cols, p_tree);
+			} else {
+				for (int depth = 0; depth < param_.max_depth; ++depth) {
+					monitor_.Start("Builder Create Cubes");
+					if (fused_ && depth > 0) this->SetFusedWorkNodes(*p_tree);
+					else this->CreateCubes( depth, qexpand_, {}, gpair, p_fmat, *p_tree, req_cols);
+					monitor_.Stop("Builder Create Cubes");
+					monitor_.Start("Builder Find Splits");
+					this->FindSplit( depth, qexpand_, gpair_fpga, dmat_fpga, fdense_fpga, req_cols, p_tree);
+					monitor_.Stop("Builder Find Splits");
+					monitor_.Start("Builder Update Tree");
+					// the rows of a fused tree are moved by the kernel, the updater does not
+					// use their leaf positions
+					if (!fused_) this->ResetPosition(qexpand_, p_fmat, *p_tree);
+					this->UpdateQueueExpand(*p_tree, qexpand_, &newnodes);
+					if (fparam_.fpga_resum_interval > 0 &&
+						(depth + 1) % fparam_.fpga_resum_interval == 0) {
+						this->InitNewNode(newnodes, gpair, *p_fmat, *p_tree);
+					} else {
+						this->InitNewNodeFromSplits(qexpand_, newnodes, *p_tree);
 					}
-					int cleft = (*p_tree)[nid].LeftChild();
-					int cright = (*p_tree)[nid].RightChild();
-					spliteval_->AddSplit(nid, cleft, cright, snode_[nid].best.SplitIndex(),
-										 snode_[cleft].weight, snode_[cright].weight);
+					this->AddSplitConstraints(qexpand_, *p_tree);
+					qexpand_ = newnodes;
+					monitor_.Stop("Builder Update Tree");
+					// if nothing left to be expand, break
+					if (qexpand_.size() == 0) break;
+				}
+				// set all the rest expanding nodes to leaf
+				for (const int nid : qexpand_) {
+					(*p_tree)[nid].SetLeaf(snode_[nid].weight * param_.learning_rate);
 				}
-				qexpand_ = newnodes;
-				monitor_.Stop("Builder Update Tree");
-				// if nothing left to be expand, break
-				if (qexpand_.size() == 0) break;
-			}
-			// set all the rest expanding nodes to leaf
-			for (const int nid : qexpand_) {
-				(*p_tree)[nid].SetLeaf(snode_[nid].weight * param_.learning_rate);
 			}
 			// remember auxiliary statistics in the tree node
 			for (int nid = 0; nid < p_tree->param.num_nodes; ++nid) {
@@ -397,6 +1294,99 @@ class DistFpgaMaker : public TreeUpdater {
 				p_tree->Stat(nid).sum_hess = static_cast<float>(snode_[nid].stats.sum_hess);
 			}
 		}
+		// grow one tree leaf-wise: the nodes with a split wait in a heap by loss change, and
+		// the best ones are expanded together so that one kernel call evaluates all their
+		// children
+		inline void GrowLossguide(const std::vector<GradientPair>& gpair,
+								  const std::vector<void*>& gpair_fpga,
+								  DMatrix* p_fmat,
+								  const std::vector<void*>& dmat_fpga,
+								  const std::vector<void*>& fdense_fpga,
+								  const std::vector<uint32_t>& req_cols,
+								  RegTree* p_tree) {
+			//the children of a batch fill at most the node capacity of the kernel
+			size_t batch = (partition_ ? xgboost_exact::kMaxPartitionNodeNum : xgboost_exact::kMaxNodeNum) / 2;
+			if (fparam_.fpga_lossguide_batch > 0)
+				batch = std::min(batch, static_cast<size_t>(fparam_.fpga_lossguide_batch));
+			std::vector<ExpandEntryInAccel> qheap;
+			uint64_t timestamp = 0;
+			int num_leaves = p_tree->param.num_roots;
+			std::vector<int> qeval = qexpand_;
+			std::vector<int> newnodes;
+			for (int round = 0; ; ++round) {
+				if (qeval.size() > 0) {
+					monitor_.Start("Builder Create Cubes");
+					//the rows of the waiting nodes stay in the layout for later calls
+					std::vector<int> qkeep;
+					for (const auto& e : qheap) qkeep.push_back(e.nid);
+					this->CreateCubes(0, qeval, qkeep, gpair, p_fmat, *p_tree, req_cols);
+					monitor_.Stop("Builder Create Cubes");
+					monitor_.Start("Builder Find Splits");
+					if (qwork_.size() > 0)
+						this->FindSplitInAccel(qwork_, gpair_fpga, dmat_fpga, fdense_fpga, req_cols);
+					monitor_.Stop("Builder Find Splits");
+				}
+				for (int nid : qeval) {
+					if (snode_[nid].best.loss_chg > kRtEps) {
+						qheap.push_back(ExpandEntryInAccel{nid, snode_[nid].best.loss_chg, timestamp++});
+						std::push_heap(qheap.begin(), qheap.end(), ExpandEntryInAccel::Compare);
+					} else {
+						(*p_tree)[nid].SetLeaf(snode_[nid].weight * param_.learning_rate);
+					}
+				}
+				//every expansion adds a leaf
+				qexpand_.clear();
+				while (qheap.size() > 0 && qexpand_.size() < batch &&
+					   (param_.max_leaves == 0 || num_leaves < param_.max_leaves)) {
+					std::pop_heap(qheap.begin(), qheap.end(), ExpandEntryInAccel::Compare);
+					qexpand_.push_back(qheap.back().nid);
+					qheap.pop_back();
+					num_leaves++;
+				}
+				if (qexpand_.size() == 0) break;
+				monitor_.Start("Builder Update Tree");
+				for (int nid : qexpand_) this->ApplySplit(nid, p_tree);
+				this->ResetPosition(qexpand_, p_fmat, *p_tree);
+				this->UpdateQueueExpand(*p_tree, qexpand_, &newnodes);
+				if (fparam_.fpga_resum_interval > 0 &&
+					(round + 1) % fparam_.fpga_resum_interval == 0) {
+					this->InitNewNode(newnodes, gpair, *p_fmat, *p_tree);
+				} else {
+					this->InitNewNodeFromSplits(qexpand_, newnodes, *p_tree);
+				}
+				this->AddSplitConstraints(qexpand_, *p_tree);
+				//children at the depth limit are leaves without an evaluation
+				qeval.clear();
+				for (int nid : newnodes) {
+					if (param_.max_depth > 0 && p_tree->GetDepth(nid) >= param_.max_depth)
+						(*p_tree)[nid].SetLeaf(snode_[nid].weight * param_.learning_rate);
+					else
+						qeval.push_back(nid);
+				}
+				monitor_.Stop("Builder Update Tree");
+			}
+			// set all the waiting nodes to leaf
+			for (const auto& e : qheap) {
+				(*p_tree)[e.nid].SetLeaf(snode_[e.nid].weight * param_.learning_rate);
+			}
+			qexpand_.clear();
+		}
+		// the evaluator, the weight bounds and the interaction constraints of the
+		// children of the expanded nodes
+		inline void AddSplitConstraints(const std::vector<int>& qexpand, const RegTree& tree) {
+			for (auto nid : qexpand) {
+				if (tree[nid].IsLeaf()) {
+					continue;
+				}
+				int cleft = tree[nid].LeftChild();
+				int cright = tree[nid].RightChild();
+				spliteval_->AddSplit(nid, cleft, cright, snode_[nid].best.SplitIndex(),
+									 snode_[cleft].weight, snode_[cright].weight);
+				this->AddWeightBounds(nid, cleft, cright, snode_[nid].best.SplitIndex(),
+									  snode_[cleft].weight, snode_[cright].weight);
+				interaction_constraints_.Split(nid, snode_[nid].best.SplitIndex(), cleft, cright);
+			}
+		}
 		inline void InitData(const std::vector<GradientPair>& gpair, const DMatrix& fmat,
 							 const RegTree& tree) {
 			CHECK_EQ(tree.param.num_nodes, tree.param.num_roots) << "FpgaMaker: can only grow new tree";
@@ -440,17 +1430,86 @@ class DistFpgaMaker : public TreeUpdater {
 			for (int i = 0; i < tree.param.num_roots; ++i) {
 				qexpand_.push_back(i);
 			}
+			// the monotone evaluator is active with at least one constrained feature
+			monotone_ = param_.split_evaluator.find("monotonic") != std::string::npos &&
+					std::any_of(param_.monotone_constraints.begin(), param_.monotone_constraints.end(),
+								[](int c) { return c != 0; });
+			wlower_.assign(tree.param.num_roots, -std::numeric_limits<float>::infinity());
+			wupper_.assign(tree.param.num_roots, std::numeric_limits<float>::infinity());
+			// every node gets its own feature mask when they can differ within a level
+			interaction_constraints_.Configure(param_, ncols_);
+			// the loss guided growth mixes the levels in a call, so it samples the level
+			// features per node too
+			node_masks_ = param_.colsample_bynode < 1.0f || !param_.interaction_constraints.empty() ||
+					(param_.grow_policy == TrainParam::kLossGuide && param_.colsample_bylevel < 1.0f);
+			// the value ranges keep the column layout
+			partition_ = fparam_.fpga_node_partition && nRanges_ == 1;
+			// the records of the bins replace the column layout
+			approx_ = fparam_.fpga_approx && !fparam_.fpga_compact_entries && nRanges_ == 1 && !partition_;
+			// the later layouts of the tree are smaller than the full one, which decides
+			// whether the tree streams
+			stream_ = false;
+			for(uint32_t req = 0; req<nRequests_; req++)
+				stream_ = stream_ || dmat_host_.Streamed(req);
+			active_host_.budget = dmat_host_.budget;
+			active_host_.ports.assign(nRequests_*kEntryPorts, std::vector<char>());
+			approx_host_.budget = dmat_host_.budget;
+			approx_host_.ports.assign(nRequests_*kEntryPorts, std::vector<char>());
+			windows_.resize(2*nRequests_);
+			for (auto& window : windows_) {
+				window.entries.assign(kEntryPorts, nullptr);
+				window.capacity.assign(kEntryPorts, 0);
+			}
+			feat_valid_host_.assign(nRequests_, std::vector<char>());
+			feat_mono_host_.assign(nRequests_, std::vector<char>());
+			node_fmask_host_.assign(nRequests_, std::vector<char>());
+			// the kernel splits the nodes of the next levels by itself when they need
+			// nothing from the host: no weight bounds, feature masks or re-summation
+			fused_ = fparam_.fpga_fused_tree && !partition_ && !approx_ && !stream_ && nRequests_ == 1 && rabit::GetWorldSize() == 1 &&
+					param_.grow_policy != TrainParam::kLossGuide &&
+					!monotone_ && !node_masks_ && param_.colsample_bylevel == 1.0f &&
+					fparam_.fpga_resum_interval == 0 && !bundles_.Bundled() &&
+					ncols_ <= xgboost_exact::kMaxFeatureNum;
+			fused_splits_.clear();
+			fused_offset_ = 0;
 			feat_valid_fpga_.resize(nRequests_);
 			position_fpga_.resize(nRequests_);
 			snode_stats_.resize(nRequests_);
 			snode_rg_.resize(nRequests_);
+			snode_bounds_.resize(nRequests_);
+			feat_mono_fpga_.resize(nRequests_);
+			node_fmask_fpga_.resize(nRequests_);
+			node_seeds_fpga_.resize(nRequests_);
+			node_segs_fpga_.resize(nRequests_);
+			approx_gpair_fpga_.assign(nRequests_, nullptr);
+			approx_position_fpga_.assign(nRequests_, nullptr);
+			approx_entries_.assign(nRequests_*kEntryPorts, nullptr);
+			approx_rows_.assign(nRequests_, 0);
+			approx_batch_.assign(nRequests_, 0);
+			approx_merge_.assign(nRequests_, 1);
+			approx_level_ = false;
 			for(uint32_t req = 0; req<nRequests_; req++)
 			{
 				feat_valid_fpga_[req] = 0;
 				position_fpga_[req] = 0;
 				snode_stats_[req] = 0;
 				snode_rg_[req] = 0;
+				snode_bounds_[req] = 0;
+				feat_mono_fpga_[req] = 0;
+				node_fmask_fpga_[req] = 0;
+				node_seeds_fpga_[req] = 0;
+				node_segs_fpga_[req] = 0;
+			}
+			// the kernel streams the full layout until it is compacted
+			dmat_active_.resize(nRequests_*kEntryPorts);
+			std::fill(dmat_active_.begin(), dmat_active_.end(), nullptr);
+			entry_batch_.resize(nRequests_);
+			for(uint32_t req = 0; req<nRequests_; req++)
+			{
+				entry_batch_[req] = max_rows_;
 			}
+			layout_compacted_ = false;
+			layout_rows_ = nrows_;
 		}
 		inline void InitNewNode(const std::vector<int>& qexpand,
 								const std::vector<GradientPair>& gpair,
@@ -479,7 +1538,48 @@ class DistFpgaMaker : public TreeUpdater {
 				// update node statistics
 				snode_[nid].stats = stats;
 			}
-			// calculating the weights
+			this->InitNodeWeights(qexpand, tree);
+		}
+		// the statistics of the children are already known from the split of their parent,
+		// left_sum is returned by the accelerator and right_sum is derived from the parent
+		inline void InitNewNodeFromSplits(const std::vector<int>& qexpand,
+										  const std::vector<int>& newnodes,
+										  const RegTree& tree) {
+			snode_.resize(tree.param.num_nodes, NodeEntryInAccel());
+			for (int nid : qexpand) {
+				if (tree[nid].IsLeaf()) {
+					continue;
+				}
+				snode_[tree[nid].LeftChild()].stats = snode_[nid].best.left_sum;
+				snode_[tree[nid].RightChild()].stats = snode_[nid].best.right_sum;
+			}
+			this->InitNodeWeights(newnodes, tree);
+		}
+		inline int Monotone(unsigned fid) const {
+			return fid < param_.monotone_constraints.size() ? param_.monotone_constraints[fid] : 0;
+		}
+		// the children of a split on a constrained feature are bounded by the mean of
+		// their weights, as in the monotone evaluator
+		inline void AddWeightBounds(int nid, int cleft, int cright, unsigned fid,
+									float left_weight, float right_weight) {
+			size_t size = std::max(cleft, cright) + 1;
+			if (wlower_.size() < size) {
+				wlower_.resize(size, -std::numeric_limits<float>::infinity());
+				wupper_.resize(size, std::numeric_limits<float>::infinity());
+			}
+			wlower_[cleft] = wlower_[cright] = wlower_[nid];
+			wupper_[cleft] = wupper_[cright] = wupper_[nid];
+			float mid = (left_weight + right_weight) / 2;
+			int constraint = this->Monotone(fid);
+			if (constraint < 0) {
+				wlower_[cleft] = mid;
+				wupper_[cright] = mid;
+			} else if (constraint > 0) {
+				wupper_[cleft] = mid;
+				wlower_[cright] = mid;
+			}
+		}
+		inline void InitNodeWeights(const std::vector<int>& qexpand, const RegTree& tree) {
 			for (int nid : qexpand) {
 				uint32_t parentid = tree[nid].Parent();
 				GradStats nstats(snode_[nid].stats);
@@ -489,14 +1589,38 @@ class DistFpgaMaker : public TreeUpdater {
 						spliteval_->ComputeScore(parentid, nstats, snode_[nid].weight));
 			}
 		}
-		inline void CreateCubes( int depth, const RegTree& tree, const std::vector<uint32_t> &req_cols)
+		// the work nodes of a level of a fused tree: all its nodes, numbered like the
+		// kernel numbers the children of the previous level
+		inline void SetFusedWorkNodes(const RegTree& tree) {
+			qwork_ = qexpand_;
+			node2workindex_.resize(tree.param.num_nodes);
+			std::fill(node2workindex_.begin(), node2workindex_.end(), -1);
+			for (size_t i = 0; i < qwork_.size(); ++i)
+				node2workindex_[qwork_[i]] = static_cast<int>(i);
+		}
+		// pack the nodes of qexpand that can be split into the work nodes of a kernel call;
+		// the rows of the nodes in qkeep are left out of the call but kept in the layout
+		inline void CreateCubes( int depth, const std::vector<int> &qexpand,
+								 const std::vector<int> &qkeep, const std::vector<GradientPair>& gpair,
+								 DMatrix* p_fmat, const RegTree& tree, const std::vector<uint32_t> &req_cols)
 		{
 			//node cube creation
-			//create node2workindex vector, which maps new nodes to positions [0,new_nodes_num)
+			//count the active rows of each node
+			std::vector<uint32_t> node_rows(tree.param.num_nodes, 0);
+			for (size_t i = 0; i < position_.size(); i++)
+				if (position_[i] >= 0) node_rows[position_[i]]++;
+			//only nodes that can produce a valid split are sent to the kernel, nodes with
+			//a single row or a total hessian below 2*min_child_weight are made leaves on the host
+			qwork_.clear();
+			for (int nid : qexpand)
+				if (node_rows[nid] > 1 && snode_[nid].stats.sum_hess >= 2*param_.min_child_weight)
+					qwork_.push_back(nid);
+			//create node2workindex vector, which maps work nodes to positions [0,work_nodes_num)
+			//the rows of the filtered nodes keep position -1 and are skipped by the kernel
 			node2workindex_.resize(tree.param.num_nodes);
 			std::fill(node2workindex_.begin(), node2workindex_.end(), -1);
-			for (size_t i = 0; i < qexpand_.size(); ++i)
-				node2workindex_[qexpand_[i]] = static_cast<int>(i);
+			for (size_t i = 0; i < qwork_.size(); ++i)
+				node2workindex_[qwork_[i]] = static_cast<int>(i);
 			//create position_fpga_ cube with nrow size, that contains the work index of each entry
 			//allign to 32 int16_t (32*2B = 64B)
 			size_t position_fpga_size = position_.size() + (((position_.size()%8)>0)?(8 - (position_.size()%8)):0);
@@ -506,44 +1630,125 @@ class DistFpgaMaker : public TreeUpdater {
 			for (size_t i =0; i<position_.size(); i++)
 				if(position_[i] >= 0) //if position is active get work idx
 					position_fpga_tmp[i] = node2workindex_[position_[i]];
+			approx_level_ = false;
+			if (approx_) {
+				monitor_.Start("Builder Approx Layout");
+				approx_level_ = this->ApproxLayout(gpair, p_fmat, req_cols, position_fpga_tmp.data());
+				monitor_.Stop("Builder Approx Layout");
+			}
+			//compact the device layout when enough rows became inactive, or to the rows of
+			//a goss sample before the first call; a partitioned layout only holds the rows
+			//of the work nodes, the records of the bins replace it
+			const bool window_layout = !row_window_.empty() && !layout_compacted_;
+			if ((fparam_.fpga_compact_threshold > 0.0f || window_layout) && !partition_ && !approx_level_) {
+				std::vector<short int> row_keep(position_fpga_tmp.begin(), position_fpga_tmp.end());
+				if (qkeep.size() > 0) {
+					std::vector<char> keep_node(tree.param.num_nodes, 0);
+					for (int nid : qkeep) keep_node[nid] = 1;
+					for (size_t i = 0; i < position_.size(); i++)
+						if (position_[i] >= 0 && keep_node[position_[i]]) row_keep[i] = 0;
+				}
+				size_t nactive = std::count_if(row_keep.begin(), row_keep.end(),
+											   [](short int pos) { return pos >= 0; });
+				if (window_layout || nactive < fparam_.fpga_compact_threshold * layout_rows_) {
+					monitor_.Start("Builder Compact Layout");
+					this->CompactLayout(p_fmat, req_cols, row_keep.data());
+					layout_rows_ = nactive;
+					monitor_.Stop("Builder Compact Layout");
+				}
+			}
 			//allign to 8 GradStats (8*8B = 64B)
-			size_t snode_stats_size = qexpand_.size() + (((qexpand_.size()%8)>0)?(8 - (qexpand_.size()%8)):0);
+			size_t snode_stats_size = qwork_.size() + (((qwork_.size()%8)>0)?(8 - (qwork_.size()%8)):0);
 			std::vector<GradStatsInAccel> snode_stats_tmp;
 			snode_stats_tmp.resize(snode_stats_size); //allocate memory to create cube
 			//allign to 16 floats (16*4B = 64B)
-			size_t snode_rg_size = qexpand_.size() + (((qexpand_.size()%8)>0)?(8 - (qexpand_.size()%8)):0);
+			size_t snode_rg_size = qwork_.size() + (((qwork_.size()%8)>0)?(8 - (qwork_.size()%8)):0);
 			std::vector<float> snode_rg_tmp;
 			snode_rg_tmp.resize(snode_rg_size);
-			for (size_t i = 0; i < qexpand_.size(); ++i)
+			//node weight bounds: the lower bounds of 8 nodes, then their upper bounds,
+			//clamped to the range of the fixed point weights
+			const float wlimit = std::ldexp(1.0f, xgboost_exact::kAccumInt - 2);
+			std::vector<float> snode_bounds_tmp((snode_stats_size/8)*16);
+			for (size_t i = 0; i < qwork_.size(); ++i)
 			{
-				snode_stats_tmp[i] = snode_[qexpand_[i]].stats;
-				snode_rg_tmp[i] = snode_[qexpand_[i]].root_gain;
+				snode_stats_tmp[i].sum_grad = snode_[qwork_[i]].stats.sum_grad * gscale_;
+				snode_stats_tmp[i].sum_hess = snode_[qwork_[i]].stats.sum_hess * gscale_;
+				snode_rg_tmp[i] = snode_[qwork_[i]].root_gain * gscale_;
+				snode_bounds_tmp[(i/8)*16 + i%8] = std::max(wlower_[qwork_[i]], -wlimit);
+				snode_bounds_tmp[(i/8)*16 + 8 + i%8] = std::min(wupper_[qwork_[i]], wlimit);
 			}
 			//feature cube creation
-			//get valid features
-			auto feat_set = column_sampler_.GetFeatureSet(depth);
 			//create vectors with 1 in each valid feature pos and 0 in each invalid feature pos
 			std::vector<std::vector<char>> feat_valid_fpga_tmp;
 			feat_valid_fpga_tmp.resize(nRequests_);
 			for(uint32_t req = 0; req<nRequests_; req++)
 			{
-				uint32_t nfeatures_req = req_cols[req+1] - req_cols[req];
-				uint32_t fsize = nfeatures_req/8 + ((nfeatures_req%8>0)?1:0);
+				uint32_t nfeatures_req = req_cols[req/nRanges_+1] - req_cols[req/nRanges_];
+				//one bit per feature, kLanes bits per block
+				uint32_t fsize = BlockCount(nfeatures_req)*kLanes/8;
 				feat_valid_fpga_tmp[req].resize(fsize);
 				std::fill(feat_valid_fpga_tmp[req].begin(),feat_valid_fpga_tmp[req].end(),0);
 			}
-			for(uint32_t fid : feat_set->HostVector())
+			//with per node masks every work node samples its own features, restricted to the
+			//ones its interaction constraints allow, and the level mask is their union; the
+			//mask of work node i in block b is word b*qwork_.size()+i
+			std::vector<std::vector<char>> node_fmask_tmp(nRequests_);
+			std::vector<std::shared_ptr<HostDeviceVector<int>>> feat_sets;
+			if (node_masks_) {
+				for(uint32_t req = 0; req<nRequests_; req++)
+				{
+					uint32_t nfeatures_req = req_cols[req/nRanges_+1] - req_cols[req/nRanges_];
+					node_fmask_tmp[req].assign(BlockCount(nfeatures_req)*qwork_.size()*kLanes/8, 0);
+				}
+				for (size_t i = 0; i < qwork_.size(); ++i)
+					feat_sets.push_back(column_sampler_.GetFeatureSet(tree.GetDepth(qwork_[i])));
+			} else {
+				feat_sets.push_back(column_sampler_.GetFeatureSet(depth));
+			}
+			for (size_t i = 0; i < feat_sets.size(); ++i)
 			{
-				//calculate which req this fid belongs to
-				uint32_t req = 0;
-				while (fid >= req_cols[req+1]) req++;
-				//shift the fid to this req's range
-				uint32_t fid_shifted = fid - req_cols[req];
-				//calculate which block to access
-				uint32_t block = fid_shifted/8;
-				//calculate the position inside the block
-				uint32_t block_offset = fid_shifted%8;
-				feat_valid_fpga_tmp[req][block] |= (1<<block_offset);
+				for(uint32_t fid : feat_sets[i]->HostVector())
+				{
+					if (node_masks_ && !interaction_constraints_.Query(qwork_[i], fid)) continue;
+					//the layout column of the feature, shared by the features of a bundle
+					uint32_t col = bundles_.col_of[fid];
+					//calculate which part this column belongs to, the masks of its first range
+					//are copied to the others
+					uint32_t part = 0;
+					while (col >= req_cols[part+1]) part++;
+					uint32_t req = part*nRanges_;
+					//shift the column to this req's range
+					uint32_t fid_shifted = col - req_cols[part];
+					//calculate which block to access
+					uint32_t block = fid_shifted/8;
+					//calculate the position inside the block
+					uint32_t block_offset = fid_shifted%8;
+					feat_valid_fpga_tmp[req][block] |= (1<<block_offset);
+					if (node_masks_) {
+						size_t word = (fid_shifted/kLanes)*qwork_.size() + i;
+						node_fmask_tmp[req][word*kLanes/8 + (fid_shifted%kLanes)/8] |= (1<<block_offset);
+					}
+				}
+			}
+			for(uint32_t req = 0; req<nRequests_; req++)
+			{
+				if (req%nRanges_ == 0) continue;
+				feat_valid_fpga_tmp[req] = feat_valid_fpga_tmp[req - req%nRanges_];
+				node_fmask_tmp[req] = node_fmask_tmp[req - req%nRanges_];
+			}
+			std::vector<std::vector<uint64_t>> node_seeds_tmp;
+			if (nRanges_ > 1) node_seeds_tmp = this->RangeSeeds(gpair, p_fmat, position_fpga_tmp.data(), req_cols);
+			if (partition_) {
+				monitor_.Start("Builder Partition Layout");
+				this->PartitionLayout(p_fmat, req_cols, position_fpga_tmp.data(), feat_valid_fpga_tmp, node_fmask_tmp);
+				monitor_.Stop("Builder Partition Layout");
+			}
+			//the device positions of a goss sample follow its rows
+			if (!row_window_.empty()) {
+				std::vector<short int> position_window(window_rows_ + (((window_rows_%8)>0)?(8 - (window_rows_%8)):0), -1);
+				for (size_t i = 0; i < position_.size(); i++)
+					if (row_window_[i] >= 0) position_window[row_window_[i]] = position_fpga_tmp[i];
+				position_fpga_tmp.swap(position_window);
 			}
 			for(uint32_t req = 0; req<nRequests_; req++)
 			{
@@ -576,6 +1781,36 @@ class DistFpgaMaker : public TreeUpdater {
 				InAccel::memcpy_to(world_, snode_rg_[req], 0, snode_rg_tmp.data(),
 								   snode_rg_tmp.size()*sizeof(float));
 
+				if(snode_bounds_[req] != 0)
+				{
+					InAccel::free(world_, snode_bounds_[req]);
+					snode_bounds_[req] = 0;
+				}
+				snode_bounds_[req] = InAccel::malloc(world_, snode_bounds_tmp.size()*sizeof(float), req);
+				InAccel::memcpy_to(world_, snode_bounds_[req], 0, snode_bounds_tmp.data(),
+								   snode_bounds_tmp.size()*sizeof(float));
+
+				//monotone directions or the bundle code, 2 bits per layout column, set once per tree
+				if(feat_mono_fpga_[req] == 0)
+				{
+					uint32_t nfeatures_req = req_cols[req/nRanges_+1] - req_cols[req/nRanges_];
+					std::vector<char> mono_tmp(BlockCount(nfeatures_req)*kLanes/4, 0);
+					for (uint32_t f = 0; f < nfeatures_req; f++) {
+						uint32_t col = req_cols[req/nRanges_] + f;
+						if (bundles_.IsBundle(col)) {
+							mono_tmp[f/4] |= xgboost_exact::kMonoBundle << (2*(f%4));
+							continue;
+						}
+						int constraint = monotone_ ? this->Monotone(bundles_.cols[col][0]) : 0;
+						if (constraint != 0)
+							mono_tmp[f/4] |= (constraint > 0 ? xgboost_exact::kMonoInc : xgboost_exact::kMonoDec) << (2*(f%4));
+					}
+					feat_mono_fpga_[req] = InAccel::malloc(world_, mono_tmp.size()*sizeof(char), req);
+					InAccel::memcpy_to(world_, feat_mono_fpga_[req], 0, mono_tmp.data(),
+									   mono_tmp.size()*sizeof(char));
+					if (stream_) feat_mono_host_[req].swap(mono_tmp);
+				}
+
 				if(feat_valid_fpga_[req] != 0)
 				{
 					InAccel::free(world_, feat_valid_fpga_[req]);
@@ -585,80 +1820,743 @@ class DistFpgaMaker : public TreeUpdater {
 										feat_valid_fpga_tmp[req].size()*sizeof(char), req);
 				InAccel::memcpy_to(world_, feat_valid_fpga_[req], 0, feat_valid_fpga_tmp[req].data(),
 								   feat_valid_fpga_tmp[req].size()*sizeof(char));
+
+				if(node_fmask_fpga_[req] != 0)
+				{
+					InAccel::free(world_, node_fmask_fpga_[req]);
+					node_fmask_fpga_[req] = 0;
+				}
+				if (node_masks_) {
+					node_fmask_fpga_[req] = InAccel::malloc(world_,
+											node_fmask_tmp[req].size()*sizeof(char), req);
+					InAccel::memcpy_to(world_, node_fmask_fpga_[req], 0, node_fmask_tmp[req].data(),
+									   node_fmask_tmp[req].size()*sizeof(char));
+				}
+				//the windows of a streamed layout get slices of the masks
+				if (stream_) {
+					feat_valid_host_[req].swap(feat_valid_fpga_tmp[req]);
+					node_fmask_host_[req].swap(node_fmask_tmp[req]);
+				}
+
+				if(node_seeds_fpga_[req] != 0)
+				{
+					InAccel::free(world_, node_seeds_fpga_[req]);
+					node_seeds_fpga_[req] = 0;
+				}
+				if (nRanges_ > 1) {
+					node_seeds_fpga_[req] = InAccel::malloc(world_,
+											node_seeds_tmp[req].size()*sizeof(uint64_t), req);
+					InAccel::memcpy_to(world_, node_seeds_fpga_[req], 0, node_seeds_tmp[req].data(),
+									   node_seeds_tmp[req].size()*sizeof(uint64_t));
+				}
+			}
+		}
+		// the scan state of every work node at the start of the value range of each request,
+		// 4 64-bit words per node and lane, the nodes of a block after each other: the
+		// scaled sums of its entries before the range, the sums of its entries from the
+		// range on, and the last value before the range with a flag for a node that has one
+		inline std::vector<std::vector<uint64_t>> RangeSeeds(const std::vector<GradientPair>& gpair,
+				DMatrix* p_fmat, const short int* position,
+				const std::vector<uint32_t> &req_cols) {
+			const size_t nwork = qwork_.size();
+			std::vector<std::vector<uint64_t>> seeds(nRequests_);
+			for(uint32_t req = 0; req<nRequests_; req++)
+			{
+				uint32_t nfeatures_req = req_cols[req/nRanges_+1] - req_cols[req/nRanges_];
+				seeds[req].assign(BlockCount(nfeatures_req)*nwork*kLanes*4, 0);
+			}
+			for (const auto &batch : columns_) {
+				for (uint32_t part = 0; part < nRequests_/nRanges_; part++) {
+					#pragma omp parallel for schedule(dynamic)
+					for (uint32_t cidx = req_cols[part]; cidx < req_cols[part+1]; cidx++) {
+						auto col = batch[cidx];
+						const auto ndata = static_cast<uint32_t>(col.size());
+						std::vector<GradStats> total(nwork), prefix(nwork);
+						for (uint32_t j = 0; j < ndata; j++)
+							if (position[col[j].index] >= 0) total[position[col[j].index]].Add(gpair[col[j].index]);
+						std::vector<uint64_t> prev(nwork, 0);
+						uint32_t j = 0;
+						for (uint32_t range = 0; range < nRanges_; range++) {
+							for (; j < RangeBegin(ndata, range, nRanges_); j++) {
+								int w = position[col[j].index];
+								if (w < 0) continue;
+								prefix[w].Add(gpair[col[j].index]);
+								prev[w] = this->ValueBits(cidx, col[j].fvalue) | (1ULL << 32);
+							}
+							auto f = cidx - req_cols[part];
+							uint64_t* seed = seeds[part*nRanges_ + range].data() +
+									((f/kLanes)*nwork*kLanes + f%kLanes)*4;
+							for (size_t i = 0; i < nwork; i++, seed += kLanes*4) {
+								GradStatsInAccel fw(prefix[i].sum_grad * gscale_, prefix[i].sum_hess * gscale_);
+								GradStatsInAccel bw((total[i].sum_grad - prefix[i].sum_grad) * gscale_,
+													(total[i].sum_hess - prefix[i].sum_hess) * gscale_);
+								std::memcpy(&seed[0], &fw, sizeof(fw));
+								std::memcpy(&seed[1], &bw, sizeof(bw));
+								seed[2] = prev[i];
+							}
+						}
+					}
+				}
+			}
+			return seeds;
+		}
+		// a value as the kernel compares it: the float bits, or its rank for compact entries
+		inline uint32_t ValueBits(uint32_t fid, float fvalue) const {
+			uint32_t bits;
+			if (fparam_.fpga_compact_entries) {
+				const auto& values = feat_values_[fid];
+				bits = static_cast<uint32_t>(std::lower_bound(values.begin(), values.end(), fvalue) - values.begin());
+			} else {
+				std::memcpy(&bits, &fvalue, sizeof(bits));
+			}
+			return bits;
+		}
+		// an entry as the device sees it, with the row of the goss sample
+		inline Entry WindowEntry(Entry e) const {
+			if (!row_window_.empty()) e.index = row_window_[e.index];
+			return e;
+		}
+		// rebuild the column layout of the device with the entries of the active rows only,
+		// so that the kernel no longer streams rows of finished leaves or subsampled rows
+		inline void CompactLayout(DMatrix* p_fmat, const std::vector<uint32_t> &req_cols,
+								  const short int* position) {
+			Entry invalid;
+			invalid.fvalue = 0;
+			invalid.index = -1;
+			for(uint32_t req = 0; req<nRequests_; req++)
+			{
+				auto range = req%nRanges_;
+				auto ncol_req = req_cols[req/nRanges_+1] - req_cols[req/nRanges_];
+				auto ncol_mlt = BlockCount(ncol_req);
+				//count the active entries of each column
+				std::vector<uint32_t> col_rows(ncol_req, 0);
+				for (const auto &batch : columns_) {
+					#pragma omp parallel for schedule(static)
+					for (uint32_t cidx = req_cols[req/nRanges_]; cidx < req_cols[req/nRanges_+1]; cidx++) {
+						auto col = bundles_.Column(batch, cidx);
+						const auto ndata = static_cast<uint32_t>(col.size());
+						for (uint32_t j = RangeBegin(ndata, range, nRanges_); j < RangeBegin(ndata, range+1, nRanges_); j++)
+							if (position[col[j].index] >= 0) col_rows[cidx-req_cols[req/nRanges_]]++;
+					}
+				}
+				uint32_t batch_rows = 1;
+				for (auto rows : col_rows)
+					if (rows > batch_rows) batch_rows = rows;
+				auto nrow_mlt = batch_rows*kLanes;
+				std::vector<Entry> dmat_active_tmp;
+				dmat_active_tmp.resize(ncol_mlt*nrow_mlt);
+				std::fill(dmat_active_tmp.begin(),dmat_active_tmp.end(),invalid);
+				//keep the column order, skipping the inactive entries
+				std::fill(col_rows.begin(), col_rows.end(), 0);
+				for (const auto &batch : columns_) {
+					#pragma omp parallel for schedule(static)
+					for (uint32_t cidx = req_cols[req/nRanges_]; cidx < req_cols[req/nRanges_+1]; cidx++) {
+						auto col = bundles_.Column(batch, cidx);
+						auto rblock_idx = (cidx-req_cols[req/nRanges_])%kLanes;
+						auto ncidx = (cidx-req_cols[req/nRanges_])/kLanes;
+						uint32_t& ridx = col_rows[cidx-req_cols[req/nRanges_]];
+						const auto ndata = static_cast<uint32_t>(col.size());
+						for (uint32_t j = RangeBegin(ndata, range, nRanges_); j < RangeBegin(ndata, range+1, nRanges_); j++) {
+							const Entry e = col[j];
+							if (position[e.index] < 0) continue;
+							dmat_active_tmp[ncidx*nrow_mlt + ridx*kLanes + rblock_idx] = this->WindowEntry(e);
+							ridx++;
+						}
+					}
+				}
+				for(uint32_t port = 0; port<kEntryPorts; port++)
+				{
+					auto buf = port*nRequests_ + req;
+					if(dmat_active_[buf] != 0)
+					{
+						InAccel::free(world_, dmat_active_[buf]);
+						dmat_active_[buf] = 0;
+					}
+				}
+				UploadLayout(world_, dmat_active_tmp, batch_rows, req_cols[req/nRanges_],
+							 fparam_.fpga_compact_entries, feat_values_, nRequests_, req, &dmat_active_,
+							 nullptr, &active_host_);
+				entry_batch_[req] = batch_rows;
+			}
+			layout_compacted_ = true;
+		}
+		// weighted quantile bins of every layout column over the active rows of the tree,
+		// by hessian as in the approx tree method: a bin closes at the first value change
+		// after its share of the hessian, at most max_bin bins per column. The sorted
+		// columns give the exact quantiles, without a sketch
+		inline void ApproxCuts(const std::vector<GradientPair>& gpair, DMatrix* p_fmat) {
+			const auto ncol_layout = static_cast<uint32_t>(bundles_.cols.size());
+			const auto nbins = static_cast<size_t>(std::max(1, std::min(param_.max_bin,
+					1 << (xgboost_exact::kAccumInt - 2))));
+			approx_cuts_.assign(ncol_layout, std::vector<float>());
+			approx_bins_.assign(ncol_layout, std::vector<uint16_t>());
+			for (const auto &batch : columns_) {
+				#pragma omp parallel for schedule(dynamic)
+				for (uint32_t cidx = 0; cidx < ncol_layout; cidx++) {
+					auto col = bundles_.Column(batch, cidx);
+					const auto ndata = static_cast<uint32_t>(col.size());
+					double total = 0.0, acc = 0.0;
+					for (uint32_t j = 0; j < ndata; j++)
+						if (position_[col[j].index] >= 0) total += gpair[col[j].index].GetHess();
+					auto& cuts = approx_cuts_[cidx];
+					auto& bins = approx_bins_[cidx];
+					bins.resize(ndata);
+					for (uint32_t j = 0; j < ndata; j++) {
+						if (j == 0 || (col[j].fvalue != col[j-1].fvalue && cuts.size() < nbins &&
+									   acc >= total * cuts.size() / nbins))
+							cuts.push_back(col[j].fvalue);
+						bins[j] = static_cast<uint16_t>(cuts.size() - 1);
+						if (position_[col[j].index] >= 0) acc += gpair[col[j].index].GetHess();
+					}
+				}
+			}
+		}
+		// aggregate the entries of every request into a record per work node and bin of
+		// each column: a virtual row with the summed gradients of its rows, whose entry
+		// holds the bin as value. Adjacent bins are merged until the virtual rows of a
+		// request fit the kernel; false, with the exact layout left for the level, when
+		// they only fit with a feature of several bins left a single bin
+		inline bool ApproxLayout(const std::vector<GradientPair>& gpair, DMatrix* p_fmat,
+								 const std::vector<uint32_t> &req_cols, const short int* position) {
+			const size_t nwork = qwork_.size();
+			std::vector<std::vector<uint32_t>> col_rows(nRequests_);
+			for (const auto &batch : columns_) {
+				for(uint32_t req = 0; req<nRequests_; req++)
+				{
+					auto col_begin = req_cols[req];
+					auto ncol_req = req_cols[req+1] - col_begin;
+					uint32_t min_bins = 0;
+					for (uint32_t f = 0; f < ncol_req; f++) {
+						auto nbins = static_cast<uint32_t>(approx_cuts_[col_begin + f].size());
+						if (nbins > 1 && (min_bins == 0 || nbins < min_bins)) min_bins = nbins;
+					}
+					//col_rows keeps the records of the last merge counted, the one returned
+					approx_merge_[req] = xgboost_exact::ApproxMerge(std::max(min_bins, 1U), [&](uint32_t merge) {
+						col_rows[req].assign(ncol_req, 0);
+						#pragma omp parallel for schedule(dynamic)
+						for (uint32_t f = 0; f < ncol_req; f++) {
+							auto col = bundles_.Column(batch, col_begin + f);
+							const auto& bins = approx_bins_[col_begin + f];
+							std::vector<int> last(nwork, -1);
+							for (uint32_t j = 0; j < col.size(); j++) {
+								int w = position[col[j].index];
+								if (w < 0 || last[w] == static_cast<int>(bins[j]/merge)) continue;
+								last[w] = bins[j]/merge;
+								col_rows[req][f]++;
+							}
+						}
+						uint64_t rows = 0;
+						for (auto n : col_rows[req]) rows += n;
+						return rows;
+					});
+					if (approx_merge_[req] == 0) return false;
+				}
+			}
+			Entry invalid;
+			invalid.fvalue = 0;
+			invalid.index = -1;
+			this->FreeApproxBuffers();
+			for (const auto &batch : columns_) {
+				for(uint32_t req = 0; req<nRequests_; req++)
+				{
+					auto col_begin = req_cols[req];
+					auto ncol_req = req_cols[req+1] - col_begin;
+					auto ncol_mlt = BlockCount(ncol_req);
+					const uint32_t merge = approx_merge_[req];
+					std::vector<uint32_t> row_begin(ncol_req+1, 0);
+					for (uint32_t f = 0; f < ncol_req; f++) row_begin[f+1] = row_begin[f] + col_rows[req][f];
+					uint32_t batch_rows = 1;
+					for (auto rows : col_rows[req])
+						if (rows > batch_rows) batch_rows = rows;
+					uint32_t vrows = row_begin[ncol_req];
+					std::vector<GradStats> vsum(vrows);
+					//allign to 8 rows
+					std::vector<short int> vposition(vrows + (((vrows%8)>0)?(8 - (vrows%8)):0), -1);
+					std::vector<Entry> layout(ncol_mlt*batch_rows*kLanes, invalid);
+					#pragma omp parallel for schedule(dynamic)
+					for (uint32_t f = 0; f < ncol_req; f++) {
+						auto col = bundles_.Column(batch, col_begin + f);
+						const auto& bins = approx_bins_[col_begin + f];
+						std::vector<int> last(nwork, -1);
+						std::vector<uint32_t> vrow(nwork, 0);
+						uint32_t v = row_begin[f];
+						for (uint32_t j = 0; j < col.size(); j++) {
+							int w = position[col[j].index];
+							if (w < 0) continue;
+							if (last[w] != static_cast<int>(bins[j]/merge)) {
+								last[w] = bins[j]/merge;
+								vrow[w] = v;
+								vposition[v] = static_cast<short int>(w);
+								Entry& e = layout[((f/kLanes)*batch_rows + v - row_begin[f])*kLanes + f%kLanes];
+								e.index = v++;
+								e.fvalue = static_cast<float>(last[w]);
+							}
+							vsum[vrow[w]].Add(gpair[col[j].index]);
+						}
+					}
+					std::vector<GradientPair> vgpair(vposition.size());
+					for (uint32_t v = 0; v < vrows; v++)
+						vgpair[v] = GradientPair(vsum[v].sum_grad * gscale_, vsum[v].sum_hess * gscale_);
+					approx_gpair_fpga_[req] = InAccel::malloc(world_, vgpair.size()*sizeof(GradientPair), req);
+					InAccel::memcpy_to(world_, approx_gpair_fpga_[req], 0, vgpair.data(), vgpair.size()*sizeof(GradientPair));
+					approx_position_fpga_[req] = InAccel::malloc(world_, vposition.size()*sizeof(short int), req);
+					InAccel::memcpy_to(world_, approx_position_fpga_[req], 0, vposition.data(),
+									   vposition.size()*sizeof(short int));
+					UploadLayout(world_, layout, batch_rows, col_begin, false, feat_values_, nRequests_, req,
+								 &approx_entries_, nullptr, &approx_host_);
+					approx_rows_[req] = vrows;
+					approx_batch_[req] = batch_rows;
+				}
+			}
+			return true;
+		}
+		inline void FreeApproxBuffers() {
+			for(uint32_t req = 0; req<approx_gpair_fpga_.size(); req++)
+			{
+				if(approx_gpair_fpga_[req] != 0)
+				{
+					InAccel::free(world_, approx_gpair_fpga_[req]);
+					approx_gpair_fpga_[req] = 0;
+				}
+				if(approx_position_fpga_[req] != 0)
+				{
+					InAccel::free(world_, approx_position_fpga_[req]);
+					approx_position_fpga_[req] = 0;
+				}
+			}
+			for(uint32_t buf = 0; buf<approx_entries_.size(); buf++)
+			{
+				if(approx_entries_[buf] != 0)
+				{
+					InAccel::free(world_, approx_entries_[buf]);
+					approx_entries_[buf] = 0;
+				}
+			}
+		}
+		// the threshold of a split on the aggregated entries: the first value of the bin
+		// past the midpoint of the two bins of the kernel, or of the first bin for the
+		// split below all the present values
+		inline float ApproxSplitValue(const SplitEntryInAccelRet& split, uint32_t offset, uint32_t merge) const {
+			const uint32_t c = (split.sindex & 0x7fffffff) + offset;
+			if (c >= approx_cuts_.size() || approx_cuts_[c].empty()) return 0.0f;
+			const auto& cuts = approx_cuts_[c];
+			int64_t bin = (static_cast<int64_t>(std::floor(split.split_value)) + 1) * merge;
+			bin = std::min(std::max(bin, int64_t(0)), static_cast<int64_t>(cuts.size()) - 1);
+			return cuts[bin];
+		}
+		// lay the entries of the work nodes out by node, like the data partition of a
+		// histogram updater: the segments of the blocks of work node 0, then of work
+		// node 1..., each with the entries of the node in every lane in column order and
+		// as many rows as its longest lane among the features the node scans (even for
+		// compact entries); node_segs_fpga_ gets the first row of every segment and the
+		// end of the last one
+		inline void PartitionLayout(DMatrix* p_fmat, const std::vector<uint32_t> &req_cols,
+									const short int* position,
+									const std::vector<std::vector<char>>& feat_valid,
+									const std::vector<std::vector<char>>& node_fmask) {
+			const size_t nwork = qwork_.size();
+			Entry invalid;
+			invalid.fvalue = 0;
+			invalid.index = -1;
+			for(uint32_t req = 0; req<nRequests_; req++)
+			{
+				auto col_begin = req_cols[req];
+				auto ncol_req = req_cols[req+1] - col_begin;
+				auto ncol_mlt = BlockCount(ncol_req);
+				std::vector<uint32_t> segs = this->NodeSegments(p_fmat, col_begin, ncol_req, position,
+																feat_valid[req], node_fmask[req]);
+				uint32_t batch_rows = std::max(segs.back(), 2U);
+				std::vector<uint32_t> row_block(batch_rows, 0);
+				for (size_t k = 0; k < nwork*ncol_mlt; k++)
+					std::fill(row_block.begin() + segs[k], row_block.begin() + segs[k+1], k%ncol_mlt);
+				std::vector<Entry> dmat_active_tmp(batch_rows*kLanes, invalid);
+				for (const auto &batch : columns_) {
+					#pragma omp parallel for schedule(dynamic)
+					for (uint32_t f = 0; f < ncol_req; f++) {
+						auto col = batch[col_begin + f];
+						const auto ndata = static_cast<uint32_t>(col.size());
+						std::vector<uint32_t> cursor(nwork, 0);
+						for (uint32_t j = 0; j < ndata; j++) {
+							int w = position[col[j].index];
+							if (w < 0 || !this->NodeScans(feat_valid[req], node_fmask[req], f, w)) continue;
+							dmat_active_tmp[(segs[w*ncol_mlt + f/kLanes] + cursor[w]++)*kLanes + f%kLanes] = this->WindowEntry(col[j]);
+						}
+					}
+				}
+				for(uint32_t port = 0; port<kEntryPorts; port++)
+				{
+					auto buf = port*nRequests_ + req;
+					if(dmat_active_[buf] != 0)
+					{
+						InAccel::free(world_, dmat_active_[buf]);
+						dmat_active_[buf] = 0;
+					}
+				}
+				UploadLayout(world_, dmat_active_tmp, batch_rows, col_begin, fparam_.fpga_compact_entries,
+							 feat_values_, nRequests_, req, &dmat_active_, &row_block);
+				entry_batch_[req] = batch_rows;
+				if(node_segs_fpga_[req] != 0)
+				{
+					InAccel::free(world_, node_segs_fpga_[req]);
+					node_segs_fpga_[req] = 0;
+				}
+				node_segs_fpga_[req] = InAccel::malloc(world_, segs.size()*sizeof(uint32_t), req);
+				InAccel::memcpy_to(world_, node_segs_fpga_[req], 0, segs.data(), segs.size()*sizeof(uint32_t));
+			}
+			layout_compacted_ = true;
+		}
+		// whether work node i scans feature f of a request, by the feature masks of CreateCubes
+		inline bool NodeScans(const std::vector<char>& feat_valid, const std::vector<char>& node_fmask,
+							  uint32_t f, size_t i) const {
+			if (((feat_valid[f/8] >> (f%8)) & 1) == 0) return false;
+			return !node_masks_ ||
+					((node_fmask[((f/kLanes)*qwork_.size() + i)*kLanes/8 + (f%kLanes)/8] >> (f%8)) & 1) != 0;
+		}
+		// the first row of the segment of every work node and block of a request, and the
+		// end of the last one
+		inline std::vector<uint32_t> NodeSegments(DMatrix* p_fmat, uint32_t col_begin, uint32_t ncol_req,
+												  const short int* position,
+												  const std::vector<char>& feat_valid,
+												  const std::vector<char>& node_fmask) {
+			const size_t nwork = qwork_.size();
+			auto ncol_mlt = BlockCount(ncol_req);
+			std::vector<uint32_t> seg_rows(nwork*ncol_mlt, 0);
+			for (const auto &batch : columns_) {
+				#pragma omp parallel for schedule(dynamic)
+				for (uint32_t b = 0; b < ncol_mlt; b++) {
+					std::vector<uint32_t> count(nwork);
+					for (uint32_t f = b*kLanes; f < std::min((b+1)*kLanes, ncol_req); f++) {
+						std::fill(count.begin(), count.end(), 0);
+						auto col = batch[col_begin + f];
+						const auto ndata = static_cast<uint32_t>(col.size());
+						for (uint32_t j = 0; j < ndata; j++)
+							if (position[col[j].index] >= 0) count[position[col[j].index]]++;
+						for (size_t i = 0; i < nwork; i++)
+							if (this->NodeScans(feat_valid, node_fmask, f, i))
+								seg_rows[i*ncol_mlt + b] = std::max(seg_rows[i*ncol_mlt + b], count[i]);
+					}
+				}
 			}
+			//compact segments start at an even row
+			std::vector<uint32_t> segs(nwork*ncol_mlt + 1, 0);
+			for (size_t k = 0; k < nwork*ncol_mlt; k++)
+				segs[k+1] = segs[k] + seg_rows[k] + (fparam_.fpga_compact_entries ? seg_rows[k]%2 : 0);
+			return segs;
 		}
-		inline void FindSplit(  const std::vector<int> &qexpand,
+		inline void FindSplit(  int depth,
+								const std::vector<int> &qexpand,
 								const std::vector<void*>& gpair_fpga,
 								const std::vector<void*>& dmat_fpga,
+								const std::vector<void*>& fdense_fpga,
 								const std::vector<uint32_t>& req_cols,
 								RegTree *p_tree) {
-			size_t qexpand_size_alligned = qexpand.size() + (qexpand.size()%2);
-			CHECK_LE(qexpand.size(),2048) << 
-				"More than 2048 new nodes were requested. Please reduce max depth";
+			if (fused_ && depth > 0)
+				this->SyncFusedLevel(qwork_, req_cols);
+			else if (qwork_.size() > 0)
+				this->FindSplitInAccel(qwork_, gpair_fpga, dmat_fpga, fdense_fpga, req_cols);
+			for (int nid : qexpand) {
+				NodeEntryInAccel &e = snode_[nid];
+				if (e.best.loss_chg > kRtEps) {
+					this->ApplySplit(nid, p_tree);
+				} else {
+					(*p_tree)[nid].SetLeaf(e.weight * param_.learning_rate);
+				}
+			}
+		}
+		// expand a node with its best split
+		inline void ApplySplit(int nid, RegTree *p_tree) {
+			NodeEntryInAccel &e = snode_[nid];
+			float left_leaf_weight =
+					spliteval_->ComputeWeight(nid, GradStats(e.best.left_sum)) *
+					param_.learning_rate;
+			float right_leaf_weight =
+					spliteval_->ComputeWeight(nid, GradStats(e.best.right_sum)) *
+					param_.learning_rate;
+			p_tree->ExpandNode(nid, e.best.SplitIndex(), e.best.split_value,
+												 e.best.DefaultLeft(), e.weight, left_leaf_weight,
+												 right_leaf_weight, e.best.loss_chg,
+												 e.stats.sum_hess);
+		}
+		// evaluate the best split of every work node on the accelerator
+		inline void FindSplitInAccel(  const std::vector<int> &qwork,
+								const std::vector<void*>& gpair_fpga,
+								const std::vector<void*>& dmat_fpga,
+								const std::vector<void*>& fdense_fpga,
+								const std::vector<uint32_t>& req_cols) {
+			size_t qwork_size_alligned = qwork.size() + (qwork.size()%2);
+			const unsigned max_nodes = partition_ ? xgboost_exact::kMaxPartitionNodeNum : xgboost_exact::kMaxNodeNum;
+			CHECK_LE(qwork.size(), max_nodes) << "More than "
+				<< max_nodes << " new nodes were requested. Please reduce max depth";
+			// the levels of a fused tree at most double their nodes, the split records
+			// of every level start at an even record
+			fused_ = fused_ && param_.max_depth <= 16 &&
+					(qwork.size() << (param_.max_depth - 1)) <= xgboost_exact::kMaxNodeNum;
+			size_t split_records = qwork_size_alligned;
+			if (fused_) {
+				split_records = 0;
+				for (int d = 0; d < param_.max_depth; d++)
+					split_records += (qwork.size() << d) + ((qwork.size() << d)%2);
+			}
 			std::vector<std::vector<SplitEntryInAccelRet>> best_split_tmp;
 			best_split_tmp.resize(nRequests_);
 			std::vector<void*> best_split;
 			best_split.resize(nRequests_);
+			std::vector<std::vector<uint32_t>> stats_tmp(nRequests_,
+					std::vector<uint32_t>(xgboost_exact::kStatCount));
+			std::vector<void*> stats;
+			stats.resize(nRequests_);
+			// the windows of feature blocks of every request, the whole layout of a request
+			// on the device
+			const HostLayout& host = approx_level_ ? approx_host_ : layout_compacted_ ? active_host_ : dmat_host_;
+			std::vector<std::vector<std::pair<uint32_t, uint32_t>>> windows(nRequests_);
+			size_t rounds = 0;
 			for(uint32_t req = 0; req<nRequests_; req++)
 			{
-				best_split_tmp[req].resize(qexpand_size_alligned);
-				uint32_t ncols_req = req_cols[req+1] - req_cols[req];
+				windows[req] = this->LayoutWindows(host, req, req_cols[req/nRanges_+1] - req_cols[req/nRanges_]);
+				rounds = std::max(rounds, windows[req].size());
+			}
+			for(uint32_t req = 0; req<nRequests_; req++)
+			{
+				best_split_tmp[req].resize(split_records);
+				//the windows of a host layout merge into records without a split
+				if (host.Streamed(req)) {
+					SplitEntryInAccelRet no_split{};
+					no_split.nu1 = xgboost_exact::kPrecisionTag;
+					std::fill(best_split_tmp[req].begin(), best_split_tmp[req].end(), no_split);
+				}
+				uint32_t ncols_req = req_cols[req/nRanges_+1] - req_cols[req/nRanges_];
 				best_split[req] = InAccel::malloc(world_,
 								best_split_tmp[req].size()*sizeof(SplitEntryInAccelRet), req);
-				InAccel::set_engine_arg(engine_[req],0, (int)nrows_);//real entry num -> nrows_
+				stats[req] = InAccel::malloc(world_, stats_tmp[req].size()*sizeof(uint32_t), req);
+				//the records of the bins are the rows of an approx level
+				if (approx_level_) {
+					InAccel::set_engine_arg(engine_[req],0, (int)approx_rows_[req]);
+				} else {
+					InAccel::set_engine_arg(engine_[req],0, (int)(row_window_.empty() ? nrows_ : window_rows_));//real entry num -> rows on the device
+				}
 				InAccel::set_engine_arg(engine_[req],1, (int)ncols_req);//feature_num -> ncols_
-				InAccel::set_engine_arg(engine_[req],2, (int)qexpand.size()); //node num
-				InAccel::set_engine_arg(engine_[req],3, (int)max_rows_); //node num
-				InAccel::set_engine_arg(engine_[req],4, gpair_fpga[req]);
-				InAccel::set_engine_arg(engine_[req],5, position_fpga_[req]);
-				InAccel::set_engine_arg(engine_[req],6, dmat_fpga[req]);
+				InAccel::set_engine_arg(engine_[req],2, (int)qwork.size()); //node num
+				InAccel::set_engine_arg(engine_[req],3, (int)(approx_level_ ? approx_batch_[req] : entry_batch_[req])); //entries per feature
+				InAccel::set_engine_arg(engine_[req],4, approx_level_ ? approx_gpair_fpga_[req] : gpair_fpga[req]);
+				InAccel::set_engine_arg(engine_[req],5, approx_level_ ? approx_position_fpga_[req] : position_fpga_[req]);
+				const std::vector<void*>& entries = approx_level_ ? approx_entries_ :
+						layout_compacted_ ? dmat_active_ : dmat_fpga;
+				InAccel::set_engine_arg(engine_[req],6, entries[req]);
 				InAccel::set_engine_arg(engine_[req],7, feat_valid_fpga_[req]);
 				InAccel::set_engine_arg(engine_[req],8, snode_stats_[req]);
 				InAccel::set_engine_arg(engine_[req],9, snode_rg_[req]);
 				InAccel::set_engine_arg(engine_[req],10, best_split[req]);
-				InAccel::set_engine_arg(engine_[req],11, param_.min_child_weight);
+				InAccel::set_engine_arg(engine_[req],11, param_.min_child_weight * gscale_);
 				InAccel::set_engine_arg(engine_[req],12, param_.max_delta_step);
-				InAccel::set_engine_arg(engine_[req],13, param_.reg_alpha);
-				InAccel::set_engine_arg(engine_[req],14, param_.reg_lambda);
+				InAccel::set_engine_arg(engine_[req],13, param_.reg_alpha * gscale_);
+				InAccel::set_engine_arg(engine_[req],14, param_.reg_lambda * gscale_);
+				InAccel::set_engine_arg(engine_[req],15, (int)fparam_.fpga_compact_entries);
+				InAccel::set_engine_arg(engine_[req],16, fdense_fpga[req]);
+				//upper lanes of a two port kernel, never read by a single port one
+				InAccel::set_engine_arg(engine_[req],17, entries[(kEntryPorts-1)*nRequests_ + req]);
+				InAccel::set_engine_arg(engine_[req],18, snode_bounds_[req]);
+				InAccel::set_engine_arg(engine_[req],19, feat_mono_fpga_[req]);
+				InAccel::set_engine_arg(engine_[req],20, (int)monotone_);
+				//without per node masks the level mask stands in, never read by the kernel
+				InAccel::set_engine_arg(engine_[req],21,
+										node_masks_ ? node_fmask_fpga_[req] : feat_valid_fpga_[req]);
+				InAccel::set_engine_arg(engine_[req],22, (int)node_masks_);
+				InAccel::set_engine_arg(engine_[req],23, stats[req]);
+				InAccel::set_engine_arg(engine_[req],24, (int)(fused_ ? param_.max_depth : 0));
+				//the expansion test of FindSplit, on the scaled loss changes
+				InAccel::set_engine_arg(engine_[req],25, static_cast<float>(kRtEps * gscale_));
+				//without value ranges the stats buffer stands in, never read by the kernel
+				InAccel::set_engine_arg(engine_[req],26, (nRanges_ > 1) ? node_seeds_fpga_[req] : stats[req]);
+				InAccel::set_engine_arg(engine_[req],27, (int)(nRanges_ > 1));
+				//without the node partition the stats buffer stands in, never read by the kernel
+				InAccel::set_engine_arg(engine_[req],28, partition_ ? node_segs_fpga_[req] : stats[req]);
+				InAccel::set_engine_arg(engine_[req],29, (int)partition_);
 			}
 			for(uint32_t req = 0; req<nRequests_; req++)
+				if (host.Streamed(req) && !windows[req].empty())
+					this->UploadWindow(host, req, BlockCount(req_cols[req/nRanges_+1] - req_cols[req/nRanges_]),
+									   windows[req][0], &windows_[req]);
+			std::vector<SplitEntryInAccelRet> window_split(split_records);
+			for(size_t k = 0; k < rounds; k++)
 			{
-				InAccel::run_engine(engine_[req]);
+				for(uint32_t req = 0; req<nRequests_; req++)
+				{
+					if (k >= windows[req].size()) continue;
+					if (host.Streamed(req)) {
+						const LayoutWindow& window = windows_[(k%2)*nRequests_ + req];
+						uint32_t ncols_req = req_cols[req/nRanges_+1] - req_cols[req/nRanges_];
+						uint32_t col_begin = windows[req][k].first*kLanes;
+						uint32_t col_end = std::min(windows[req][k].second*kLanes, ncols_req);
+						InAccel::set_engine_arg(engine_[req],1, (int)(col_end - col_begin));
+						InAccel::set_engine_arg(engine_[req],6, window.entries[0]);
+						InAccel::set_engine_arg(engine_[req],7, window.fvalid);
+						InAccel::set_engine_arg(engine_[req],16, window.fdense);
+						InAccel::set_engine_arg(engine_[req],17, window.entries[kEntryPorts-1]);
+						InAccel::set_engine_arg(engine_[req],19, window.fmono);
+						InAccel::set_engine_arg(engine_[req],21, node_masks_ ? window.nfmask : window.fvalid);
+					}
+					InAccel::run_engine(engine_[req]);
+				}
+				//the next windows are uploaded while the kernels scan the current ones
+				for(uint32_t req = 0; req<nRequests_; req++)
+					if (host.Streamed(req) && k+1 < windows[req].size())
+						this->UploadWindow(host, req, BlockCount(req_cols[req/nRanges_+1] - req_cols[req/nRanges_]),
+										   windows[req][k+1], &windows_[((k+1)%2)*nRequests_ + req]);
+				for(uint32_t req = 0; req<nRequests_; req++)
+				{
+					if (k >= windows[req].size()) continue;
+					InAccel::await_engine(engine_[req]);
+					if (host.Streamed(req)) {
+						InAccel::memcpy_from(world_, best_split[req], 0, window_split.data(),
+											 window_split.size()*sizeof(SplitEntryInAccelRet));
+						MergeWindowSplits(window_split, windows[req][k].first*kLanes, &best_split_tmp[req]);
+					} else {
+						InAccel::memcpy_from(world_, best_split[req], 0, best_split_tmp[req].data(),
+											 best_split_tmp[req].size()*sizeof(SplitEntryInAccelRet));
+					}
+					InAccel::memcpy_from(world_, stats[req], 0, stats_tmp[req].data(),
+										 stats_tmp[req].size()*sizeof(uint32_t));
+					kernel_stats_.Add(kernel_level_, stats_tmp[req].data());
+				}
 			}
 			for(uint32_t req = 0; req<nRequests_; req++)
-			{
-				InAccel::await_engine(engine_[req]);
-				InAccel::memcpy_from(world_, best_split[req], 0, best_split_tmp[req].data(),
-									 best_split_tmp[req].size()*sizeof(SplitEntryInAccelRet));
+				InAccel::free(world_, stats[req]);
+			kernel_level_++;
+			if (fused_) {
+				fused_splits_.swap(best_split_tmp[0]);
+				this->SyncFusedLevel(qwork, req_cols);
+			} else {
+				this->SyncBestSolution(qwork, best_split_tmp, req_cols);
 			}
-			this->SyncBestSolution(qexpand, best_split_tmp, req_cols);
-			for (int nid : qexpand) {
-				NodeEntryInAccel &e = snode_[nid];
-				if (e.best.loss_chg > kRtEps) {
-					float left_leaf_weight =
-							spliteval_->ComputeWeight(nid, GradStats(e.best.left_sum)) *
-							param_.learning_rate;
-					float right_leaf_weight =
-							spliteval_->ComputeWeight(nid, GradStats(e.best.right_sum)) *
-							param_.learning_rate;
-					p_tree->ExpandNode(nid, e.best.SplitIndex(), e.best.split_value,
-														 e.best.DefaultLeft(), e.weight, left_leaf_weight,
-														 right_leaf_weight, e.best.loss_chg,
-														 e.stats.sum_hess);
-				} else {
-					(*p_tree)[nid].SetLeaf(e.weight * param_.learning_rate);
+		}
+		// the windows of feature blocks of request req: all the blocks of a layout on the
+		// device, or as many blocks as fit twice in the budget for a host layout, without
+		// the windows whose features are all masked out at the level
+		inline std::vector<std::pair<uint32_t, uint32_t>> LayoutWindows(const HostLayout& host, uint32_t req,
+																		 uint32_t ncols_req) const {
+			const uint32_t ncol_mlt = BlockCount(ncols_req);
+			std::vector<std::pair<uint32_t, uint32_t>> windows;
+			if (!host.Streamed(req)) {
+				windows.emplace_back(0, ncol_mlt);
+				return windows;
+			}
+			const size_t block_bytes = std::max<size_t>(host.ports[req].size()/ncol_mlt, 1);
+			const auto width = static_cast<uint32_t>(std::max<size_t>(host.budget/(2*block_bytes), 1));
+			const auto& fvalid = feat_valid_host_[req];
+			for (uint32_t b = 0; b < ncol_mlt; b += width) {
+				uint32_t e = std::min(b + width, ncol_mlt);
+				if (std::any_of(fvalid.begin() + b*kLanes/8, fvalid.begin() + e*kLanes/8,
+								[](char m) { return m != 0; }))
+					windows.emplace_back(b, e);
+			}
+			return windows;
+		}
+		// upload the blocks [window.first, window.second) of the ncol_mlt blocks of the host
+		// layout of request req, with the slices of the feature masks, to the device buffers of a window
+		inline void UploadWindow(const HostLayout& host, uint32_t req, uint32_t ncol_mlt,
+								 const std::pair<uint32_t, uint32_t>& window, LayoutWindow* buffers) {
+			const uint32_t b = window.first, e = window.second;
+			for (uint32_t port = 0; port < kEntryPorts; port++) {
+				auto buf = port*nRequests_ + req;
+				const size_t block_bytes = host.ports[buf].size()/ncol_mlt;
+				const size_t bytes = (e - b)*block_bytes;
+				if (buffers->capacity[port] < bytes) {
+					if (buffers->entries[port] != 0) InAccel::free(world_, buffers->entries[port]);
+					buffers->entries[port] = InAccel::malloc(world_, bytes, buf);
+					buffers->capacity[port] = bytes;
 				}
+				InAccel::memcpy_to(world_, buffers->entries[port], 0,
+								   const_cast<char*>(host.ports[buf].data()) + b*block_bytes, bytes);
+			}
+			//masks of unit bytes per block, zero when the level has none
+			auto slice = [&](const std::vector<char>& mask, size_t unit, void** buffer) {
+				if (*buffer != 0) InAccel::free(world_, *buffer);
+				std::vector<char> part((e - b)*unit, 0);
+				if (mask.size() >= e*unit) std::copy(mask.begin() + b*unit, mask.begin() + e*unit, part.begin());
+				*buffer = InAccel::malloc(world_, part.size()*sizeof(char), req);
+				InAccel::memcpy_to(world_, *buffer, 0, part.data(), part.size()*sizeof(char));
+			};
+			slice(feat_valid_host_[req], kLanes/8, &buffers->fvalid);
+			slice(fdense_host_[req], kLanes/8, &buffers->fdense);
+			slice(feat_mono_host_[req], kLanes/4, &buffers->fmono);
+			if (node_masks_) slice(node_fmask_host_[req], qwork_.size()*kLanes/8, &buffers->nfmask);
+		}
+		inline void FreeWindow(LayoutWindow* buffers) {
+			for (uint32_t port = 0; port < buffers->entries.size(); port++) {
+				if (buffers->entries[port] != 0) InAccel::free(world_, buffers->entries[port]);
+				buffers->entries[port] = 0;
+				buffers->capacity[port] = 0;
+			}
+			for (void** mask : {&buffers->fvalid, &buffers->fdense, &buffers->fmono, &buffers->nfmask}) {
+				if (*mask != 0) InAccel::free(world_, *mask);
+				*mask = 0;
 			}
 		}
+		// fold the best splits of a window, whose features start at column col_begin of the
+		// request, into the best splits of the request, by the order of SplitEntryInAccel
+		inline static void MergeWindowSplits(const std::vector<SplitEntryInAccelRet>& window, uint32_t col_begin,
+											 std::vector<SplitEntryInAccelRet>* best) {
+			for (size_t i = 0; i < window.size(); i++) {
+				SplitEntryInAccelRet split = window[i];
+				split.sindex = (split.sindex & 0x80000000u) | ((split.sindex & 0x7fffffff) + col_begin);
+				SplitEntryInAccelRet& curr = (*best)[i];
+				bool replace = ((curr.sindex & 0x7fffffff) <= (split.sindex & 0x7fffffff))
+						? split.loss_chg > curr.loss_chg : !(curr.loss_chg > split.loss_chg);
+				if (replace) curr = split;
+			}
+		}
+		// the splits of the next level of a fused tree; the kernel expands the same
+		// nodes as FindSplit, so the levels of the host follow its records
+		inline void SyncFusedLevel(const std::vector<int> &qwork, const std::vector<uint32_t>& req_cols) {
+			size_t records = qwork.size() + (qwork.size()%2);
+			CHECK_LE(fused_offset_ + records, fused_splits_.size())
+				<< "The levels of the fused tree do not match the kernel.";
+			std::vector<std::vector<SplitEntryInAccelRet>> best_split(1,
+					std::vector<SplitEntryInAccelRet>(fused_splits_.begin() + fused_offset_,
+													  fused_splits_.begin() + fused_offset_ + records));
+			fused_offset_ += records;
+			this->SyncBestSolution(qwork, best_split, req_cols);
+		}
+		// rebuild the threshold of a split found on compact entries, from the ranks
+		// of the two adjacent values or the rank of the last value of the feature
+		inline float DecodeSplitValue(const SplitEntryInAccelRet& split, uint32_t offset) const {
+			uint32_t ranks;
+			std::memcpy(&ranks, &split.split_value, sizeof(ranks));
+			const uint32_t fid = (split.sindex & 0x7fffffff) + offset;
+			if (fid >= feat_values_.size()) return 0.0f;
+			const auto& values = feat_values_[fid];
+			uint32_t prev = ranks >> 16;
+			uint32_t curr = ranks & 0xffff;
+			if (prev >= values.size()) return 0.0f;
+			if (curr == 0xffff) return values[prev] - (std::fabs(values[prev]) + kRtEps);
+			if (curr >= values.size()) return 0.0f;
+			return (values[prev] + values[curr]) * 0.5f;
+		}
 		void SyncBestSolution(const std::vector<int> &qexpand,
 							  const std::vector<std::vector<SplitEntryInAccelRet>> &best_split,
 							  const std::vector<uint32_t>& req_cols) {
 			std::vector<SplitEntryInAccel> vec;
 			for (int nid : qexpand) {
 				for (uint32_t req = 0; req < nRequests_; req++) {
+					SplitEntryInAccelRet split = best_split[req][node2workindex_[nid]];
+					CHECK_EQ(split.nu1, xgboost_exact::kPrecisionTag)
+							<< "The accumulator precision of the kernel does not match the library build.";
+					split.loss_chg /= gscale_;
+					split.left_sum_grad /= gscale_;
+					split.left_sum_hess /= gscale_;
+					if (fparam_.fpga_compact_entries)
+						split.split_value = this->DecodeSplitValue(split, req_cols[req/nRanges_]);
+					uint32_t offset = req_cols[req/nRanges_];
+					//the feature and threshold of a split of a bundle
+					if (bundles_.Bundled()) {
+						split.sindex = bundles_.Split(split.sindex, offset, &split.split_value);
+						offset = 0;
+					}
+					//the threshold of a split of the bins
+					if (approx_level_)
+						split.split_value = this->ApproxSplitValue(split, offset, approx_merge_[req]);
 					this->snode_[nid].best.Update( SplitEntryInAccel(this->snode_[nid].stats,
-													 best_split[req][node2workindex_[nid]],
-													 req_cols[req]));
+													 split, offset));
 				}
 				vec.push_back(this->snode_[nid].best);
 			}
@@ -719,7 +2617,7 @@ class DistFpgaMaker : public TreeUpdater {
 						boolmap_[j] = 0;
 				}
 			}
-			for (const auto &batch : p_fmat->GetSortedColumnBatches()) {
+			for (const auto &batch : columns_) {
 				for (auto fid : fsplits) {
 					auto col = batch[fid];
 					const auto ndata = static_cast<uint32_t>(col.size());
@@ -0,0 +1,931 @@
+/*
+Copyright © 2019 InAccel
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <rabit/rabit.h>
+#include <xgboost/tree_updater.h>
+#include <memory>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <type_traits>
+
+#include "../common/random.h"
+#include "../common/hist_util.h"
+#include "../common/timer.h"
+#include "../tree/split_evaluator.h"
+#include "../tree/constraints.h"
+#include "../tree/param.h"
+
+#include <coral-api/coral.h>
+#include <coral-api/request.h>
+#include <coral-api/allocator.h>
+
+#include "xgboost_hist_config.h"
+
+namespace xgboost {
+namespace inaccel {
+
+using xgboost::tree::GradStats;
+using xgboost_hist::kLanes;
+using xgboost_hist::kRowAlign;
+using xgboost_hist::kHistFromRows;
+using xgboost::FeatureInteractionConstraintHost;
+using xgboost::tree::SplitEvaluator;
+using xgboost::tree::TrainParam;
+
+DMLC_REGISTRY_FILE_TAG(updater_fpga_hist_coral);
+
+// training parameters specific to the fpga hist updater
+struct FpgaHistTrainParam : public dmlc::Parameter<FpgaHistTrainParam> {
+	// whether the histogram of the larger child of a split is derived from its parent
+	bool fpga_hist_subtraction;
+	// fraction of the rows of the layout below which it is rebuilt with the streamed rows only
+	float fpga_hist_compact_threshold;
+	DMLC_DECLARE_PARAMETER(FpgaHistTrainParam) {
+		DMLC_DECLARE_FIELD(fpga_hist_subtraction)
+				.set_default(true)
+				.describe("Keep the histograms of every level in device memory and derive the "
+						  "histogram of the larger child of each split from the one of its parent "
+						  "less the one of its sibling, so that the kernel streams the rows of the "
+						  "smaller children only.");
+		DMLC_DECLARE_FIELD(fpga_hist_compact_threshold)
+				.set_range(0.0f, 1.0f)
+				.set_default(0.5f)
+				.describe("Rebuild the device layout with the rows the kernel bins only, when "
+						  "they drop below this fraction of the rows of the current layout. "
+						  "0 disables the compaction.");
+	}
+};
+
+DMLC_REGISTER_PARAMETER(FpgaHistTrainParam);
+
+// quantized value of the device layout, kMissingBin for a missing one
+typedef std::conditional<xgboost_hist::kBinBits == 8, uint8_t, uint16_t>::type BinT;
+
+// power of two scale of the gradients of a tree, as GradientScale of the exact updater
+// for the integer bits of the histogram accumulators
+inline float HistGradientScale(const std::vector<GradientPair>& gpair, float reg_lambda) {
+	double sum_grad = 0.0, sum_hess = 0.0, sum_gain = 0.0;
+	for (const auto& g : gpair) {
+		if (g.GetHess() < 0.0f) continue;
+		sum_grad += std::fabs(g.GetGrad());
+		sum_hess += g.GetHess();
+		if (g.GetHess() + reg_lambda > 0.0f)
+			sum_gain += g.GetGrad() * g.GetGrad() / (g.GetHess() + reg_lambda);
+	}
+	double bound = std::max(std::max(sum_grad, sum_hess), sum_gain);
+	if (!(bound > 0.0)) return 1.0f;
+	int exp = static_cast<int>(std::floor(std::log2(std::ldexp(1.0, xgboost_hist::kAccumInt - 2) / bound)));
+	exp = std::min(std::max(exp, -30), 30);
+	return std::ldexp(1.0f, exp);
+}
+
+// readable form of the counters written by the histogram kernel after a call
+inline std::string FormatHistKernelStats(const uint32_t* stats) {
+	using namespace xgboost_hist;
+	std::ostringstream os;
+	os << "init " << stats[kStatNodeInit] << "+" << stats[kStatClear]
+	   << " blocks " << stats[kStatBlocks] << " (skipped " << stats[kStatBlocksSkipped] << ")"
+	   << " rows " << stats[kStatRowCycles] << " (inactive " << stats[kStatRowsInactive]
+	   << ", missing slots " << stats[kStatBinsMissing] << ")"
+	   << " derived " << stats[kStatNodesSubtracted] << " (reads " << stats[kStatHistReads] << ")"
+	   << " kept " << stats[kStatHistWrites]
+	   << " scan " << stats[kStatScanCycles]
+	   << " write back " << stats[kStatWriteBack];
+	return os.str();
+}
+
+// actual builder that runs the algorithm
+// fpga histogram maker
+class DistFpgaHistMaker : public TreeUpdater {
+ public:
+	void Configure(const Args& args) override {
+		param_.InitAllowUnknown(args);
+		fparam_.InitAllowUnknown(args);
+		pruner_.reset(TreeUpdater::Create("prune", tparam_));
+		pruner_->Configure(args);
+		spliteval_.reset(SplitEvaluator::Create(param_.split_evaluator));
+		spliteval_->Init(args);
+		is_dmat_fpga_initialized_ = false;
+		nRequests_ = 2;
+		for(auto p : args)
+			if(p.first == "nRequests") nRequests_ = std::stoi(p.second);
+	}
+	char const* Name() const override {
+		return "grow_fpga_hist";
+	}
+	void Update(HostDeviceVector<GradientPair> *gpair, DMatrix* dmat,
+				const std::vector<RegTree*> &trees) override {
+		monitor_.Init("Update");
+		CHECK_EQ(trees.size(), 1U) << "DistFpgaHistMaker: only support one tree at a time";
+		// the histograms of a node are built from the rows of this worker only
+		CHECK_EQ(rabit::GetWorldSize(), 1) << "grow_fpga_hist does not support distributed training";
+		const auto nrow = static_cast<uint32_t>(dmat->Info().num_row_);
+		const auto ncol = static_cast<uint32_t>(dmat->Info().num_col_);
+		if (is_dmat_fpga_initialized_ == false) {
+			monitor_.Start("Init dmat_fpga");
+			this->InitQuantized(dmat, nrow, ncol);
+			is_dmat_fpga_initialized_ = true;
+			monitor_.Stop("Init dmat_fpga");
+		}
+		const std::vector<GradientPair>& gpair_h = gpair->ConstHostVector();
+		const float gscale = HistGradientScale(gpair_h, param_.reg_lambda);
+		Builder builder( nrow, ncol, nrow_pad_, bin_num_, nRequests_, param_, fparam_, cuts_, bins_, gscale,
+						 monitor_,
+						 std::unique_ptr<SplitEvaluator>(spliteval_->GetHostClone()));
+		monitor_.Start("Init gpair_fpga");
+		gpair_fpga_.resize(0);
+		gpair_fpga_.shrink_to_fit();
+		gpair_fpga_.resize(nrow_pad_);
+		for (size_t i = 0; i < gpair_h.size(); i++)
+			gpair_fpga_[i] = GradientPair(gpair_h[i].GetGrad()*gscale, gpair_h[i].GetHess()*gscale);
+		monitor_.Stop("Init gpair_fpga");
+		monitor_.Start("builder Update");
+		builder.Update( gpair->ConstHostVector(), gpair_fpga_, dmat, req_cols_, trees[0]);
+		monitor_.Stop("builder Update");
+		monitor_.Start("pruner Update");
+		pruner_->Update(gpair, dmat, trees);
+		monitor_.Stop("pruner Update");
+		builder.UpdatePosition(dmat, *trees[0]);
+	}
+ protected:
+	// quantize the rows once per matrix: the bin of every value among the cuts of its
+	// feature, kLanes features of a block side by side per row, the rows padded to kRowAlign;
+	// the quantized rows of every request are its device layout
+	inline void InitQuantized(DMatrix* dmat, uint32_t nrow, uint32_t ncol) {
+		cuts_.Build(dmat, std::min(static_cast<uint32_t>(param_.max_bin), xgboost_hist::kMaxBin));
+		const auto& ptrs = cuts_.Ptrs();
+		const auto& values = cuts_.Values();
+		bin_num_ = 1;
+		for (uint32_t fid = 0; fid < ncol; fid++) {
+			uint32_t nbins = ptrs[fid+1] - ptrs[fid];
+			CHECK_LE(nbins, xgboost_hist::kMaxBin) << "The kernel supports up to "
+				<< xgboost_hist::kMaxBin << " bins per feature, please reduce max_bin";
+			bin_num_ = std::max(bin_num_, nbins);
+		}
+		nrow_pad_ = (nrow + kRowAlign - 1)/kRowAlign*kRowAlign;
+		req_cols_.resize(nRequests_+1);
+		req_cols_[0] = 0;
+		uint32_t ncol_div = ncol/nRequests_;
+		uint32_t ncol_mod = ncol%nRequests_;
+		bins_.resize(nRequests_);
+		for(uint32_t req = 0; req<nRequests_; req++) {
+			req_cols_[req+1] = req_cols_[req] + ncol_div + ((ncol_mod>0)?1:0);
+			ncol_mod-=((ncol_mod>0)?1:0);
+			auto ncol_mlt = xgboost_hist::BlockCount(req_cols_[req+1] - req_cols_[req]);
+			bins_[req].assign(static_cast<size_t>(ncol_mlt)*nrow_pad_*kLanes,
+							  static_cast<BinT>(xgboost_hist::kMissingBin));
+		}
+		for (const auto &batch : dmat->GetBatches<SparsePage>()) {
+			const auto nbatch = static_cast<uint32_t>(batch.Size());
+			#pragma omp parallel for schedule(static)
+			for (uint32_t i = 0; i < nbatch; i++) {
+				const auto ridx = static_cast<size_t>(batch.base_rowid + i);
+				for (const auto& e : batch[i]) {
+					const uint32_t fid = e.index;
+					auto beg = values.begin() + ptrs[fid];
+					auto end = values.begin() + ptrs[fid+1];
+					if (beg == end) continue;
+					auto bin = static_cast<uint32_t>(std::upper_bound(beg, end, e.fvalue) - beg);
+					bin = std::min(bin, static_cast<uint32_t>(end - beg) - 1);
+					uint32_t req = 0;
+					while (fid >= req_cols_[req+1]) req++;
+					uint32_t fid_shifted = fid - req_cols_[req];
+					bins_[req][((fid_shifted/kLanes)*nrow_pad_ + ridx)*kLanes + fid_shifted%kLanes] =
+							static_cast<BinT>(bin);
+				}
+			}
+		}
+	}
+	common::Monitor monitor_;
+	unsigned nRequests_;
+	TrainParam param_;
+	FpgaHistTrainParam fparam_;
+	std::unique_ptr<SplitEvaluator> spliteval_;
+	std::unique_ptr<TreeUpdater> pruner_;
+	bool is_dmat_fpga_initialized_;
+	// cuts of the features
+	common::HistogramCuts cuts_;
+	uint32_t bin_num_;
+	uint32_t nrow_pad_;
+	//cubes
+	std::vector<::inaccel::vector<BinT>> bins_;
+	std::vector<uint32_t> req_cols_;
+	::inaccel::vector<GradientPair> gpair_fpga_;
+	// data structure
+	struct XGBOOST_ALIGNAS(8) GradStatsInAccel {
+	  float sum_grad;
+	  float sum_hess;
+	  float GetGrad() const { return sum_grad; }
+	  float GetHess() const { return sum_hess; }
+
+	  GradStatsInAccel() : sum_grad{0}, sum_hess{0} {
+	    static_assert(sizeof(GradStatsInAccel) == 8,
+	                  "Size of GradStatsInAccel is not 8 bytes.");
+	  }
+
+	  template <typename GpairT>
+	  explicit GradStatsInAccel(const GpairT &sum)
+	      : sum_grad(sum.GetGrad()), sum_hess(sum.GetHess()) {}
+	  inline void Add(float grad, float hess) {
+	    sum_grad += grad;
+	    sum_hess += hess;
+	  }
+	  template <typename GpairT>
+	  inline void Add(const GpairT &p) { this->Add(p.GetGrad(), p.GetHess()); }
+	};
+	struct XGBOOST_ALIGNAS(32) SplitEntryInAccelRet {
+	  float loss_chg;
+	  unsigned sindex;
+	  // bits of the bin threshold, 0xffff when every present value goes right
+	  float split_value;
+	  float left_sum_grad;
+	  float left_sum_hess;
+	  unsigned nu1;
+	  unsigned nu2;
+	  unsigned nu3;
+	};
+	static_assert(sizeof(SplitEntryInAccelRet) == xgboost_hist::kSplitBytes,
+				  "SplitEntryInAccelRet does not match the split records of the kernel.");
+	struct SplitEntryInAccel {
+	  float loss_chg{0.0f};
+	  unsigned sindex{0};
+	  float split_value{0.0f};
+	  GradStatsInAccel left_sum;
+	  GradStatsInAccel right_sum;
+	  SplitEntryInAccel()  = default;
+	  SplitEntryInAccel(const GradStatsInAccel& parent,
+	  					const SplitEntryInAccelRet& new_split, const uint32_t& offset)
+	  {
+		  this->loss_chg = new_split.loss_chg;
+		  this->sindex = new_split.sindex + offset;
+		  this->split_value = new_split.split_value;
+		  this->left_sum.sum_grad = new_split.left_sum_grad;
+		  this->left_sum.sum_hess = new_split.left_sum_hess;
+		  this->right_sum.sum_grad = parent.sum_grad - new_split.left_sum_grad;
+		  this->right_sum.sum_hess = parent.sum_hess - new_split.left_sum_hess;
+	  }
+	  inline bool NeedReplace(float new_loss_chg, unsigned split_index) const {
+	    if (this->SplitIndex() <= split_index) {
+	      return new_loss_chg > this->loss_chg;
+	    } else {
+	      return !(this->loss_chg > new_loss_chg);
+	    }
+	  }
+	  inline bool Update(const SplitEntryInAccel &e) {
+	    if (this->NeedReplace(e.loss_chg, e.SplitIndex())) {
+	      this->loss_chg = e.loss_chg;
+	      this->sindex = e.sindex;
+	      this->split_value = e.split_value;
+	      this->left_sum = e.left_sum;
+	      this->right_sum = e.right_sum;
+	      return true;
+	    } else {
+	      return false;
+	    }
+	  }
+	  inline unsigned SplitIndex() const { return sindex & ((1U << 31) - 1U); }
+	  inline bool DefaultLeft() const { return (sindex >> 31) != 0; }
+	};
+	struct NodeEntryInAccel {
+		GradStatsInAccel stats;
+		float root_gain;
+		float weight;
+		SplitEntryInAccel best;
+		NodeEntryInAccel() : root_gain{0.0f}, weight{0.0f} {}
+	};
+ private:
+	class Builder {
+	 protected:
+	 	unsigned nrows_;
+	 	unsigned ncols_;
+	 	unsigned nrow_pad_;
+	 	unsigned bin_num_;
+	 	unsigned nRequests_;
+
+		const TrainParam& param_;
+		const FpgaHistTrainParam& fparam_;
+		const common::HistogramCuts& cuts_;
+		const std::vector<::inaccel::vector<BinT>>& bins_;
+		// power of two scale of the gradients on the device
+		const float gscale_;
+		common::Monitor& monitor_;
+		const int nthread_;
+		common::ColumnSampler column_sampler_;
+		const std::vector<GradientPair>* gpair_;
+		std::vector<int> position_;
+		::inaccel::vector<short int> position_fpga_;
+		std::vector< std::vector<GradStatsInAccel> > stemp_;
+		std::vector<NodeEntryInAccel> snode_;
+		::inaccel::vector<GradStatsInAccel> snode_stats_;
+		::inaccel::vector<float> snode_rg_;
+		::inaccel::vector<float> snode_bounds_;
+		::inaccel::vector<uint32_t> snode_hist_src_;
+		std::vector<::inaccel::vector<uint8_t>> feat_mono_fpga_;
+		std::vector<::inaccel::vector<uint8_t>> node_fmask_fpga_;
+		std::vector<::inaccel::vector<uint8_t>> feat_valid_fpga_;
+		// the rows streamed by the kernel once the layout is compacted, by layout row
+		std::vector<::inaccel::vector<BinT>> bins_active_;
+		::inaccel::vector<GradientPair> gpair_active_;
+		std::vector<uint32_t> layout_map_;
+		bool layout_compacted_;
+		size_t layout_rows_;
+		// histograms kept by the previous call, and the work index of its nodes; coral
+		// moves them through host memory between the calls
+		std::vector<::inaccel::vector<uint8_t>> hist_prev_;
+		std::vector<int> prev_workindex_;
+		uint32_t prev_work_num_;
+		// source of the histogram of every work node, and whether the call keeps them
+		std::vector<uint32_t> hist_src_;
+		bool keep_hist_;
+		std::vector<int> qexpand_;
+		std::vector<int> qwork_;
+		std::vector<int> node2workindex_;
+		// weight bounds of the nodes, mirroring the ones of the monotone evaluator
+		bool monotone_;
+		std::vector<float> wlower_;
+		std::vector<float> wupper_;
+		// features sampled per node or restricted by interaction constraints
+		bool node_masks_;
+		FeatureInteractionConstraintHost interaction_constraints_;
+		std::unique_ptr<SplitEvaluator> spliteval_;
+	 public:
+		// constructor
+		explicit Builder( unsigned nrow, unsigned ncol, unsigned nrow_pad, unsigned bin_num, unsigned nRequests,
+						  const TrainParam& param, const FpgaHistTrainParam& fparam,
+						  const common::HistogramCuts& cuts, const std::vector<::inaccel::vector<BinT>>& bins,
+						  float gscale, common::Monitor& monitor,
+						  std::unique_ptr<SplitEvaluator> spliteval)
+				: nrows_(nrow), ncols_(ncol), nrow_pad_(nrow_pad), bin_num_(bin_num), nRequests_(nRequests),
+				  param_(param), fparam_(fparam), cuts_(cuts), bins_(bins), gscale_(gscale), monitor_(monitor),
+				  nthread_(omp_get_max_threads()), gpair_(nullptr), spliteval_(std::move(spliteval)) {}
+		// update one tree, growing
+		virtual void Update(const std::vector<GradientPair>& gpair,
+							const ::inaccel::vector<GradientPair>& gpair_fpga,
+							DMatrix* p_fmat,
+							const std::vector<uint32_t>& req_cols,
+							RegTree* p_tree) {
+			monitor_.Init("Builder");
+			monitor_.Start("Builder Init");
+			std::vector<int> newnodes;
+			gpair_ = &gpair;
+			this->InitData(gpair, *p_fmat, *p_tree);
+			this->InitNewNode(qexpand_, gpair, *p_fmat, *p_tree);
+			monitor_.Stop("Builder Init");
+			for (int depth = 0; depth < param_.max_depth; ++depth) {
+				monitor_.Start("Builder Create Cubes");
+				this->CreateCubes( depth, *p_tree, req_cols);
+				monitor_.Stop("Builder Create Cubes");
+				monitor_.Start("Builder Find Splits");
+				this->FindSplit( depth, qexpand_, gpair_fpga, req_cols, p_tree);
+				monitor_.Stop("Builder Find Splits");
+				monitor_.Start("Builder Update Tree");
+				this->ResetPosition(qexpand_, p_fmat, *p_tree);
+				this->UpdateQueueExpand(*p_tree, qexpand_, &newnodes);
+				this->InitNewNodeFromSplits(qexpand_, newnodes, *p_tree);
+				for (auto nid : qexpand_) {
+					if ((*p_tree)[nid].IsLeaf()) {
+						continue;
+					}
+					int cleft = (*p_tree)[nid].LeftChild();
+					int cright = (*p_tree)[nid].RightChild();
+					spliteval_->AddSplit(nid, cleft, cright, snode_[nid].best.SplitIndex(),
+										 snode_[cleft].weight, snode_[cright].weight);
+					this->AddWeightBounds(nid, cleft, cright, snode_[nid].best.SplitIndex(),
+										  snode_[cleft].weight, snode_[cright].weight);
+					interaction_constraints_.Split(nid, snode_[nid].best.SplitIndex(), cleft, cright);
+				}
+				qexpand_ = newnodes;
+				monitor_.Stop("Builder Update Tree");
+				// if nothing left to be expand, break
+				if (qexpand_.size() == 0) break;
+			}
+			// set all the rest expanding nodes to leaf
+			for (const int nid : qexpand_) {
+				(*p_tree)[nid].SetLeaf(snode_[nid].weight * param_.learning_rate);
+			}
+			// remember auxiliary statistics in the tree node
+			for (int nid = 0; nid < p_tree->param.num_nodes; ++nid) {
+				p_tree->Stat(nid).loss_chg = snode_[nid].best.loss_chg;
+				p_tree->Stat(nid).base_weight = snode_[nid].weight;
+				p_tree->Stat(nid).sum_hess = static_cast<float>(snode_[nid].stats.sum_hess);
+			}
+		}
+		inline void InitData(const std::vector<GradientPair>& gpair, const DMatrix& fmat,
+							 const RegTree& tree) {
+			CHECK_EQ(tree.param.num_nodes, tree.param.num_roots) << "FpgaHistMaker: can only grow new tree";
+			const std::vector<unsigned>& root_index = fmat.Info().root_index_;
+			// setup position
+			position_.resize(gpair.size());
+			CHECK_EQ(nrows_, position_.size());
+			if (root_index.size() == 0) {
+				std::fill(position_.begin(), position_.end(), 0);
+			} else {
+				for (size_t ridx = 0; ridx <	position_.size(); ++ridx) {
+					position_[ridx] = root_index[ridx];
+					CHECK_LT(root_index[ridx], (unsigned)tree.param.num_roots);
+				}
+			}
+			// mark delete for the deleted datas
+			for (size_t ridx = 0; ridx < position_.size(); ++ridx) {
+				if (gpair[ridx].GetHess() < 0.0f) position_[ridx] = ~position_[ridx];
+			}
+			// mark subsample
+			if (param_.subsample < 1.0f) {
+				std::bernoulli_distribution coin_flip(param_.subsample);
+				auto& rnd = common::GlobalRandom();
+				for (size_t ridx = 0; ridx < position_.size(); ++ridx) {
+					if (gpair[ridx].GetHess() < 0.0f) continue;
+					if (!coin_flip(rnd)) position_[ridx] = ~position_[ridx];
+				}
+			}
+			column_sampler_.Init(ncols_, param_.colsample_bynode,
+								 param_.colsample_bylevel, param_.colsample_bytree);
+			// setup temp space for each thread
+			stemp_.clear();
+			stemp_.resize(this->nthread_, std::vector<GradStatsInAccel>());
+			snode_.reserve(256);
+			// expand query
+			qexpand_.reserve(256); qexpand_.clear();
+			for (int i = 0; i < tree.param.num_roots; ++i) {
+				qexpand_.push_back(i);
+			}
+			// the monotone evaluator is active with at least one constrained feature
+			monotone_ = param_.split_evaluator.find("monotonic") != std::string::npos &&
+					std::any_of(param_.monotone_constraints.begin(), param_.monotone_constraints.end(),
+								[](int c) { return c != 0; });
+			wlower_.assign(tree.param.num_roots, -std::numeric_limits<float>::infinity());
+			wupper_.assign(tree.param.num_roots, std::numeric_limits<float>::infinity());
+			// every node gets its own feature mask when they can differ within a level
+			interaction_constraints_.Configure(param_, ncols_);
+			node_masks_ = param_.colsample_bynode < 1.0f || !param_.interaction_constraints.empty();
+			feat_valid_fpga_.resize(nRequests_);
+			feat_mono_fpga_.resize(nRequests_);
+			for (auto& mono : feat_mono_fpga_) mono.resize(0);
+			node_fmask_fpga_.resize(nRequests_);
+			bins_active_.resize(nRequests_);
+			hist_prev_.resize(nRequests_);
+			for (auto& hist : hist_prev_) hist.resize(0);
+			// the kernel streams the full layout until it is compacted
+			layout_map_.clear();
+			layout_compacted_ = false;
+			layout_rows_ = nrows_;
+			prev_workindex_.clear();
+			prev_work_num_ = 0;
+			keep_hist_ = false;
+		}
+		inline void InitNewNode(const std::vector<int>& qexpand,
+								const std::vector<GradientPair>& gpair,
+								const DMatrix& fmat,
+								const RegTree& tree) {
+			{
+				// setup statistics space for each tree node
+				for (auto& i : stemp_) {
+					i.resize(tree.param.num_nodes, GradStatsInAccel());
+				}
+				snode_.resize(tree.param.num_nodes, NodeEntryInAccel());
+			}
+			// setup position
+			#pragma omp parallel for schedule(static)
+			for (uint32_t ridx = 0; ridx < nrows_; ++ridx) {
+				const int tid = omp_get_thread_num();
+				if (position_[ridx] < 0) continue;
+				stemp_[tid][position_[ridx]].Add(gpair[ridx]);
+			}
+			// sum the per thread statistics together
+			for (int nid : qexpand) {
+				GradStatsInAccel stats;
+				for (auto& s : stemp_) {
+					stats.Add(s[nid]);
+				}
+				// update node statistics
+				snode_[nid].stats = stats;
+			}
+			this->InitNodeWeights(qexpand, tree);
+		}
+		// the statistics of the children are already known from the split of their parent,
+		// left_sum is returned by the accelerator and right_sum is derived from the parent
+		inline void InitNewNodeFromSplits(const std::vector<int>& qexpand,
+										  const std::vector<int>& newnodes,
+										  const RegTree& tree) {
+			snode_.resize(tree.param.num_nodes, NodeEntryInAccel());
+			for (int nid : qexpand) {
+				if (tree[nid].IsLeaf()) {
+					continue;
+				}
+				snode_[tree[nid].LeftChild()].stats = snode_[nid].best.left_sum;
+				snode_[tree[nid].RightChild()].stats = snode_[nid].best.right_sum;
+			}
+			this->InitNodeWeights(newnodes, tree);
+		}
+		inline int Monotone(unsigned fid) const {
+			return fid < param_.monotone_constraints.size() ? param_.monotone_constraints[fid] : 0;
+		}
+		// the children of a split on a constrained feature are bounded by the mean of
+		// their weights, as in the monotone evaluator
+		inline void AddWeightBounds(int nid, int cleft, int cright, unsigned fid,
+									float left_weight, float right_weight) {
+			size_t size = std::max(cleft, cright) + 1;
+			if (wlower_.size() < size) {
+				wlower_.resize(size, -std::numeric_limits<float>::infinity());
+				wupper_.resize(size, std::numeric_limits<float>::infinity());
+			}
+			wlower_[cleft] = wlower_[cright] = wlower_[nid];
+			wupper_[cleft] = wupper_[cright] = wupper_[nid];
+			float mid = (left_weight + right_weight) / 2;
+			int constraint = this->Monotone(fid);
+			if (constraint < 0) {
+				wlower_[cleft] = mid;
+				wupper_[cright] = mid;
+			} else if (constraint > 0) {
+				wupper_[cleft] = mid;
+				wlower_[cright] = mid;
+			}
+		}
+		inline void InitNodeWeights(const std::vector<int>& qexpand, const RegTree& tree) {
+			for (int nid : qexpand) {
+				uint32_t parentid = tree[nid].Parent();
+				GradStats nstats(snode_[nid].stats);
+				snode_[nid].weight = static_cast<float>(
+						spliteval_->ComputeWeight(parentid, nstats));
+				snode_[nid].root_gain = static_cast<float>(
+						spliteval_->ComputeScore(parentid, nstats, snode_[nid].weight));
+			}
+		}
+		inline void CreateCubes( int depth, const RegTree& tree, const std::vector<uint32_t> &req_cols)
+		{
+			//node cube creation
+			//count the active rows of each node
+			std::vector<uint32_t> node_rows(tree.param.num_nodes, 0);
+			for (size_t i = 0; i < position_.size(); i++)
+				if (position_[i] >= 0) node_rows[position_[i]]++;
+			//only nodes that can produce a valid split are sent to the kernel, nodes with
+			//a single row or a total hessian below 2*min_child_weight are made leaves on the host
+			qwork_.clear();
+			for (int nid : qexpand_)
+				if (node_rows[nid] > 1 && snode_[nid].stats.sum_hess >= 2*param_.min_child_weight)
+					qwork_.push_back(nid);
+			CHECK_LE(qwork_.size(), xgboost_hist::kMaxNodeNum) << "More than "
+				<< xgboost_hist::kMaxNodeNum << " new nodes were requested. Please reduce max depth";
+			//create node2workindex vector, which maps work nodes to positions [0,work_nodes_num)
+			node2workindex_.resize(tree.param.num_nodes);
+			std::fill(node2workindex_.begin(), node2workindex_.end(), -1);
+			for (size_t i = 0; i < qwork_.size(); ++i)
+				node2workindex_[qwork_[i]] = static_cast<int>(i);
+			//when both children of a node of the previous call are work nodes, the histogram of
+			//the one with more rows is its parent's less its sibling's, and its rows are not streamed
+			hist_src_.assign(qwork_.size(), kHistFromRows);
+			if (hist_prev_[0].size() > 0) {
+				for (size_t i = 0; i < qwork_.size(); ++i) {
+					const int nid = qwork_[i];
+					const int pid = tree[nid].Parent();
+					const int sibling = tree[pid].LeftChild() == nid ? tree[pid].RightChild()
+																	  : tree[pid].LeftChild();
+					if (pid >= static_cast<int>(prev_workindex_.size()) || prev_workindex_[pid] < 0 ||
+						node2workindex_[sibling] < 0)
+						continue;
+					if (node_rows[nid] > node_rows[sibling] || (node_rows[nid] == node_rows[sibling] && nid > sibling))
+						hist_src_[i] = (static_cast<uint32_t>(prev_workindex_[pid]) << 16) |
+								static_cast<uint32_t>(node2workindex_[sibling]);
+				}
+			}
+			keep_hist_ = fparam_.fpga_hist_subtraction && depth + 1 < param_.max_depth;
+			//the work index of the rows the kernel bins, -1 for the rest
+			std::vector<short int> row_work(nrows_, -1);
+			size_t nstream = 0;
+			for (uint32_t ridx = 0; ridx < nrows_; ridx++) {
+				if (position_[ridx] < 0) continue;
+				int widx = node2workindex_[position_[ridx]];
+				if (widx >= 0 && hist_src_[widx] == kHistFromRows) {
+					row_work[ridx] = static_cast<short int>(widx);
+					nstream++;
+				}
+			}
+			//compact the device layout when enough rows are no longer streamed
+			if (fparam_.fpga_hist_compact_threshold > 0.0f &&
+				nstream < fparam_.fpga_hist_compact_threshold * layout_rows_) {
+				monitor_.Start("Builder Compact Layout");
+				this->CompactLayout(req_cols, row_work.data());
+				layout_rows_ = nstream;
+				monitor_.Stop("Builder Compact Layout");
+			}
+			//create position_fpga_ cube over the rows of the layout, padded to whole words of bins
+			size_t nlayout = layout_compacted_ ? layout_map_.size() : nrows_;
+			std::vector<short int> position_fpga_tmp((nlayout + kRowAlign - 1)/kRowAlign*kRowAlign, -1);
+			for (size_t i = 0; i < nlayout; i++)
+				position_fpga_tmp[i] = row_work[layout_compacted_ ? layout_map_[i] : i];
+			//allign to 8 GradStats (8*8B = 64B)
+			size_t snode_stats_size = qwork_.size() + (((qwork_.size()%8)>0)?(8 - (qwork_.size()%8)):0);
+			std::vector<GradStatsInAccel> snode_stats_tmp(snode_stats_size);
+			std::vector<float> snode_rg_tmp(snode_stats_size);
+			std::vector<uint32_t> snode_hist_src_tmp(snode_stats_size, kHistFromRows);
+			//node weight bounds: the lower bounds of 8 nodes, then their upper bounds,
+			//clamped to the range of the fixed point weights
+			const float wlimit = std::ldexp(1.0f, xgboost_hist::kAccumInt - 2);
+			std::vector<float> snode_bounds_tmp((snode_stats_size/8)*16);
+			for (size_t i = 0; i < qwork_.size(); ++i)
+			{
+				snode_stats_tmp[i].sum_grad = snode_[qwork_[i]].stats.sum_grad * gscale_;
+				snode_stats_tmp[i].sum_hess = snode_[qwork_[i]].stats.sum_hess * gscale_;
+				snode_rg_tmp[i] = snode_[qwork_[i]].root_gain * gscale_;
+				snode_hist_src_tmp[i] = hist_src_[i];
+				snode_bounds_tmp[(i/8)*16 + i%8] = std::max(wlower_[qwork_[i]], -wlimit);
+				snode_bounds_tmp[(i/8)*16 + 8 + i%8] = std::min(wupper_[qwork_[i]], wlimit);
+			}
+			//feature cube creation
+			//one byte per block of kLanes features, one bit per lane
+			std::vector<std::vector<uint8_t>> feat_valid_fpga_tmp(nRequests_);
+			for(uint32_t req = 0; req<nRequests_; req++)
+				feat_valid_fpga_tmp[req].assign(xgboost_hist::BlockCount(req_cols[req+1] - req_cols[req]), 0);
+			//with per node masks every work node samples its own features, restricted to the
+			//ones its interaction constraints allow, and the level mask is their union; the
+			//mask of work node i in block b is byte b*qwork_.size()+i
+			std::vector<std::vector<uint8_t>> node_fmask_tmp(nRequests_);
+			std::vector<std::shared_ptr<HostDeviceVector<int>>> feat_sets;
+			if (node_masks_) {
+				for(uint32_t req = 0; req<nRequests_; req++)
+					node_fmask_tmp[req].assign(feat_valid_fpga_tmp[req].size()*qwork_.size(), 0);
+				for (size_t i = 0; i < qwork_.size(); ++i)
+					feat_sets.push_back(column_sampler_.GetFeatureSet(depth));
+			} else {
+				feat_sets.push_back(column_sampler_.GetFeatureSet(depth));
+			}
+			for (size_t i = 0; i < feat_sets.size(); ++i)
+			{
+				for(uint32_t fid : feat_sets[i]->HostVector())
+				{
+					if (node_masks_ && !interaction_constraints_.Query(qwork_[i], fid)) continue;
+					//calculate which req this fid belongs to
+					uint32_t req = 0;
+					while (fid >= req_cols[req+1]) req++;
+					//shift the fid to this req's range
+					uint32_t fid_shifted = fid - req_cols[req];
+					feat_valid_fpga_tmp[req][fid_shifted/kLanes] |= (1<<(fid_shifted%kLanes));
+					if (node_masks_)
+						node_fmask_tmp[req][(fid_shifted/kLanes)*qwork_.size() + i] |= (1<<(fid_shifted%kLanes));
+				}
+			}
+			position_fpga_.assign(position_fpga_tmp.begin(), position_fpga_tmp.end());
+			snode_stats_.assign(snode_stats_tmp.begin(), snode_stats_tmp.end());
+			snode_rg_.assign(snode_rg_tmp.begin(), snode_rg_tmp.end());
+			snode_bounds_.assign(snode_bounds_tmp.begin(), snode_bounds_tmp.end());
+			snode_hist_src_.assign(snode_hist_src_tmp.begin(), snode_hist_src_tmp.end());
+			for(uint32_t req = 0; req<nRequests_; req++)
+			{
+				feat_valid_fpga_[req].assign(feat_valid_fpga_tmp[req].begin(), feat_valid_fpga_tmp[req].end());
+				node_fmask_fpga_[req].assign(node_fmask_tmp[req].begin(), node_fmask_tmp[req].end());
+				//monotone directions, 2 bits per lane, set once per tree
+				if (feat_mono_fpga_[req].size() > 0) continue;
+				uint32_t nfeatures_req = req_cols[req+1] - req_cols[req];
+				std::vector<uint8_t> mono_tmp(xgboost_hist::BlockCount(nfeatures_req), 0);
+				for (uint32_t f = 0; monotone_ && f < nfeatures_req; f++) {
+					int constraint = this->Monotone(req_cols[req] + f);
+					if (constraint != 0)
+						mono_tmp[f/kLanes] |= (constraint > 0 ? xgboost_hist::kMonoInc : xgboost_hist::kMonoDec)
+								<< (2*(f%kLanes));
+				}
+				feat_mono_fpga_[req].assign(mono_tmp.begin(), mono_tmp.end());
+			}
+		}
+		// rebuild the device layout with the rows the kernel bins only, so that deep levels
+		// and the smaller children of the subtraction stream less data
+		inline void CompactLayout(const std::vector<uint32_t> &req_cols, const short int* row_work) {
+			layout_map_.clear();
+			for (uint32_t ridx = 0; ridx < nrows_; ridx++)
+				if (row_work[ridx] >= 0) layout_map_.push_back(ridx);
+			const size_t nlayout = layout_map_.size();
+			const size_t nlayout_pad = (nlayout + kRowAlign - 1)/kRowAlign*kRowAlign;
+			gpair_active_.resize(0); 		//size = 0
+			gpair_active_.shrink_to_fit();	//deallocate memory, to delete cube
+			gpair_active_.resize(nlayout_pad); //allocate memory to create cube
+			for (size_t i = 0; i < nlayout; i++) {
+				const GradientPair& g = (*gpair_)[layout_map_[i]];
+				gpair_active_[i] = GradientPair(g.GetGrad()*gscale_, g.GetHess()*gscale_);
+			}
+			for(uint32_t req = 0; req<nRequests_; req++)
+			{
+				auto ncol_mlt = xgboost_hist::BlockCount(req_cols[req+1] - req_cols[req]);
+				bins_active_[req].resize(0); 		//size = 0
+				bins_active_[req].shrink_to_fit();	//deallocate memory, to delete cube
+				bins_active_[req].resize(ncol_mlt*nlayout_pad*kLanes); //allocate memory to create cube
+				std::fill(bins_active_[req].begin(), bins_active_[req].end(),
+						  static_cast<BinT>(xgboost_hist::kMissingBin));
+				#pragma omp parallel for schedule(static)
+				for (uint32_t ncidx = 0; ncidx < ncol_mlt; ncidx++)
+					for (size_t i = 0; i < nlayout; i++)
+						std::memcpy(&bins_active_[req][(ncidx*nlayout_pad + i)*kLanes],
+									&bins_[req][(static_cast<size_t>(ncidx)*nrow_pad_ + layout_map_[i])*kLanes],
+									kLanes*sizeof(BinT));
+			}
+			layout_compacted_ = true;
+		}
+		inline void FindSplit(  int depth,
+								const std::vector<int> &qexpand,
+								const ::inaccel::vector<GradientPair>& gpair_fpga,
+								const std::vector<uint32_t>& req_cols,
+								RegTree *p_tree) {
+			if (qwork_.size() > 0)
+				this->FindSplitInAccel(qwork_, gpair_fpga, req_cols);
+			for (int nid : qexpand) {
+				NodeEntryInAccel &e = snode_[nid];
+				if (e.best.loss_chg > kRtEps) {
+					float left_leaf_weight =
+							spliteval_->ComputeWeight(nid, GradStats(e.best.left_sum)) *
+							param_.learning_rate;
+					float right_leaf_weight =
+							spliteval_->ComputeWeight(nid, GradStats(e.best.right_sum)) *
+							param_.learning_rate;
+					p_tree->ExpandNode(nid, e.best.SplitIndex(), e.best.split_value,
+														 e.best.DefaultLeft(), e.weight, left_leaf_weight,
+														 right_leaf_weight, e.best.loss_chg,
+														 e.stats.sum_hess);
+				} else {
+					(*p_tree)[nid].SetLeaf(e.weight * param_.learning_rate);
+				}
+			}
+		}
+		// build or derive the histograms of the work nodes on the accelerator and find their
+		// best splits; the histograms kept by the call feed the next one
+		inline void FindSplitInAccel(  const std::vector<int> &qwork,
+								const ::inaccel::vector<GradientPair>& gpair_fpga,
+								const std::vector<uint32_t>& req_cols) {
+			size_t qwork_size_alligned = qwork.size() + (qwork.size()%2);
+			std::vector<::inaccel::vector<SplitEntryInAccelRet>> best_split(nRequests_);
+			std::vector<::inaccel::vector<uint32_t>> stats(nRequests_);
+			std::vector<::inaccel::vector<uint8_t>> hist_out(nRequests_);
+			std::vector<::inaccel::Request> requests;
+			const uint32_t nlayout = layout_compacted_ ? static_cast<uint32_t>(layout_map_.size()) : nrows_;
+			for(uint32_t req = 0; req<nRequests_; req++)
+			{
+				uint32_t ncols_req = req_cols[req+1] - req_cols[req];
+				best_split[req].resize(qwork_size_alligned);
+				stats[req].resize(xgboost_hist::kStatCount);
+				if (keep_hist_)
+					hist_out[req].resize(static_cast<size_t>(xgboost_hist::BlockCount(ncols_req))*
+										 qwork.size()*bin_num_*xgboost_hist::kHistBytes);
+				::inaccel::Request request{"com.inaccel.xgboost.hist"};
+				request.Arg((int)nlayout);
+				request.Arg((int)ncols_req);
+				request.Arg((int)qwork.size());
+				request.Arg((int)bin_num_);
+				request.Arg(layout_compacted_ ? gpair_active_ : gpair_fpga);
+				request.Arg(position_fpga_);
+				request.Arg(layout_compacted_ ? bins_active_[req] : bins_[req]);
+				request.Arg(feat_valid_fpga_[req]);
+				request.Arg(snode_stats_);
+				request.Arg(snode_rg_);
+				request.Arg(best_split[req]);
+				request.Arg(param_.min_child_weight * gscale_);
+				request.Arg(param_.max_delta_step);
+				request.Arg(param_.reg_alpha * gscale_);
+				request.Arg(param_.reg_lambda * gscale_);
+				request.Arg(snode_bounds_);
+				request.Arg(feat_mono_fpga_[req]);
+				request.Arg((int)monotone_);
+				//without per node masks the level mask stands in, never read by the kernel
+				request.Arg(node_masks_ ? node_fmask_fpga_[req] : feat_valid_fpga_[req]);
+				request.Arg((int)node_masks_);
+				request.Arg(snode_hist_src_);
+				request.Arg((int)prev_work_num_);
+				//without kept histograms the level mask stands in, never accessed by the kernel
+				request.Arg(hist_prev_[req].size() > 0 ? hist_prev_[req] : feat_valid_fpga_[req]);
+				request.Arg(keep_hist_ ? hist_out[req] : feat_valid_fpga_[req]);
+				request.Arg((int)keep_hist_);
+				request.Arg(stats[req]);
+				requests.push_back(request);
+			}
+			for(uint32_t req = 0; req<nRequests_; req++)
+			{
+				::inaccel::Coral::SubmitAsync(requests[req]);
+			}
+			for(uint32_t req = 0; req<nRequests_; req++)
+			{
+				::inaccel::Coral::Await(requests[req]);
+				LOG(DEBUG) << "FpgaHistMaker: " << qwork.size() << " nodes, request " << req << ": "
+						   << FormatHistKernelStats(stats[req].data());
+				//the kept histograms replace the ones of the previous level
+				hist_prev_[req].swap(hist_out[req]);
+			}
+			prev_workindex_ = node2workindex_;
+			prev_work_num_ = static_cast<uint32_t>(qwork.size());
+			this->SyncBestSolution(qwork, best_split, req_cols);
+		}
+		// the threshold of a split on bin t sends the values below the cut after bin t left,
+		// 0xffff sends every present value right
+		inline float DecodeSplitValue(const SplitEntryInAccelRet& split, uint32_t offset) const {
+			uint32_t bin;
+			std::memcpy(&bin, &split.split_value, sizeof(bin));
+			const uint32_t fid = (split.sindex & 0x7fffffff) + offset;
+			if (fid >= ncols_) return 0.0f;
+			if (bin == 0xffff) return cuts_.MinValues()[fid];
+			const auto& ptrs = cuts_.Ptrs();
+			const uint32_t nbins = ptrs[fid+1] - ptrs[fid];
+			if (nbins == 0) return 0.0f;
+			return cuts_.Values()[ptrs[fid] + std::min(bin, nbins - 1)];
+		}
+		void SyncBestSolution(const std::vector<int> &qexpand,
+							  const std::vector<::inaccel::vector<SplitEntryInAccelRet>> &best_split,
+							  const std::vector<uint32_t>& req_cols) {
+			for (int nid : qexpand) {
+				for (uint32_t req = 0; req < nRequests_; req++) {
+					SplitEntryInAccelRet split = best_split[req][node2workindex_[nid]];
+					CHECK_EQ(split.nu1, xgboost_hist::kPrecisionTag)
+							<< "The accumulator precision of the kernel does not match the library build.";
+					split.loss_chg /= gscale_;
+					split.left_sum_grad /= gscale_;
+					split.left_sum_hess /= gscale_;
+					split.split_value = this->DecodeSplitValue(split, req_cols[req]);
+					this->snode_[nid].best.Update( SplitEntryInAccel(this->snode_[nid].stats,
+													 split, req_cols[req]));
+				}
+			}
+		}
+		// move the rows of the split nodes to their children, from the values of their rows;
+		// the bins of the kernel are the values below each cut, so the rows follow the sums
+		inline void ResetPosition(const std::vector<int> &qexpand,
+									DMatrix* p_fmat,
+									const RegTree& tree) {
+			for (const auto &batch : p_fmat->GetBatches<SparsePage>()) {
+				const auto nbatch = static_cast<uint32_t>(batch.Size());
+				#pragma omp parallel for schedule(static)
+				for (uint32_t i = 0; i < nbatch; ++i) {
+					const auto ridx = static_cast<uint32_t>(batch.base_rowid + i);
+					const int nid = this->DecodePosition(ridx);
+					if (tree[nid].IsLeaf()) {
+						// mark finish when it is not a fresh leaf
+						if (tree[nid].RightChild() == -1) {
+							position_[ridx] = ~nid;
+						}
+						continue;
+					}
+					bool left = tree[nid].DefaultLeft();
+					for (const auto& e : batch[i]) {
+						if (e.index == tree[nid].SplitIndex()) {
+							left = e.fvalue < tree[nid].SplitCond();
+							break;
+						}
+					}
+					this->SetEncodePosition(ridx, left ? tree[nid].LeftChild() : tree[nid].RightChild());
+				}
+			}
+		}
+		inline int DecodePosition(uint32_t ridx) const {
+			const int pid = position_[ridx];
+			return pid < 0 ? ~pid : pid;
+		}
+		inline void SetEncodePosition(uint32_t ridx, int nid) {
+			if (position_[ridx] < 0) {
+				position_[ridx] = ~nid;
+			} else {
+				position_[ridx] = nid;
+			}
+		}
+		inline void UpdateQueueExpand(const RegTree& tree,
+										const std::vector<int> &qexpand,
+										std::vector<int>* p_newnodes) {
+			p_newnodes->clear();
+			for (int nid : qexpand) {
+				if (!tree[ nid ].IsLeaf()) {
+					p_newnodes->push_back(tree[nid].LeftChild());
+					p_newnodes->push_back(tree[nid].RightChild());
+				}
+			}
+		}
+		inline void UpdatePosition(DMatrix* p_fmat, const RegTree &tree) {
+			#pragma omp parallel for schedule(static)
+			for (uint32_t ridx = 0; ridx < nrows_; ++ridx) {
+				int nid = this->DecodePosition(ridx);
+				while (tree[nid].IsDeleted()) {
+					nid = tree[nid].Parent();
+					CHECK_GE(nid, 0);
+				}
+				this->position_[ridx] = nid;
+			}
+		}
+	};
+};
+
+XGBOOST_REGISTER_TREE_UPDATER(DistFpgaHistMaker, "grow_fpga_hist")
+.describe("FPGA histogram version of tree maker.")
+.set_body([]() {
+		return new DistFpgaHistMaker();
+	});
+}
+}